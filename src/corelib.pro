@@ -112,8 +112,12 @@ HEADERS += tsqlobject.h
 SOURCES += tsqlobject.cpp
 HEADERS += tsqlormapperiterator.h
 SOURCES += tsqlormapperiterator.cpp
+HEADERS += tsqlormappercursor.h
+SOURCES += tsqlormappercursor.cpp
 HEADERS += tsqlquery.h
 SOURCES += tsqlquery.cpp
+HEADERS += tsqlstatementcache.h
+SOURCES += tsqlstatementcache.cpp
 HEADERS += tsqlqueryormapper.h
 SOURCES += tsqlqueryormapper.cpp
 HEADERS += tsqlqueryormapperiterator.h
@@ -134,6 +138,7 @@ HEADERS += tcontentheader.h
 SOURCES += tcontentheader.cpp
 HEADERS += thttputility.h
 SOURCES += thttputility.cpp
+HEADERS += thtmlescapekernel.h
 HEADERS += thtmlattribute.h
 SOURCES += thtmlattribute.cpp
 HEADERS += ttextview.h
@@ -156,6 +161,16 @@ HEADERS += tsession.h
 SOURCES += tsession.cpp
 HEADERS += tsessionmanager.h
 SOURCES += tsessionmanager.cpp
+HEADERS += tsessioncache.h
+SOURCES += tsessioncache.cpp
+HEADERS += tstaticassetcache.h
+SOURCES += tstaticassetcache.cpp
+HEADERS += thttpcompressor.h
+SOURCES += thttpcompressor.cpp
+HEADERS += tpartialfile.h
+SOURCES += tpartialfile.cpp
+HEADERS += tsessionserializer.h
+SOURCES += tsessionserializer.cpp
 HEADERS += tsessionstorefactory.h
 SOURCES += tsessionstorefactory.cpp
 HEADERS += tsessionsqlobjectstore.h
@@ -242,6 +257,7 @@ HEADERS += tappsettings.h
 SOURCES += tappsettings.cpp
 HEADERS += twebsocketendpoint.h
 SOURCES += twebsocketendpoint.cpp
+SOURCES += tdispatcher.cpp
 
 HEADERS += \
            tfnamespace.h \
@@ -268,13 +284,18 @@ unix {
   SOURCES += twebapplication_unix.cpp
   SOURCES += tapplicationserverbase_unix.cpp
   SOURCES += tfileaiowriter_unix.cpp
+  HEADERS += tsessionsharedmemorystore.h
+  SOURCES += tsessionsharedmemorystore_unix.cpp
 }
 unix:!macx {
   # For Linux
+  LIBS += -lrt
   HEADERS += tmultiplexingserver.h
   SOURCES += tmultiplexingserver_linux.cpp
   HEADERS += tactionworker.h
   SOURCES += tactionworker.cpp
+  HEADERS += tactionworkerpool.h
+  SOURCES += tactionworkerpool.cpp
   HEADERS += tepoll.h
   SOURCES += tepoll.cpp
   HEADERS += tepollsocket.h
@@ -22,6 +22,7 @@ protected:
     bool hasVariant(const QString &name) const;
     void exportVariants(const QVariantMap &map);
     const QVariantMap &allVariants() const { return exportVars; }
+    void clearVariants() { exportVars.clear(); }
     QString viewClassName(const QString &action = QString()) const;
     QString viewClassName(const QString &contoller, const QString &action) const;
 
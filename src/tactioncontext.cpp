@@ -25,10 +25,84 @@
 #include "thttpsocket.h"
 #include "tsessionmanager.h"
 #include "turlroute.h"
+#include "tstaticassetcache.h"
+#include "thttpcompressor.h"
+#include "tpartialfile.h"
 #ifdef Q_OS_UNIX
 # include "tfcore_unix.h"
 #endif
 
+/*
+  Replaces the \a body of \a length bytes with the byte ranges requested
+  by the Range header of the \a request. Sets 206 or 416 to the
+  \a statusCode and the headers of the ranges to the \a header. Returns
+  the device of the partial content, or 0 if the body is sent as is.
+  This function is for the content of a file only; an encoded body is
+  always sent as is.
+*/
+static QIODevice *partialContent(const THttpRequestHeader &request, THttpResponseHeader &header, QIODevice *body, qint64 length, int &statusCode)
+{
+    QBuffer *buffer = qobject_cast<QBuffer *>(body);
+    QFile *file = qobject_cast<QFile *>(body);
+    if (statusCode != Tf::OK || (!buffer && !file) || header.hasRawHeader("Content-Encoding")) {
+        return 0;
+    }
+
+    header.setRawHeader("Accept-Ranges", "bytes");
+    const QByteArray range = request.rawHeader("Range");
+    if (range.isEmpty() || request.method().toUpper() != "GET") {
+        return 0;
+    }
+
+    // Sends the whole content if it has changed since the client got a part
+    const QByteArray ifRange = request.rawHeader("If-Range").trimmed();
+    if (!ifRange.isEmpty()) {
+        const QByteArray validator = (ifRange.startsWith('"')) ? header.rawHeader("ETag") : header.rawHeader("Last-Modified");
+        if (ifRange != validator) {
+            return 0;
+        }
+    }
+
+    QList<QPair<qint64, qint64> > ranges;
+    if (!TPartialFile::parseRange(range, length, ranges)) {
+        return 0;
+    }
+
+    if (ranges.isEmpty()) {
+        statusCode = Tf::RequestedRangeNotSatisfiable;
+        header.setRawHeader("Content-Range", "bytes */" + QByteArray::number(length));
+        return 0;
+    }
+
+    const QByteArray contentType = header.contentType();
+    QByteArray boundary;
+    if (ranges.count() > 1) {
+        boundary = QByteArray::number(Tf::randXor128(), 36) + QByteArray::number(Tf::randXor128(), 36);
+        header.setContentType("multipart/byteranges; boundary=" + boundary);
+    } else {
+        header.setRawHeader("Content-Range", TPartialFile::contentRange(ranges[0].first, ranges[0].second, length));
+    }
+
+    QByteArray trailer;
+    QList<TPartialFile::Part> parts = TPartialFile::createParts(ranges, length, contentType, boundary, trailer);
+    statusCode = Tf::PartialContent;
+
+    if (file) {
+        return new TPartialFile(file->fileName(), parts, trailer);
+    }
+
+    // Body in memory
+    const QByteArray &data = buffer->data();
+    QBuffer *partial = new QBuffer;
+    for (QListIterator<TPartialFile::Part> it(parts); it.hasNext(); ) {
+        const TPartialFile::Part &part = it.next();
+        partial->buffer() += part.header;
+        partial->buffer() += data.mid(part.offset, part.length);
+    }
+    partial->buffer() += trailer;
+    return partial;
+}
+
 /*!
   \class TActionContext
   \brief The TActionContext class is the base class of contexts for
@@ -42,13 +116,18 @@ TActionContext::TActionContext()
       stopped(false),
       socketDesc(0),
       currController(0),
-      httpReq(0)
+      httpReq(0),
+      chunkedResponse(false),
+      chunkedFinished(false),
+      chunkedBytes(0)
 { }
 
 
 TActionContext::~TActionContext()
 {
     release();
+    qDeleteAll(controllerPool);
+    controllerPool.clear();
 }
 
 
@@ -122,6 +201,10 @@ void TActionContext::execute(THttpRequest &request)
     THttpResponseHeader responseHeader;
     accessLogger.open();
 
+    chunkedResponse = false;
+    chunkedFinished = false;
+    chunkedBytes = 0;
+
     try {
         httpReq = &request;
         const THttpRequestHeader &hdr = httpReq->header();
@@ -138,17 +221,19 @@ void TActionContext::execute(THttpRequest &request)
 
         // HTTP method
         Tf::HttpMethod method = httpReq->method();
-        QString path = THttpUtility::fromUrlEncoding(hdr.path().mid(0, hdr.path().indexOf('?')));
+        QByteArray rawPath = hdr.path().mid(0, hdr.path().indexOf('?'));
+        QString path;
 
         // Routing info exists?
-        QStringList components = TUrlRoute::splitPath(path);
-        TRouting rt = TUrlRoute::instance().findRouting(method, components);
+        TRouting rt = TUrlRoute::instance().findRouting(method, rawPath);
 
         tSystemDebug("Routing: controller:%s  action:%s", rt.controller.data(),
                      rt.action.data());
 
         if (rt.isEmpty()) {
             // Default URL routing
+            path = THttpUtility::fromUrlEncoding(rawPath);
+            QStringList components = TUrlRoute::splitPath(path);
 
             if (directViewRenderMode()) { // Direct view render mode?
                 // Direct view setting
@@ -168,6 +253,10 @@ void TActionContext::execute(THttpRequest &request)
 
         // Call controller method
         TDispatcher<TActionController> ctlrDispatcher(rt.controller);
+        TActionController *pooled = controllerPool.take(rt.controller);
+        if (pooled) {
+            ctlrDispatcher.setObject(pooled);
+        }
         currController = ctlrDispatcher.object();
         if (currController) {
             currController->setActionName(rt.action);
@@ -230,65 +319,110 @@ void TActionContext::execute(THttpRequest &request)
                     }
 
                     // Session store
-                    if (currController->sessionEnabled()) {
-                        bool stored = TSessionManager::instance().store(currController->session());
-                        if (Q_LIKELY(stored)) {
-                            QDateTime expire;
-                            if (TSessionManager::sessionLifeTime() > 0) {
-                                expire = QDateTime::currentDateTime().addSecs(TSessionManager::sessionLifeTime());
-                            }
-
-                            // Sets the path in the session cookie
-                            QString cookiePath = Tf::appSettings()->value(Tf::SessionCookiePath).toString();
-                            currController->addCookie(TSession::sessionName(), currController->session().id(), expire, cookiePath);
-                        }
-                    }
+                    storeSession();
                 }
             }
 
-            // Sets charset to the content-type
-            QByteArray ctype = currController->response.header().contentType().toLower();
-            if (ctype.startsWith("text") && !ctype.contains("charset")) {
-                ctype += "; charset=";
-                ctype += Tf::app()->codecForHttpOutput()->name();
-                currController->response.header().setContentType(ctype);
-            }
+            if (chunkedResponse) {
+                // The response has been streamed by the action
+                if (!chunkedFinished) {
+                    endChunkedResponse();
+                }
+            } else {
+                // Sets charset to the content-type
+                QByteArray ctype = currController->response.header().contentType().toLower();
+                if (ctype.startsWith("text") && !ctype.contains("charset")) {
+                    ctype += "; charset=";
+                    ctype += Tf::app()->codecForHttpOutput()->name();
+                    currController->response.header().setContentType(ctype);
+                }
+
+                // Compresses the body rendered in memory
+                if (THttpCompressor::isEnabled()) {
+                    QBuffer *buffer = qobject_cast<QBuffer *>(currController->response.bodyIODevice());
+                    if (buffer) {
+                        QByteArray body = buffer->data();
+                        if (THttpCompressor::compress(currController->response.header(), body, hdr.rawHeader("Accept-Encoding"))) {
+                            currController->response.setBody(body);
+                        }
+                    }
+                }
 
-            // Sets the default status code of HTTP response
-            accessLogger.setStatusCode( (!currController->response.isBodyNull()) ? currController->statusCode() : Tf::InternalServerError );
-            currController->response.header().setStatusLine(accessLogger.statusCode(), THttpUtility::getResponseReasonPhrase(accessLogger.statusCode()));
+                // Sets the default status code of HTTP response
+                int statusCode = (!currController->response.isBodyNull()) ? currController->statusCode() : Tf::InternalServerError;
+                THttpResponseHeader &resHeader = currController->response.header();
 
-            // Writes a response and access log
-            int bytes = writeResponse(currController->response.header(), currController->response.bodyIODevice(),
-                                      currController->response.bodyLength());
-            accessLogger.setResponseBytes(bytes);
+                // Byte ranges requested for a file sent
+                QScopedPointer<QIODevice> partial;
+                if (currController->fileSending()) {
+                    partial.reset(partialContent(hdr, resHeader, currController->response.bodyIODevice(),
+                                                 currController->response.bodyLength(), statusCode));
+                }
+                accessLogger.setStatusCode(statusCode);
+                resHeader.setStatusLine(statusCode, THttpUtility::getResponseReasonPhrase(statusCode));
+
+                // Writes a response and access log
+                int bytes;
+                if (statusCode == Tf::RequestedRangeNotSatisfiable) {
+                    bytes = writeResponse(statusCode, resHeader);
+                } else if (partial) {
+                    bytes = writeResponse(resHeader, partial.data(), partial->size());
+                } else {
+                    bytes = writeResponse(resHeader, currController->response.bodyIODevice(), currController->response.bodyLength());
+                }
+                accessLogger.setResponseBytes(bytes);
+            }
 
             // Session GC
             TSessionManager::instance().collectGarbage();
 
+            // Keeps the controller for the next request in this context
+            if (currController->reusable()) {
+                currController->reset();
+                controllerPool.insert(rt.controller, ctlrDispatcher.takeObject());
+            }
+
         } else {
             accessLogger.setStatusCode( Tf::BadRequest );  // Set a default status code
 
             if (method == Tf::Get) {  // GET Method
+                if (path.isEmpty()) {
+                    path = THttpUtility::fromUrlEncoding(rawPath);
+                }
                 path.remove(0, 1);
-                QFile reqPath(Tf::app()->publicPath() + path);
-                QFileInfo fi(reqPath);
-
-                if (fi.isFile() && fi.isReadable()) {
-                    // Check "If-Modified-Since" header for caching
-                    bool sendfile = true;
-                    QByteArray ifModifiedSince = hdr.rawHeader("If-Modified-Since");
+                TStaticAssetCache::AssetPointer asset = TStaticAssetCache::instance()->find(path);
 
-                    if (!ifModifiedSince.isEmpty()) {
-                        QDateTime dt = THttpUtility::fromHttpDateTimeString(ifModifiedSince);
-                        sendfile = (!dt.isValid() || dt != fi.lastModified());
-                    }
+                if (asset) {
+                    // Check "If-None-Match" and "If-Modified-Since" headers for caching
+                    const TStaticAsset::Content &content = asset->content(hdr.rawHeader("Accept-Encoding"));
+                    bool sendfile = asset->isModified(hdr, content);
+                    asset->setResponseHeader(responseHeader, content, sendfile);
 
                     if (sendfile) {
                         // Sends a request file
-                        responseHeader.setRawHeader("Last-Modified", THttpUtility::toHttpDateTimeString(fi.lastModified()));
-                        QByteArray type = Tf::app()->internetMediaType(fi.suffix());
-                        int bytes = writeResponse(Tf::OK, responseHeader, type, &reqPath, reqPath.size());
+                        QBuffer buffer;
+                        QFile file;
+                        QIODevice *body = &file;
+                        if (!content.data.isNull()) {
+                            buffer.setData(content.data);
+                            body = &buffer;
+                        } else {
+                            file.setFileName(content.filePath);
+                        }
+
+                        // Byte ranges requested
+                        int statusCode = Tf::OK;
+                        responseHeader.setContentType(asset->contentType);
+                        QScopedPointer<QIODevice> partial(partialContent(hdr, responseHeader, body, content.size, statusCode));
+
+                        int bytes;
+                        if (statusCode == Tf::RequestedRangeNotSatisfiable) {
+                            bytes = writeResponse(statusCode, responseHeader);
+                        } else if (partial) {
+                            bytes = writeResponse(statusCode, responseHeader, QByteArray(), partial.data(), partial->size());
+                        } else {
+                            bytes = writeResponse(statusCode, responseHeader, QByteArray(), body, content.size);
+                        }
                         accessLogger.setResponseBytes( bytes );
                     } else {
                         // Not send the data
@@ -310,9 +444,13 @@ void TActionContext::execute(THttpRequest &request)
 
     } catch (ClientErrorException &e) {
         tWarn("Caught ClientErrorException: status code:%d", e.statusCode());
-        int bytes = writeResponse(e.statusCode(), responseHeader);
-        accessLogger.setResponseBytes( bytes );
-        accessLogger.setStatusCode( e.statusCode() );
+        if (chunkedResponse) {
+            closeHttpSocket();  // the header has been sent already
+        } else {
+            int bytes = writeResponse(e.statusCode(), responseHeader);
+            accessLogger.setResponseBytes( bytes );
+            accessLogger.setStatusCode( e.statusCode() );
+        }
     } catch (SqlException &e) {
         tError("Caught SqlException: %s  [%s:%d]", qPrintable(e.message()), qPrintable(e.fileName()), e.lineNumber());
         tSystemError("Caught SqlException: %s  [%s:%d]", qPrintable(e.message()), qPrintable(e.fileName()), e.lineNumber());
@@ -412,6 +550,123 @@ qint64 TActionContext::writeResponse(THttpResponseHeader &header, QIODevice *bod
 }
 
 
+/*!
+  Stores the session of the current controller, and adds the session
+  cookie to its response header.
+*/
+void TActionContext::storeSession()
+{
+    if (!currController || !currController->sessionEnabled()) {
+        return;
+    }
+
+    bool stored = TSessionManager::instance().store(currController->session());
+    if (Q_LIKELY(stored)) {
+        QDateTime expire;
+        if (TSessionManager::sessionLifeTime() > 0) {
+            expire = QDateTime::currentDateTime().addSecs(TSessionManager::sessionLifeTime());
+        }
+
+        // Sets the path in the session cookie
+        QString cookiePath = Tf::appSettings()->value(Tf::SessionCookiePath).toString();
+        currController->addCookie(TSession::sessionName(), currController->session().id(), expire, cookiePath);
+    }
+}
+
+/*!
+  Sends the response header \a header with "Transfer-Encoding: chunked"
+  so that the body can be sent in pieces by writeChunk() as they are
+  produced. As the header is sent before the action returns, the session
+  is stored and its cookie added to the header here, as done after the
+  post filter otherwise; the session is stored again when the action
+  returns. Returns false if not supported by the MPM.
+*/
+bool TActionContext::beginChunkedResponse(THttpResponseHeader &header)
+{
+    T_TRACEFUNC("");
+
+    if (chunkedResponse) {
+        tWarn("Chunked response has begun already");
+        return false;
+    }
+
+    const THttpRequestHeader &reqHeader = httpReq->header();
+    if (reqHeader.majorVersion() < 1 || (reqHeader.majorVersion() == 1 && reqHeader.minorVersion() == 0)) {
+        tWarn("Chunked response not available in HTTP/1.0");
+        return false;
+    }
+
+    // Session store, which sets the cookie to the header
+    storeSession();
+
+    header.removeAllRawHeaders("Content-Length");
+    header.setRawHeader("Transfer-Encoding", "chunked");
+    header.setRawHeader("Connection", "Keep-Alive");
+    header.setRawHeader("Server", "TreeFrog server");
+    header.setCurrentDate();
+    accessLogger.setStatusCode(header.statusCode());
+
+    qint64 len = writeResponseData(header.toByteArray(), false);
+    if (len < 0) {
+        tSystemError("Chunked response not supported  [%s:%d]", __FILE__, __LINE__);
+        return false;
+    }
+
+    chunkedResponse = true;
+    chunkedBytes = len;
+    return true;
+}
+
+/*!
+  Sends the \a data as a chunk of the body. Blocks while the data sent
+  before is waiting in the send queue beyond a limit.
+*/
+bool TActionContext::writeChunk(const QByteArray &data)
+{
+    if (!chunkedResponse || chunkedFinished) {
+        return false;
+    }
+
+    if (data.isEmpty()) {
+        return true;  // empty chunk means the end
+    }
+
+    QByteArray chunk = QByteArray::number(data.length(), 16);
+    chunk.reserve(chunk.length() + data.length() + 4);
+    chunk += "\r\n";
+    chunk += data;
+    chunk += "\r\n";
+
+    qint64 len = writeResponseData(chunk, false);
+    if (len < 0) {
+        return false;
+    }
+    chunkedBytes += len;
+    return true;
+}
+
+/*!
+  Sends the last chunk to finish the chunked response.
+*/
+bool TActionContext::endChunkedResponse()
+{
+    if (!chunkedResponse || chunkedFinished) {
+        return false;
+    }
+
+    chunkedFinished = true;
+    accessLogger.setResponseBytes(chunkedBytes);
+
+    qint64 len = writeResponseData(QByteArray("0\r\n\r\n"), true);
+    if (len < 0) {
+        return false;
+    }
+    chunkedBytes += len;
+    accessLogger.setResponseBytes(chunkedBytes);
+    return true;
+}
+
+
 void TActionContext::emitError(int )
 { }
 
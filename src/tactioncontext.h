@@ -3,6 +3,7 @@
 
 #include <QStringList>
 #include <QMap>
+#include <QHash>
 #include <QSqlDatabase>
 #include <TGlobal>
 #include <TSqlTransaction>
@@ -35,6 +36,10 @@ public:
     const TActionController *currentController() const { return currController; }
     THttpRequest &httpRequest() { return *httpReq; }
     const THttpRequest &httpRequest() const { return *httpReq; }
+    bool beginChunkedResponse(THttpResponseHeader &header);
+    bool writeChunk(const QByteArray &data);
+    bool endChunkedResponse();
+    bool isChunkedResponse() const { return chunkedResponse; }
 
 protected:
     void execute(THttpRequest &request);
@@ -44,6 +49,7 @@ protected:
     bool beginTransaction(QSqlDatabase &database);
     void commitTransactions();
     void rollbackTransactions();
+    void storeSession();
 
     int socketDescriptor() const { return socketDesc; }
     qint64 writeResponse(int statusCode, THttpResponseHeader &header);
@@ -51,6 +57,7 @@ protected:
     qint64 writeResponse(THttpResponseHeader &header, QIODevice *body, qint64 length);
 
     virtual qint64 writeResponse(THttpResponseHeader &, QIODevice *) { return 0; }
+    virtual qint64 writeResponseData(const QByteArray &, bool) { return -1; }
     virtual void closeHttpSocket() { }
 
     TSqlTransaction transactions;
@@ -63,8 +70,12 @@ protected:
 
 private:
     TActionController *currController;
+    QHash<QByteArray, TActionController *> controllerPool;  // reusable controllers
     QList<TTemporaryFile *> tempFiles;
     THttpRequest *httpReq;
+    bool chunkedResponse;
+    bool chunkedFinished;
+    qint64 chunkedBytes;
 
     Q_DISABLE_COPY(TActionContext)
 };
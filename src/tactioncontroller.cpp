@@ -23,12 +23,24 @@
 #include <TAbstractUser>
 #include <TActionContext>
 #include <TFormValidator>
+#include <THttpUtility>
 #include "tsessionmanager.h"
 #include "ttextview.h"
 
 #define FLASH_VARS_SESSION_KEY  "_flashVariants"
 #define LOGIN_USER_NAME_KEY     "_loginUserName"
 
+
+static QByteArray viewOutput(TActionView *view)
+{
+    QTextCodec *codec = Tf::app()->codecForHttpOutput();
+    if (view->isUtf8Output() && codec->mibEnum() == 106) {  // UTF-8
+        // Written in UTF-8 already
+        return view->toUtf8();
+    }
+    return codec->fromUnicode(view->toString());
+}
+
 /*!
   \class TActionController
   \~english
@@ -52,12 +64,55 @@ TActionController::TActionController()
       statCode(Tf::OK),  // 200 OK
       rendered(false),
       layoutEnable(true),
-      rollback(false)
+      rollback(false),
+      sendingFile(false)
+{
+    // Default content type
+    setContentType("text/html");
+}
+
+/*!
+  \~english
+  Resets the state of the request so that this controller can be reused
+  for the next request in the same thread. Reimplement this function
+  to clear the member variables of a subclass whose reusable() returns
+  true, and call the base implementation.
+
+  \~japanese
+  次のリクエストで再利用できるように、リクエストの状態をリセットする
+*/
+void TActionController::reset()
 {
+    actName.clear();
+    statCode = Tf::OK;
+    rendered = false;
+    layoutEnable = true;
+    layoutName.clear();
+    response.clear();
+    flashVars.clear();
+    sessionStore = TSession();
+    cookieJar = TCookieJar();
+    rollback = false;
+    sendingFile = false;
+    autoRemoveFiles.clear();
+    clearVariants();
+
     // Default content type
     setContentType("text/html");
 }
 
+/*!
+  \fn bool TActionController::reusable() const
+  \~english
+  Returns true if this controller is kept after a request and reused
+  by the same thread; otherwise returns false. The default
+  implementation returns false. Reimplement this function and reset()
+  to reduce the construction cost of a controller.
+
+  \~japanese
+  コントローラをリクエスト後も保持し、同じスレッドで再利用する場合は true を返す
+*/
+
 /*!
   \fn TActionController::~TActionController();
   \~english
@@ -523,7 +578,7 @@ QByteArray TActionController::renderView(TActionView *view)
     if (!layoutEnabled()) {
         // Renders without layout
         tSystemDebug("Renders without layout");
-        return Tf::app()->codecForHttpOutput()->fromUnicode(view->toString());
+        return viewOutput(view);
     }
 
     // Displays with layout
@@ -541,7 +596,7 @@ QByteArray TActionController::renderView(TActionView *view)
             layoutView = defLayoutDispatcher.object();
             if (!layoutView) {
                 tSystemDebug("Not found default layout. Renders without layout.");
-                return Tf::app()->codecForHttpOutput()->fromUnicode(view->toString());
+                return viewOutput(view);
             }
         }
     }
@@ -550,7 +605,7 @@ QByteArray TActionController::renderView(TActionView *view)
     layoutView->setVariantMap(allVariants());
     layoutView->setController(this);
     layoutView->setSubActionView(view);
-    return Tf::app()->codecForHttpOutput()->fromUnicode(layoutView->toString());
+    return viewOutput(layoutView);
 }
 
 /*!
@@ -629,10 +684,14 @@ void TActionController::redirect(const QUrl &url, int statusCode)
 
 /*!
   \~english
-  Sends the file \a filePath as HTTP response.
+  Sends the file \a filePath as HTTP response. If the request has a
+  Range header, only the byte ranges requested are sent with the status
+  code 206 Partial Content.
 
   \~japanese
-  HTTPレスポンスとして、ファイル \a filePath の内容を送信する
+  HTTPレスポンスとして、ファイル \a filePath の内容を送信する。
+  リクエストに Range ヘッダがある場合、要求されたバイト範囲のみを
+  ステータスコード 206 Partial Content で送信する
 */
 bool TActionController::sendFile(const QString &filePath, const QByteArray &contentType, const QString &name, bool autoRemove)
 {
@@ -652,6 +711,7 @@ bool TActionController::sendFile(const QString &filePath, const QByteArray &cont
 
     response.setBodyFile(filePath);
     response.header().setContentType(contentType);
+    sendingFile = true;
 
     if (autoRemove)
         setAutoRemove(filePath);
@@ -687,6 +747,70 @@ bool TActionController::sendData(const QByteArray &data, const QByteArray &conte
     return true;
 }
 
+/*!
+  \~english
+  Begins to send a response whose body is written by writeStream()
+  piece by piece, using chunked transfer encoding. The status code and
+  cookies must be set before this. The session is stored and its cookie
+  sent with the header at this point; for the cookie session store, the
+  changes to the session after this are not sent to the client. The
+  stream is finished by endStreaming(), or automatically after the
+  action returns.
+
+  \~japanese
+  writeStream() で少しずつ書き込むレスポンスの送信を開始する
+*/
+bool TActionController::beginStreaming(const QByteArray &contentType, const QString &name)
+{
+    if (rendered) {
+        tWarn("Has rendered already: %s", qPrintable(className() + '#' + activeAction()));
+        return false;
+    }
+    rendered = true;
+
+    if (!name.isEmpty()) {
+        QByteArray filename;
+        filename += "attachment; filename=\"";
+        filename += name.toUtf8();
+        filename += '"';
+        response.header().setRawHeader("Content-Disposition", filename);
+    }
+
+    QByteArray ctype = contentType;
+    if (ctype.toLower().startsWith("text") && !ctype.toLower().contains("charset")) {
+        ctype += "; charset=";
+        ctype += Tf::app()->codecForHttpOutput()->name();
+    }
+    response.header().setContentType(ctype);
+    response.header().setStatusLine(statCode, THttpUtility::getResponseReasonPhrase(statCode));
+    return Tf::currentContext()->beginChunkedResponse(response.header());
+}
+
+/*!
+  \~english
+  Writes the \a data to the response stream begun by beginStreaming().
+  Blocks while too much data waits to be sent.
+
+  \~japanese
+  beginStreaming() で開始したレスポンスにデータ \a data を書き込む
+*/
+bool TActionController::writeStream(const QByteArray &data)
+{
+    return Tf::currentContext()->writeChunk(data);
+}
+
+/*!
+  \~english
+  Finishes the response stream begun by beginStreaming().
+
+  \~japanese
+  beginStreaming() で開始したレスポンスを終了する
+*/
+bool TActionController::endStreaming()
+{
+    return Tf::currentContext()->endChunkedResponse();
+}
+
 /*!
   \~english
   Exports the all flash variants.
@@ -42,6 +42,7 @@ public:
     virtual bool csrfProtectionEnabled() const { return true; }
     virtual QStringList exceptionActionsOfCsrfProtection() const { return QStringList(); }
     virtual bool transactionEnabled() const { return true; }
+    virtual bool reusable() const { return false; }
     QByteArray authenticityToken() const;
     QString flash(const QString &name) const;
     QHostAddress clientAddress() const;
@@ -55,6 +56,7 @@ public:
 protected:
     virtual bool preFilter() { return true; }
     virtual void postFilter() { }
+    virtual void reset();
     void setLayoutEnabled(bool enable);
     void setLayoutDisabled(bool disable);
     bool layoutEnabled() const;
@@ -89,6 +91,9 @@ protected:
     void redirect(const QUrl &url, int statusCode = Tf::Found);
     bool sendFile(const QString &filePath, const QByteArray &contentType, const QString &name = QString(), bool autoRemove = false);
     bool sendData(const QByteArray &data, const QByteArray &contentType, const QString &name = QString());
+    bool beginStreaming(const QByteArray &contentType, const QString &name = QString());
+    bool writeStream(const QByteArray &data);
+    bool endStreaming();
     void rollbackTransaction() { rollback = true; }
     void setAutoRemove(const QString &filePath);
     bool validateAccess(const TAbstractUser *user);
@@ -107,6 +112,7 @@ private:
     void exportAllFlashVariants();
     const TActionController *controller() const { return this; }
     bool rollbackRequested() const { return rollback; }
+    bool fileSending() const { return sendingFile; }
     static QString layoutClassName(const QString &layout);
     static QString partialViewClassName(const QString &partial);
 
@@ -121,6 +127,7 @@ private:
     TSession sessionStore;
     TCookieJar cookieJar;
     bool rollback;
+    bool sendingFile;
     QStringList autoRemoveFiles;
 
     friend class TActionContext;
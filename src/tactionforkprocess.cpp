@@ -111,6 +111,12 @@ qint64 TActionForkProcess::writeResponse(THttpResponseHeader &header, QIODevice
 }
 
 
+qint64 TActionForkProcess::writeResponseData(const QByteArray &data, bool)
+{
+    return httpSocket->writeRawData(data.data(), data.length());
+}
+
+
 void TActionForkProcess::closeHttpSocket()
 {
     httpSocket->close();
@@ -20,6 +20,7 @@ public:
 protected:
     virtual void emitError(int socketError);
     virtual qint64 writeResponse(THttpResponseHeader &header, QIODevice *body);
+    virtual qint64 writeResponseData(const QByteArray &data, bool last);
     virtual void closeHttpSocket();
 
     static TActionForkProcess *currentActionContext;
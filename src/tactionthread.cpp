@@ -152,6 +152,12 @@ qint64 TActionThread::writeResponse(THttpResponseHeader &header, QIODevice *body
 }
 
 
+qint64 TActionThread::writeResponseData(const QByteArray &data, bool)
+{
+    return httpSocket->writeRawData(data.data(), data.length());
+}
+
+
 void TActionThread::closeHttpSocket()
 {
     httpSocket->close();
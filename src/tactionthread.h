@@ -26,6 +26,7 @@ protected:
     void emitError(int socketError);
 
     qint64 writeResponse(THttpResponseHeader &header, QIODevice *body);
+    qint64 writeResponseData(const QByteArray &data, bool last);
     void closeHttpSocket();
 
 signals:
@@ -21,9 +21,20 @@
   Constructor.
 */
 TActionView::TActionView()
-    : QObject(), TViewHelper(), TPrototypeAjaxHelper(), actionController(0), subView(0)
+    : QObject(), TViewHelper(), TPrototypeAjaxHelper(), actionController(0), subView(0), utf8Output(false)
 { }
 
+/*!
+  Returns the output of the view in UTF-8. Views generated in UTF-8
+  mode reimplement this function to write the bytes directly, without
+  converting the string returned by toString().
+  \sa isUtf8Output()
+*/
+QByteArray TActionView::toUtf8()
+{
+    return toString().toUtf8();
+}
+
 /*!
   Returns a content processed by a action.
 */
@@ -32,6 +43,14 @@ QString TActionView::yield() const
     return (subView) ? subView->toString() : QString();
 }
 
+/*!
+  Returns a content processed by a action in UTF-8.
+*/
+QByteArray TActionView::yieldUtf8() const
+{
+    return (subView) ? subView->toUtf8() : QByteArray();
+}
+
 /*!
   Render the partial template given by \a templateName without layout.
 */
@@ -58,8 +77,7 @@ QString TActionView::authenticityToken() const
 */
 QString TActionView::echo(const THtmlAttribute &attr)
 {
-    responsebody += attr.toString().trimmed();
-    return QString();
+    return echo(attr.toString().trimmed());
 }
 
 /*!
@@ -68,7 +86,7 @@ QString TActionView::echo(const THtmlAttribute &attr)
 */
 QString TActionView::eh(const THtmlAttribute &attr)
 {
-    return echo(THttpUtility::htmlEscape(attr.toString().trimmed()));
+    return eh(attr.toString().trimmed());
 }
 
 /*!
@@ -153,6 +171,12 @@ const THttpRequest &TActionView::httpRequest() const
   string to render a view.
 */
 
+/*!
+  \fn bool TActionView::isUtf8Output() const
+  Returns true if the view writes its output in UTF-8 by echo() and
+  eh(); otherwise returns false.
+*/
+
 /*!
   \fn QVariant TActionView::variant(const QString &name) const
   Returns the value associated with the \a name in the QVariantMap
@@ -21,7 +21,10 @@ public:
     virtual ~TActionView() { }
 
     virtual QString toString() = 0;
+    virtual QByteArray toUtf8();
+    bool isUtf8Output() const { return utf8Output; }
     QString yield() const;
+    QByteArray yieldUtf8() const;
     QString renderPartial(const QString &templateName, const QVariantMap &vars = QVariantMap()) const;
     QString authenticityToken() const;
     QVariant variant(const QString &name) const;
@@ -52,7 +55,9 @@ protected:
     QString eh(double d, char format = 'g', int precision = 6);
     QString eh(const THtmlAttribute &attr);
     QString eh(const QVariant &var);
+    void setUtf8Output(bool enable) { utf8Output = enable; }
     QString responsebody;
+    QByteArray responsebytes;  // output of a view generated in UTF-8 mode
 
 private:
     Q_DISABLE_COPY(TActionView)
@@ -65,6 +70,7 @@ private:
     TActionController *actionController;
     TActionView *subView;
     QVariantMap variantMap;
+    bool utf8Output;
 
     friend class TActionController;
     friend class TActionMailer;
@@ -99,77 +105,126 @@ inline bool TActionView::hasVariant(const QString &name) const
 
 inline QString TActionView::echo(const QString &str)
 {
-    responsebody += str;
+    if (utf8Output) {
+        responsebytes += str.toUtf8();
+    } else {
+        responsebody += str;
+    }
     return QString();
 }
 
 inline QString TActionView::echo(const char *str)
 {
-    responsebody += QString(str);  // using codecForCStrings()
-    return QString();
+    // Appends the UTF-8 bytes as they are on Qt4 too, where
+    // codecForCStrings() may be Latin-1
+    if (utf8Output) {
+        responsebytes += str;
+        return QString();
+    }
+    return echo(QString(str));  // using codecForCStrings()
 }
 
 inline QString TActionView::echo(const QByteArray &str)
 {
-    responsebody += QString(str);  // using codecForCStrings()
-    return QString();
+    if (utf8Output) {
+        responsebytes += str;
+        return QString();
+    }
+    return echo(QString(str));  // using codecForCStrings()
 }
 
 inline QString TActionView::echo(int n, int base)
 {
-    responsebody += QString::number(n, base);
+    if (utf8Output) {
+        responsebytes += QByteArray::number(n, base);
+    } else {
+        responsebody += QString::number(n, base);
+    }
     return QString();
 }
 
 inline QString TActionView::echo(long n, int base)
 {
-    responsebody += QString::number(n, base);
+    if (utf8Output) {
+        responsebytes += QByteArray::number((qlonglong)n, base);
+    } else {
+        responsebody += QString::number(n, base);
+    }
     return QString();
 }
 
 inline QString TActionView::echo(ulong n, int base)
 {
-    responsebody += QString::number(n, base);
+    if (utf8Output) {
+        responsebytes += QByteArray::number((qulonglong)n, base);
+    } else {
+        responsebody += QString::number(n, base);
+    }
     return QString();
 }
 
 inline QString TActionView::echo(qlonglong n, int base)
 {
-    responsebody += QString::number(n, base);
+    if (utf8Output) {
+        responsebytes += QByteArray::number(n, base);
+    } else {
+        responsebody += QString::number(n, base);
+    }
     return QString();
 }
 
 inline QString TActionView::echo(qulonglong n, int base)
 {
-    responsebody += QString::number(n, base);
+    if (utf8Output) {
+        responsebytes += QByteArray::number(n, base);
+    } else {
+        responsebody += QString::number(n, base);
+    }
     return QString();
 }
 
 inline QString TActionView::echo(double d, char format, int precision)
 {
-    responsebody += QString::number(d, format, precision);
+    if (utf8Output) {
+        responsebytes += QByteArray::number(d, format, precision);
+    } else {
+        responsebody += QString::number(d, format, precision);
+    }
     return QString();
 }
 
 inline QString TActionView::echo(const QVariant &var)
 {
-    responsebody += var.toString();
-    return QString();
+    return echo(var.toString());
 }
 
 inline QString TActionView::eh(const QString &str)
 {
-    return echo(THttpUtility::htmlEscape(str));
+    // Escapes into the output directly
+    if (utf8Output) {
+        THttpUtility::appendHtmlEscaped(responsebytes, str.toUtf8());
+    } else {
+        THttpUtility::appendHtmlEscaped(responsebody, str);
+    }
+    return QString();
 }
 
 inline QString TActionView::eh(const char *str)
 {
-    return echo(THttpUtility::htmlEscape(str));
+    if (utf8Output) {
+        THttpUtility::appendHtmlEscaped(responsebytes, QByteArray::fromRawData(str, qstrlen(str)));
+        return QString();
+    }
+    return eh(QString(str));  // using codecForCStrings()
 }
 
 inline QString TActionView::eh(const QByteArray &str)
 {
-    return echo(THttpUtility::htmlEscape(str));
+    if (utf8Output) {
+        THttpUtility::appendHtmlEscaped(responsebytes, str);
+        return QString();
+    }
+    return eh(QString(str));  // using codecForCStrings()
 }
 
 inline QString TActionView::eh(int n, int base)
@@ -204,7 +259,7 @@ inline QString TActionView::eh(double d, char format, int precision)
 
 inline QString TActionView::eh(const QVariant &var)
 {
-    return echo(THttpUtility::htmlEscape(var.toString()));
+    return eh(var.toString());
 }
 
 inline void TActionView::setController(TActionController *controller)
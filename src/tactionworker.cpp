@@ -9,23 +9,21 @@
 #include <THttpRequest>
 #include <TMultiplexingServer>
 #include <QCoreApplication>
-#include <QAtomicInt>
-#include "thttpsocket.h"
-#include "tepollhttpsocket.h"
+#include "tactionworkerpool.h"
 #include "tepoll.h"
+#include "tsendbuffer.h"
 #include "tsystemglobal.h"
 
-// Counter of action workers  (Note: workerCount != contextCount)
-QAtomicInt workerCounter;
-
+const int MaxPendingStreamBytes = 1024 * 1024;
+const int StreamSendTimeout = 30000;  // msecs
 
+/*!
+  Returns the number of requests queued or being executed by the
+  action workers.  (Note: workerCount != contextCount)
+ */
 int TActionWorker::workerCount()
 {
-#if QT_VERSION >= 0x050000
-    return workerCounter.load();
-#else
-    return (int)workerCounter;
-#endif
+    return TActionWorkerPool::jobCount();
 }
 
 
@@ -48,22 +46,19 @@ bool TActionWorker::waitForAllDone(int msec)
 
 /*!
   \class TActionWorker
-  \brief The TActionWorker class provides a thread context.
+  \brief The TActionWorker class provides a thread context of the
+  worker pool.
 */
 
-TActionWorker::TActionWorker(TEpollHttpSocket *socket, QObject *parent)
-    : QThread(parent), TActionContext(), httpRequest(), clientAddr(), socketUuid(socket->socketUuid())
-{
-    workerCounter.fetchAndAddOrdered(1);
-    httpRequest = socket->readRequest();
-    clientAddr = socket->clientAddress().toString();
-}
+TActionWorker::TActionWorker(TActionWorkerPool *pool, QObject *parent)
+    : QThread(parent), TActionContext(), workerPool(pool), socketId(0),
+      sendingBytes(new TPendingBytes), streamAborted(false)
+{ }
 
 
 TActionWorker::~TActionWorker()
 {
     tSystemDebug("TActionWorker::~TActionWorker");
-    workerCounter.fetchAndAddOrdered(-1);
 }
 
 
@@ -84,38 +79,90 @@ qint64 TActionWorker::writeResponse(THttpResponseHeader &header, QIODevice *body
     }
 
     if (!TActionContext::stopped) {
-        TEpoll::instance()->setSendData(socketUuid, header.toByteArray(), body, autoRemove, accessLogger);
+        TEpoll::instance(socketId)->setSendData(socketId, header.toByteArray(), body, autoRemove, accessLogger);
     }
     accessLogger.close();  // not write in this thread
     return 0;
 }
 
 
+/*!
+  Sends the \a data of a streaming response. Waits while the data sent
+  before still occupies the send queue beyond MaxPendingStreamBytes, so
+  the memory held by a stream is bounded however fast it is produced.
+  If the client does not read the data for StreamSendTimeout msecs,
+  closes the socket and returns -1.
+ */
+qint64 TActionWorker::writeResponseData(const QByteArray &data, bool last)
+{
+    if (TActionContext::stopped || streamAborted) {
+        return -1;
+    }
+
+    TEpoll *epoll = TEpoll::instance(socketId);
+    if (last) {
+        // The access log is written after the last data sent
+        epoll->setSendData(socketId, data, 0, false, accessLogger);
+        accessLogger.close();  // not write in this thread
+        return data.length();
+    }
+
+    // Woken up when the data is sent
+    QTime time;
+    time.start();
+    while (!sendingBytes->waitForLessThan(MaxPendingStreamBytes + 1, 100)) {
+        if (TActionContext::stopped) {
+            return -1;
+        }
+        if (time.elapsed() > StreamSendTimeout) {
+            tSystemWarn("Streaming response timed out, closing the socket  [socket:%llu]", socketId);
+            streamAborted = true;
+            closeHttpSocket();
+            return -1;
+        }
+    }
+
+    epoll->setSendData(socketId, data, sendingBytes);
+    return data.length();
+}
+
+
 void TActionWorker::closeHttpSocket()
 {
     if (!TActionContext::stopped) {
-        TEpoll::instance()->setDisconnect(socketUuid);
+        TEpoll::instance(socketId)->setDisconnect(socketId);
     }
 }
 
 
 void TActionWorker::run()
 {
-    QList<THttpRequest> reqs = THttpRequest::generate(httpRequest, QHostAddress(clientAddr));
+    TActionJob *job;
+
+    // Executes jobs until the pool stops
+    while ((job = workerPool->dequeue())) {
+        socketId = job->socketId;
+        streamAborted = false;
+        QList<THttpRequest> reqs = THttpRequest::generate(job->httpRequest, job->clientAddress, job->requestHeader, job->headerLength);
+
+        // Loop for HTTP-pipeline requests
+        for (QMutableListIterator<THttpRequest> it(reqs); it.hasNext(); ) {
+            THttpRequest &req = it.next();
 
-    // Loop for HTTP-pipeline requests
-    for (QMutableListIterator<THttpRequest> it(reqs); it.hasNext(); ) {
-        THttpRequest &req = it.next();
+            // Executes a action context
+            TActionContext::execute(req);
+            TActionContext::release();
 
-        // Executes a action context
-        TActionContext::execute(req);
-        TActionContext::release();
+            if (TActionContext::stopped) {
+                break;
+            }
+        }
+
+        socketId = 0;
+        workerPool->finish(job);
 
         if (TActionContext::stopped) {
             break;
         }
     }
-
-    httpRequest.clear();
-    clientAddr.clear();
 }
@@ -2,19 +2,21 @@
 #define TACTIONWORKER_H
 
 #include <QThread>
+#include <QSharedPointer>
 #include <TActionContext>
 
 class THttpRequest;
 class THttpResponseHeader;
-class TEpollHttpSocket;
+class TActionWorkerPool;
 class QIODevice;
+class TPendingBytes;
 
 
 class T_CORE_EXPORT TActionWorker : public QThread, public TActionContext
 {
     Q_OBJECT
 public:
-    TActionWorker(TEpollHttpSocket *socket, QObject *parent = 0);
+    TActionWorker(TActionWorkerPool *pool, QObject *parent = 0);
     ~TActionWorker();
     static int workerCount();
     static bool waitForAllDone(int msec);
@@ -22,12 +24,14 @@ public:
 protected:
     void run();
     qint64 writeResponse(THttpResponseHeader &header, QIODevice *body);
+    qint64 writeResponseData(const QByteArray &data, bool last);
     void closeHttpSocket();
 
 private:
-    QByteArray httpRequest;
-    QString clientAddr;
-    QByteArray socketUuid;
+    TActionWorkerPool *workerPool;
+    quint64 socketId;
+    QSharedPointer<TPendingBytes> sendingBytes;  // streamed data waiting in the send queue
+    bool streamAborted;
 
     Q_DISABLE_COPY(TActionWorker)
 };
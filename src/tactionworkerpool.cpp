@@ -0,0 +1,200 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QThread>
+#include <QMutexLocker>
+#include <TActionWorker>
+#include "tactionworkerpool.h"
+#include "tepollhttpsocket.h"
+#include "tepoll.h"
+#include "tsystemglobal.h"
+
+const int MinRunQueueSize = 1024;
+const int IdleWaitMsecs = 100;
+
+static TActionWorkerPool *workerPool = 0;
+static QAtomicInt jobCounter;  // Jobs queued or executing
+
+
+static inline int atomicLoad(const QAtomicInt &value)
+{
+#if QT_VERSION >= 0x050000
+    return value.loadAcquire();
+#else
+    return (int)value;
+#endif
+}
+
+/*!
+  \class TActionWorkerPool
+  \brief The TActionWorkerPool class provides a fixed-size pool of action
+  worker threads fed by a lock-free run queue.
+*/
+
+TActionWorkerPool::TActionWorkerPool()
+    : runQueue(0), workers(),
+      sleepers(0), stopped(0), mutex(), jobReady()
+{ }
+
+
+TActionWorkerPool::~TActionWorkerPool()
+{
+    stop(10000);
+}
+
+
+TActionWorkerPool *TActionWorkerPool::instance()
+{
+    if (Q_UNLIKELY(!workerPool)) {
+        workerPool = new TActionWorkerPool();
+    }
+    return workerPool;
+}
+
+
+int TActionWorkerPool::jobCount()
+{
+    return atomicLoad(jobCounter);
+}
+
+
+void TActionWorkerPool::start(int numWorkers)
+{
+    if (isRunning())
+        return;
+
+    numWorkers = qMax(numWorkers, 1);
+    int size = MinRunQueueSize;
+    while (size < numWorkers * 16) {
+        size <<= 1;
+    }
+
+    runQueue = new TAtomicRingBuffer<TActionJob *>(size);
+
+    stopped.fetchAndStoreOrdered(0);
+    for (int i = 0; i < numWorkers; ++i) {
+        TActionWorker *worker = new TActionWorker(this);
+        workers << worker;
+        worker->start();
+    }
+    tSystemDebug("Action worker pool started  workers:%d  queue:%d", numWorkers, size);
+}
+
+
+void TActionWorkerPool::stop(int msec)
+{
+    if (!isRunning())
+        return;
+
+    stopped.fetchAndStoreOrdered(1);
+    mutex.lock();
+    jobReady.wakeAll();
+    mutex.unlock();
+
+    for (QListIterator<TActionWorker *> it(workers); it.hasNext(); ) {
+        TActionWorker *worker = it.next();
+        if (!worker->wait(msec)) {
+            tSystemWarn("Action worker did not finish in %d msecs", msec);
+            worker->terminate();
+            worker->wait();
+        }
+        delete worker;
+    }
+    workers.clear();
+
+    // Discards the jobs left; the event loops have stopped already
+    TActionJob *job;
+    while ((job = pop())) {
+        delete job;
+        jobCounter.fetchAndAddOrdered(-1);
+    }
+
+    delete runQueue;
+    runQueue = 0;
+}
+
+
+/*!
+  Reads the HTTP request from the \a socket and queues it to be executed
+  by a worker thread. Called in the epoll thread.
+ */
+void TActionWorkerPool::enqueue(TEpollHttpSocket *socket)
+{
+    // Takes the parsed header before readRequest() clears it
+    THttpRequestHeader header = socket->requestHeader;
+    int headerLength = socket->headerLength;
+    enqueue(new TActionJob(header, headerLength, socket->readRequest(), socket->clientAddress(), socket->socketId()));
+}
+
+/*!
+  Queues the \a job to be executed by a worker thread. The pool takes
+  ownership of it.
+ */
+void TActionWorkerPool::enqueue(TActionJob *job)
+{
+    jobCounter.fetchAndAddOrdered(1);
+
+    if (Q_UNLIKELY(!runQueue)) {
+        finish(job);  // not running
+        return;
+    }
+    runQueue->enqueue(job);  // never blocks; spills over when the ring is full
+
+    if (atomicLoad(sleepers) > 0) {
+        QMutexLocker locker(&mutex);
+        jobReady.wakeOne();
+    }
+}
+
+
+/*!
+  Takes a job from the run queue, blocking while the queue is empty.
+  Returns 0 if the pool is stopped. Called in worker threads.
+ */
+TActionJob *TActionWorkerPool::dequeue()
+{
+    for (;;) {
+        TActionJob *job = pop();
+        if (job) {
+            return job;
+        }
+
+        if (atomicLoad(stopped)) {
+            return 0;
+        }
+
+        QMutexLocker locker(&mutex);
+        sleepers.fetchAndAddOrdered(1);
+        job = pop();  // re-check after announcing to sleep
+        if (!job && !atomicLoad(stopped)) {
+            jobReady.wait(&mutex, IdleWaitMsecs);
+        }
+        sleepers.fetchAndAddOrdered(-1);
+
+        if (job) {
+            return job;
+        }
+    }
+}
+
+
+void TActionWorkerPool::finish(TActionJob *job)
+{
+    TEpoll::instance(job->socketId)->setWorkerFinished(job->socketId);
+    delete job;
+    jobCounter.fetchAndAddOrdered(-1);
+}
+
+
+TActionJob *TActionWorkerPool::pop()
+{
+    TActionJob *job = 0;
+    if (Q_LIKELY(runQueue)) {
+        runQueue->dequeue(&job, 1);
+    }
+    return job;
+}
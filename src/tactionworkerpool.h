@@ -0,0 +1,64 @@
+#ifndef TACTIONWORKERPOOL_H
+#define TACTIONWORKERPOOL_H
+
+#include <QList>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+#include <TGlobal>
+#include <THttpRequestHeader>
+#include <TAtomicQueue>
+
+class TActionWorker;
+class TEpollHttpSocket;
+
+
+class TActionJob
+{
+public:
+    TActionJob(const THttpRequestHeader &header, int headerLen, const QByteArray &request, const QHostAddress &address, quint64 id)
+        : requestHeader(header), headerLength(headerLen), httpRequest(request), clientAddress(address), socketId(id)
+    { }
+
+    THttpRequestHeader requestHeader;  // parsed in the epoll thread
+    int headerLength;
+    QByteArray httpRequest;
+    QHostAddress clientAddress;
+    quint64 socketId;
+};
+
+
+class T_CORE_EXPORT TActionWorkerPool
+{
+public:
+    ~TActionWorkerPool();
+
+    void start(int numWorkers);
+    void stop(int msec);
+    bool isRunning() const { return !workers.isEmpty(); }
+    int poolSize() const { return workers.count(); }
+    void enqueue(TEpollHttpSocket *socket);
+    void enqueue(TActionJob *job);
+    TActionJob *dequeue();
+    void finish(TActionJob *job);
+
+    static int jobCount();
+    static TActionWorkerPool *instance();
+
+private:
+    TActionJob *pop();
+
+    TAtomicRingBuffer<TActionJob *> *runQueue;
+    QList<TActionWorker *> workers;
+    QAtomicInt sleepers;
+    QAtomicInt stopped;
+    QMutex mutex;
+    QWaitCondition jobReady;
+
+    TActionWorkerPool();
+    Q_DISABLE_COPY(TActionWorkerPool)
+};
+
+#endif // TACTIONWORKERPOOL_H
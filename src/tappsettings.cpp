@@ -36,6 +36,11 @@ public:
         insert(Tf::LimitRequestBody, "LimitRequestBody");
         insert(Tf::EnableCsrfProtectionModule, "EnableCsrfProtectionModule");
         insert(Tf::EnableHttpMethodOverride, "EnableHttpMethodOverride");
+        insert(Tf::StaticFileCacheSize, "StaticFileCacheSize");
+        insert(Tf::HttpCompressionEnabled, "HttpCompression.Enabled");
+        insert(Tf::HttpCompressionLevel, "HttpCompression.Level");
+        insert(Tf::HttpCompressionMinLength, "HttpCompression.MinLength");
+        insert(Tf::HttpCompressionMimeTypes, "HttpCompression.MimeTypes");
         insert(Tf::SessionName, "Session.Name");
         insert(Tf::SessionStoreType, "Session.StoreType");
         insert(Tf::SessionAutoIdRegeneration, "Session.AutoIdRegeneration");
@@ -45,6 +50,7 @@ public:
         insert(Tf::SessionGcMaxLifeTime, "Session.GcMaxLifeTime");
         insert(Tf::SessionSecret, "Session.Secret");
         insert(Tf::SessionCsrfProtectionKey, "Session.CsrfProtectionKey");
+        insert(Tf::SessionCacheSize, "Session.CacheSize");
         insert(Tf::MPMThreadMaxAppServers, "MPM.thread.MaxAppServers");
         insert(Tf::MPMThreadMaxThreadsPerAppServer, "MPM.thread.MaxThreadsPerAppServer");
         insert(Tf::MPMPreforkMaxAppServers, "MPM.prefork.MaxAppServers");
@@ -4,6 +4,7 @@
 #include <QAtomicPointer>
 #include <QList>
 #include <QMutex>
+#include <QMutexLocker>
 #include <QWaitCondition>
 
 
@@ -68,4 +69,178 @@ inline bool TAtomicQueue<T>::wait(int timeout)
     return ret;
 }
 
+
+/*!
+  \class TAtomicRingBuffer
+  \brief The TAtomicRingBuffer class is a lock-free bounded MPMC queue
+  with an unbounded fallback list used while the ring is full.
+  Items of one producer are dequeued in FIFO order.
+*/
+template<class T>
+class TAtomicRingBuffer
+{
+public:
+    TAtomicRingBuffer(int capacity = 1024);
+    ~TAtomicRingBuffer();
+
+    int capacity() const { return mask + 1; }
+    bool tryEnqueue(const T &t);
+    void enqueue(const T &t);
+    bool tryDequeue(T &t);
+    int dequeue(T *buffer, int maxCount);
+    bool isEmpty() const;
+
+private:
+    struct Cell {
+        QAtomicInt sequence;
+        T data;
+    };
+
+    static int load(const QAtomicInt &value);
+
+    Cell *cells;
+    int mask;
+    char pad0[64];
+    QAtomicInt enqueuePos;
+    char pad1[64 - sizeof(QAtomicInt)];
+    QAtomicInt dequeuePos;
+    char pad2[64 - sizeof(QAtomicInt)];
+    QAtomicInt overflowCount;
+    QMutex overflowMutex;
+    QList<T> overflow;
+
+    Q_DISABLE_COPY(TAtomicRingBuffer)
+};
+
+
+template <class T>
+inline TAtomicRingBuffer<T>::TAtomicRingBuffer(int capacity)
+    : cells(0), mask(0), enqueuePos(0), dequeuePos(0),
+      overflowCount(0), overflowMutex(), overflow()
+{
+    int size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    cells = new Cell[size];
+    mask = size - 1;
+    for (int i = 0; i < size; ++i) {
+        cells[i].sequence.fetchAndStoreRelease(i);
+    }
+}
+
+
+template <class T>
+inline TAtomicRingBuffer<T>::~TAtomicRingBuffer()
+{
+    delete[] cells;
+}
+
+
+template <class T>
+inline int TAtomicRingBuffer<T>::load(const QAtomicInt &value)
+{
+#if QT_VERSION >= 0x050000
+    return value.loadAcquire();
+#else
+    return (int)value;
+#endif
+}
+
+template <class T>
+inline bool TAtomicRingBuffer<T>::tryEnqueue(const T &t)
+{
+    Cell *cell;
+    int pos = load(enqueuePos);
+
+    for (;;) {
+        cell = &cells[pos & mask];
+        int dif = (int)((uint)load(cell->sequence) - (uint)pos);
+
+        if (dif == 0) {
+            if (enqueuePos.testAndSetOrdered(pos, (int)((uint)pos + 1))) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;  // full
+        }
+        pos = load(enqueuePos);
+    }
+
+    cell->data = t;
+    cell->sequence.fetchAndStoreRelease((int)((uint)pos + 1));
+    return true;
+}
+
+
+template <class T>
+inline void TAtomicRingBuffer<T>::enqueue(const T &t)
+{
+    // Keeps FIFO order while the fallback list has items
+    if (load(overflowCount) > 0 || !tryEnqueue(t)) {
+        QMutexLocker locker(&overflowMutex);
+        overflow << t;
+        overflowCount.fetchAndStoreOrdered(overflow.count());
+    }
+}
+
+
+template <class T>
+inline bool TAtomicRingBuffer<T>::tryDequeue(T &t)
+{
+    Cell *cell;
+    int pos = load(dequeuePos);
+
+    for (;;) {
+        cell = &cells[pos & mask];
+        int dif = (int)((uint)load(cell->sequence) - (uint)pos - 1);
+
+        if (dif == 0) {
+            if (dequeuePos.testAndSetOrdered(pos, (int)((uint)pos + 1))) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;  // empty
+        }
+        pos = load(dequeuePos);
+    }
+
+    t = cell->data;
+    cell->data = T();
+    cell->sequence.fetchAndStoreRelease((int)((uint)pos + mask + 1));
+    return true;
+}
+
+/*!
+  Dequeues up to \a maxCount items into the \a buffer and returns the
+  number of them.
+ */
+template <class T>
+inline int TAtomicRingBuffer<T>::dequeue(T *buffer, int maxCount)
+{
+    int cnt = 0;
+    while (cnt < maxCount && tryDequeue(buffer[cnt])) {
+        ++cnt;
+    }
+
+    if (cnt < maxCount && load(overflowCount) > 0) {
+        QMutexLocker locker(&overflowMutex);
+        while (cnt < maxCount && !overflow.isEmpty()) {
+            buffer[cnt++] = overflow.takeFirst();
+        }
+        overflowCount.fetchAndStoreOrdered(overflow.count());
+    }
+    return cnt;
+}
+
+
+template <class T>
+inline bool TAtomicRingBuffer<T>::isEmpty() const
+{
+    int pos = load(dequeuePos);
+    int dif = (int)((uint)load(cells[pos & mask].sequence) - (uint)pos - 1);
+    return dif < 0 && load(overflowCount) == 0;
+}
+
 #endif // TATOMICQUEUE_H
@@ -4,6 +4,9 @@
 #include <QMetaObject>
 #include <QVariant>
 #include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
 #include <TCriteria>
 #include <TSqlQuery>
 #include <TGlobal>
@@ -81,9 +84,17 @@ class TCriteriaConverter
 public:
     TCriteriaConverter(const TCriteria &cri, const QSqlDatabase &db) : criteria(cri), database(db) { }
     QString toString() const;
+    QString toParameterizedString(QVariantList &values) const;
     static QString propertyName(int property);
 
 protected:
+    enum { MaxCachedStatements = 256 };
+
+    static const QStringList &propertyNames();
+    static QStringList resolvePropertyNames();
+    static void compile(const QVariant &var, QByteArray &shape, QString *sql, QVariantList &values, const QSqlDatabase &database);
+    static QList<QVariant> formattableValues(const QVariant &list, const QSqlDatabase &database);
+    static bool isFormattable(const QVariant &val, const QSqlDatabase &database);
     static QString criteriaToString(const QVariant &cri, const QSqlDatabase &database);
     static QString criteriaToString(const QString &propertyName, TSql::ComparisonOperator op, const QVariant &val1, const QVariant &val2, const QSqlDatabase &database);
     static QString criteriaToString(const QString &propertyName, TSql::ComparisonOperator op1, TSql::ComparisonOperator op2, const QVariant &val, const QSqlDatabase &database);
@@ -102,6 +113,239 @@ inline QString TCriteriaConverter<T>::toString() const
 }
 
 
+/*!
+  Returns a WHERE clause with '?' placeholders converted from the criteria
+  and sets the values to bind to \a values in the order of the
+  placeholders. The clause is cached by the structure of the criteria,
+  so that criteria which differ only in their values are converted to the
+  same statement once and the statement can be reused as a prepared one.
+*/
+template <class T>
+inline QString TCriteriaConverter<T>::toParameterizedString(QVariantList &values) const
+{
+    static QMutex mutex;
+    static QHash<QByteArray, QString> statements;
+
+    QByteArray shape;
+    shape.reserve(64);
+    values.clear();
+    QVariant var = QVariant::fromValue(criteria);
+    compile(var, shape, 0, values, database);
+
+    QMutexLocker locker(&mutex);
+    QHash<QByteArray, QString>::const_iterator it = statements.constFind(shape);
+    if (it != statements.constEnd()) {
+        return it.value();
+    }
+    locker.unlock();
+
+    QString sql;
+    QByteArray dummyShape;
+    QVariantList dummyValues;
+    compile(var, dummyShape, &sql, dummyValues, database);
+
+    locker.relock();
+    if (statements.count() >= MaxCachedStatements) {
+        statements.clear();
+    }
+    statements.insert(shape, sql);
+    return sql;
+}
+
+/*!
+  Walks the criteria \a var, appending its structure to \a shape and
+  the values to bind to \a values. If \a sql is not null, the WHERE
+  clause with placeholders is appended to it. The values are skipped in
+  the same way as criteriaToString() does for the \a database, so that
+  both produce the same condition.
+*/
+template <class T>
+inline void TCriteriaConverter<T>::compile(const QVariant &var, QByteArray &shape, QString *sql, QVariantList &values, const QSqlDatabase &database)
+{
+    static const QLatin1String Placeholder("?");
+
+    if (var.isNull()) {
+        shape += 'n';
+        return;
+    }
+
+    if (var.canConvert<TCriteria>()) {
+        TCriteria cri = var.value<TCriteria>();
+        if (cri.isEmpty()) {
+            shape += 'e';
+            return;
+        }
+
+        QString s1, s2;
+        shape += '(';
+        compile(cri.first(), shape, (sql) ? &s1 : 0, values, database);
+        shape += (char)('0' + cri.logicalOperator());
+        compile(cri.second(), shape, (sql) ? &s2 : 0, values, database);
+        shape += ')';
+        if (sql) {
+            *sql += join(s1, cri.logicalOperator(), s2);
+        }
+
+    } else if (var.canConvert<TCriteriaData>()) {
+        TCriteriaData cri = var.value<TCriteriaData>();
+        const QString &name = propertyNames().value(cri.property);
+        if (cri.isEmpty() || name.isEmpty()) {
+            shape += 'e';
+            return;
+        }
+
+        QList<QVariant> lst;
+        int kind = 0;
+        bool pair = false;  // both of the two values formattable
+        if (cri.op1 != TSql::Invalid && cri.op2 != TSql::Invalid && !cri.val1.isNull()) {
+            kind = 1;
+            lst = formattableValues(cri.val1, database);
+        } else if (cri.op1 != TSql::Invalid && !cri.val1.isNull() && !cri.val2.isNull()) {
+            kind = 2;
+            pair = isFormattable(cri.val1, database) && isFormattable(cri.val2, database);
+        } else {
+            kind = 3;
+            if (cri.op1 == TSql::In || cri.op1 == TSql::NotIn) {
+                lst = formattableValues(cri.val1, database);
+            } else {
+                lst = cri.val1.toList();
+                pair = (lst.count() == 2 && isFormattable(lst[0], database) && isFormattable(lst[1], database));
+            }
+        }
+
+        int data[] = { kind, cri.property, cri.op1, cri.op2, lst.count(), pair };
+        shape += 'd';
+        shape.append((const char *)data, sizeof(data));
+
+        switch (kind) {
+        case 1:
+            if (cri.op2 == TSql::Any || cri.op2 == TSql::All) {
+                values += lst;
+                if (sql) {
+                    QString str = QString("?,").repeated(lst.count());
+                    str.chop(1);
+                    *sql += name + TSql::formats().value(cri.op1).arg(TSql::formats().value(cri.op2).arg(str));
+                }
+            } else {
+                tWarn("Invalid parameters  [%s:%d]", __FILE__, __LINE__);
+            }
+            break;
+
+        case 2:
+            switch (cri.op1) {
+            case TSql::LikeEscape:
+            case TSql::NotLikeEscape:
+            case TSql::ILikeEscape:
+            case TSql::NotILikeEscape:
+            case TSql::Between:
+            case TSql::NotBetween:
+                if (pair) {
+                    values << cri.val1 << cri.val2;
+                    if (sql) {
+                        *sql += "(" + name + TSql::formats().value(cri.op1).arg(Placeholder, Placeholder) + ")";
+                    }
+                } else {
+                    tWarn("Invalid parameters  [%s:%d]", __FILE__, __LINE__);
+                }
+                break;
+
+            default:
+                tWarn("Invalid parameters  [%s:%d]", __FILE__, __LINE__);
+                break;
+            }
+            break;
+
+        default:
+            switch (cri.op1) {
+            case TSql::Equal:
+            case TSql::NotEqual:
+            case TSql::LessThan:
+            case TSql::GreaterThan:
+            case TSql::LessEqual:
+            case TSql::GreaterEqual:
+            case TSql::Like:
+            case TSql::NotLike:
+            case TSql::ILike:
+            case TSql::NotILike:
+                values << cri.val1;
+                if (sql) {
+                    *sql += name + TSql::formats().value(cri.op1).arg(Placeholder);
+                }
+                break;
+
+            case TSql::In:
+            case TSql::NotIn:
+                if (!lst.isEmpty()) {
+                    values += lst;
+                    if (sql) {
+                        QString str = QString("?,").repeated(lst.count());
+                        str.chop(1);
+                        *sql += name + TSql::formats().value(cri.op1).arg(str);
+                    }
+                } else {
+                    tWarn("error parameter");
+                }
+                break;
+
+            case TSql::LikeEscape:
+            case TSql::NotLikeEscape:
+            case TSql::ILikeEscape:
+            case TSql::NotILikeEscape:
+            case TSql::Between:
+            case TSql::NotBetween:
+                if (pair) {
+                    values << lst[0] << lst[1];
+                    if (sql) {
+                        *sql += "(" + name + TSql::formats().value(cri.op1).arg(Placeholder, Placeholder) + ")";
+                    }
+                }
+                break;
+
+            case TSql::IsNull:
+            case TSql::IsNotNull:
+                if (sql) {
+                    *sql += name + TSql::formats().value(cri.op1);
+                }
+                break;
+
+            default:
+                tWarn("error parameter");
+                break;
+            }
+            break;
+        }
+
+    } else {
+        tSystemError("Logic error [%s:%d]", __FILE__, __LINE__);
+    }
+}
+
+
+/*!
+  Returns the values of the list \a list except the ones formatted to
+  an empty string for the \a database, which criteriaToString() skips.
+*/
+template <class T>
+inline QList<QVariant> TCriteriaConverter<T>::formattableValues(const QVariant &list, const QSqlDatabase &database)
+{
+    QList<QVariant> ret;
+    for (QListIterator<QVariant> i(list.toList()); i.hasNext(); ) {
+        const QVariant &v = i.next();
+        if (isFormattable(v, database)) {
+            ret << v;
+        }
+    }
+    return ret;
+}
+
+
+template <class T>
+inline bool TCriteriaConverter<T>::isFormattable(const QVariant &val, const QSqlDatabase &database)
+{
+    return !TSqlQuery::formatValue(val, database).isEmpty();
+}
+
+
 template <class T>
 inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var, const QSqlDatabase &database)
 {
@@ -205,8 +449,29 @@ inline QString TCriteriaConverter<T>::criteriaToString(const QVariant &var, cons
 template <class T>
 inline QString TCriteriaConverter<T>::propertyName(int property)
 {
-    const QMetaObject *metaObject = T().metaObject();
-    return (metaObject) ? metaObject->property(metaObject->propertyOffset() + property).name() : QString();
+    return propertyNames().value(property);
+}
+
+/*!
+  Returns the names of the properties of T, which are resolved only once.
+*/
+template <class T>
+inline const QStringList &TCriteriaConverter<T>::propertyNames()
+{
+    static const QStringList names = resolvePropertyNames();
+    return names;
+}
+
+
+template <class T>
+inline QStringList TCriteriaConverter<T>::resolvePropertyNames()
+{
+    QStringList names;
+    const QMetaObject *metaObject = &T::staticMetaObject;
+    for (int i = metaObject->propertyOffset(); i < metaObject->propertyCount(); ++i) {
+        names << QString::fromLatin1(metaObject->property(i).name());
+    }
+    return names;
 }
 
 
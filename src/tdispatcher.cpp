@@ -0,0 +1,103 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QHash>
+#include <QVector>
+#include <QReadWriteLock>
+#include "tdispatcher.h"
+
+static const char *const paramSignatures[] = { "()", "(QString)",
+                                               "(QString,QString)",
+                                               "(QString,QString,QString)",
+                                               "(QString,QString,QString,QString)",
+                                               "(QString,QString,QString,QString,QString)",
+                                               "(QString,QString,QString,QString,QString,QString)",
+                                               "(QString,QString,QString,QString,QString,QString,QString)",
+                                               "(QString,QString,QString,QString,QString,QString,QString,QString)",
+                                               "(QString,QString,QString,QString,QString,QString,QString,QString,QString)",
+                                               "(QString,QString,QString,QString,QString,QString,QString,QString,QString,QString)" };
+
+typedef QVector<int> SlotIndexes;  // slot index by the number of arguments
+
+static QReadWriteLock lock;
+static QHash<QString, int> typeIds;
+static QHash<const QMetaObject *, QHash<QByteArray, SlotIndexes> > slotTable;
+
+/*!
+  \class TDispatchTable
+  \brief The TDispatchTable class caches the meta type IDs and the slot
+  indexes of actions resolved once, so that dispatching a request is
+  a hash lookup. This class is for internal use only.
+*/
+
+/*!
+  Returns the meta type ID of the class \a metaTypeName, or 0 if not
+  registered.
+ */
+int TDispatchTable::typeId(const QString &metaTypeName)
+{
+    lock.lockForRead();
+    int id = typeIds.value(metaTypeName, 0);
+    lock.unlock();
+
+    if (id <= 0) {
+        id = QMetaType::type(metaTypeName.toLatin1().constData());
+        if (id > 0) {
+            // Not caches unknown names, which come from request URLs
+            lock.lockForWrite();
+            typeIds.insert(metaTypeName, id);
+            lock.unlock();
+        }
+    }
+    return id;
+}
+
+/*!
+  Returns the index of the slot \a method of \a metaObject that takes
+  the most QString arguments up to \a argCount, or -1. The number of
+  its arguments is set to \a foundArgCount.
+ */
+int TDispatchTable::slotIndex(const QMetaObject *metaObject, const QByteArray &method, int argCount, int *foundArgCount)
+{
+    SlotIndexes indexes;
+    bool found;
+
+    lock.lockForRead();
+    QHash<const QMetaObject *, QHash<QByteArray, SlotIndexes> >::const_iterator it = slotTable.constFind(metaObject);
+    found = (it != slotTable.constEnd() && it->contains(method));
+    if (found) {
+        indexes = it->value(method);
+    }
+    lock.unlock();
+
+    if (!found) {
+        indexes.resize(MaxArguments + 1);
+        for (int i = 0; i <= MaxArguments; ++i) {
+            QByteArray sig = method + paramSignatures[i];
+            indexes[i] = metaObject->indexOfSlot(sig.constData());
+        }
+
+        // Caches only existing actions for the same reason as type IDs
+        bool exists = false;
+        for (int i = 0; i <= MaxArguments; ++i) {
+            exists |= (indexes[i] >= 0);
+        }
+        if (exists) {
+            lock.lockForWrite();
+            slotTable[metaObject].insert(method, indexes);
+            lock.unlock();
+        }
+    }
+
+    for (int i = qMin(argCount, (int)MaxArguments); i >= 0; --i) {
+        if (indexes[i] >= 0) {
+            *foundArgCount = i;
+            return indexes[i];
+        }
+    }
+    return -1;
+}
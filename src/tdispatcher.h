@@ -5,10 +5,21 @@
 #include <QMetaMethod>
 #include <QMetaObject>
 #include <QStringList>
+#include <QThread>
 #include <TGlobal>
 #include "tsystemglobal.h"
 
 
+class T_CORE_EXPORT TDispatchTable
+{
+public:
+    enum { MaxArguments = 10 };
+
+    static int typeId(const QString &metaTypeName);
+    static int slotIndex(const QMetaObject *metaObject, const QByteArray &method, int argCount, int *foundArgCount);
+};
+
+
 template <class T>
 class TDispatcher
 {
@@ -18,6 +29,8 @@ public:
 
     bool invoke(const QByteArray &method, const QStringList &args = QStringList(), Qt::ConnectionType connectionType = Qt::AutoConnection);
     T *object();
+    void setObject(T *object);
+    T *takeObject();
     QString typeName() const { return metaType; }
 
 private:
@@ -48,16 +61,6 @@ template <class T>
 inline bool TDispatcher<T>::invoke(const QByteArray &method, const QStringList &args, Qt::ConnectionType connectionType)
 {
     T_TRACEFUNC("");
-    static const char *const params[] = { "()", "(QString)",
-                                          "(QString,QString)",
-                                          "(QString,QString,QString)",
-                                          "(QString,QString,QString,QString)",
-                                          "(QString,QString,QString,QString,QString)",
-                                          "(QString,QString,QString,QString,QString,QString)",
-                                          "(QString,QString,QString,QString,QString,QString,QString)",
-                                          "(QString,QString,QString,QString,QString,QString,QString,QString)",
-                                          "(QString,QString,QString,QString,QString,QString,QString,QString,QString)",
-                                          "(QString,QString,QString,QString,QString,QString,QString,QString,QString,QString)" };
 
     object();
     if (Q_UNLIKELY(!ptr)) {
@@ -66,26 +69,28 @@ inline bool TDispatcher<T>::invoke(const QByteArray &method, const QStringList &
     }
 
     int argcnt = 0;
-    int idx = -1;
-    for (int i = qMin(args.count(), 10); i >= 0; --i) {
-        // Find method
-        QByteArray mtd = method + params[i];
-        //mtd = QMetaObject::normalizedSignature(mtd);
-        idx = ptr->metaObject()->indexOfSlot(mtd.constData());
-        if (idx >= 0) {
-            argcnt = i;
-            tSystemDebug("Found method: %s", mtd.constData());
-            break;
-        }
-    }
+    int idx = TDispatchTable::slotIndex(ptr->metaObject(), method, args.count(), &argcnt);
 
     bool res = false;
     if (Q_UNLIKELY(idx < 0)) {
         tSystemDebug("No such method: %s", qPrintable(method));
         return res;
+    }
+
+    tSystemDebug("Invoke method: %s", qPrintable(metaType + "#" + method));
+
+    if (connectionType == Qt::DirectConnection
+        || (connectionType == Qt::AutoConnection && ptr->thread() == QThread::currentThread())) {
+        // Calls the slot directly without checking the argument types
+        void *argv[TDispatchTable::MaxArguments + 1];
+        argv[0] = 0;  // return value not used
+        for (int i = 0; i < argcnt; ++i) {
+            argv[i + 1] = const_cast<QString *>(&args[i]);
+        }
+        QMetaObject::metacall(ptr, QMetaObject::InvokeMetaMethod, idx, argv);
+        res = true;
     } else {
         QMetaMethod mm = ptr->metaObject()->method(idx);
-        tSystemDebug("Invoke method: %s", qPrintable(metaType + "#" + method));
         switch (argcnt) {
         case 0:
             res = mm.invoke(ptr, connectionType);
@@ -152,7 +157,7 @@ inline T *TDispatcher<T>::object()
 
     if (!ptr) {
         if (typeId <= 0 && !metaType.isEmpty()) {
-            typeId = QMetaType::type(metaType.toLatin1().constData());
+            typeId = TDispatchTable::typeId(metaType);
             if (typeId > 0) {
 #if QT_VERSION >= 0x050200
                 ptr = static_cast<T *>(QMetaType::create(typeId));
@@ -169,4 +174,29 @@ inline T *TDispatcher<T>::object()
     return ptr;
 }
 
+/*!
+  Sets the \a object constructed already, e.g. a pooled controller.
+  The dispatcher takes ownership of it.
+ */
+template <class T>
+inline void TDispatcher<T>::setObject(T *object)
+{
+    if (ptr) {
+        QMetaType::destroy(typeId, ptr);
+    }
+    ptr = object;
+    typeId = (object) ? TDispatchTable::typeId(metaType) : 0;
+}
+
+/*!
+  Releases the ownership of the object and returns it.
+ */
+template <class T>
+inline T *TDispatcher<T>::takeObject()
+{
+    T *object = ptr;
+    ptr = 0;
+    return object;
+}
+
 #endif // TDISPATCHER_H
@@ -10,6 +10,7 @@
 #include <QBuffer>
 #include <sys/types.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <THttpRequestHeader>
 #include <TSession>
 #include "tepoll.h"
@@ -21,8 +22,34 @@
 #include "tfcore_unix.h"
 
 const int MaxEvents = 128;
+const int MaxSlots = 0x1000000;
+const int SendRequestQueueSize = 4096;
+const int MaxDispatchCount = 256;
+const int MaxReactors = 0x100;
 
-static TEpoll *staticInstance;
+// Socket ID: generation (32 bits) | reactor ID (8 bits) | slot index (24 bits)
+static inline quint64 makeSocketId(quint32 generation, int reactorId, int slot)
+{
+    return ((quint64)generation << 32) | ((quint64)(reactorId & 0xFF) << 24) | (quint64)(slot & 0xFFFFFF);
+}
+
+static inline int slotOf(quint64 socketId)
+{
+    return (int)(socketId & 0xFFFFFF);
+}
+
+static inline int reactorOf(quint64 socketId)
+{
+    return (int)((socketId >> 24) & 0xFF);
+}
+
+static inline quint32 generationOf(quint64 socketId)
+{
+    return (quint32)(socketId >> 32);
+}
+
+static QList<TEpoll *> reactors;
+static __thread TEpoll *threadInstance = 0;  // Reactor of the current thread
 
 
 class TSendData
@@ -32,38 +59,59 @@ public:
         Disconnect,
         Send,
         SwitchToWebSocket,
+        WorkerFinished,
     };
 
     int method;
-    QByteArray uuid;
+    quint64 socketId;
     TSendBuffer *buffer;
     THttpRequestHeader header;
 
-    TSendData(Method m, const QByteArray &u, TSendBuffer *buf = 0)
-        : method(m), uuid(u), buffer(buf), header()
+    TSendData(Method m, quint64 id, TSendBuffer *buf = 0)
+        : method(m), socketId(id), buffer(buf), header()
     { }
 
-    TSendData(Method m, const QByteArray &u, const THttpRequestHeader &h)
-        : method(m), uuid(u), buffer(0), header(h)
+    TSendData(Method m, quint64 id, const THttpRequestHeader &h)
+        : method(m), socketId(id), buffer(0), header(h)
     { }
 };
 
 
 
-TEpoll::TEpoll()
-    : epollFd(0), events(new struct epoll_event[MaxEvents]),
-      polling(false), numEvents(0), eventIterator(0), pollingSockets()
+TEpoll::TEpoll(int id)
+    : reactorId(id), epollFd(0), eventFd(0), wakeUpNotified(0), events(new struct epoll_event[MaxEvents]),
+      polling(false), numEvents(0), eventIterator(0), pollingSockets(), generations(), freeSlots(),
+      sendRequests(SendRequestQueueSize)
 {
     epollFd = epoll_create(1);
     if (epollFd < 0) {
         tSystemError("Failed epoll_create()");
+        return;
+    }
+
+    // Wakes up epoll_wait() when send data is set by other threads
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd < 0) {
+        tSystemError("Failed eventfd()  errno:%d", errno);
+        eventFd = 0;
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = 0;  // null pointer indicates the eventfd
+    if (tf_epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &ev) < 0) {
+        tSystemError("Failed epoll_ctl (EPOLL_CTL_ADD)  eventfd:%d errno:%d", eventFd, errno);
     }
 }
 
 
 TEpoll::~TEpoll()
 {
-    delete events;
+    delete[] events;
+
+    if (eventFd > 0)
+        TF_CLOSE(eventFd);
 
     if (epollFd > 0)
         TF_CLOSE(epollFd);
@@ -88,7 +136,37 @@ int TEpoll::wait(int timeout)
 
 TEpollSocket *TEpoll::next()
 {
-    return (eventIterator < numEvents) ? (TEpollSocket *)events[eventIterator++].data.ptr : 0;
+    while (eventIterator < numEvents) {
+        TEpollSocket *sock = (TEpollSocket *)events[eventIterator++].data.ptr;
+        if (Q_LIKELY(sock)) {
+            return sock;
+        }
+        clearWakeUp();  // event of the eventfd
+    }
+    return 0;
+}
+
+
+void TEpoll::wakeUp()
+{
+    // Writes to the eventfd only once until the event loop reads it
+    if (eventFd > 0 && wakeUpNotified.testAndSetOrdered(0, 1)) {
+        quint64 val = 1;
+        int ret;
+        EINTR_LOOP(ret, ::write(eventFd, &val, sizeof(val)));
+        if (Q_UNLIKELY(ret < 0 && errno != EAGAIN)) {
+            tSystemError("Failed write to eventfd  errno:%d", errno);
+        }
+    }
+}
+
+
+void TEpoll::clearWakeUp()
+{
+    quint64 val;
+    int ret;
+    EINTR_LOOP(ret, ::read(eventFd, &val, sizeof(val)));
+    wakeUpNotified.fetchAndStoreOrdered(0);
 }
 
 bool TEpoll::canReceive() const
@@ -121,12 +199,68 @@ int TEpoll::send(TEpollSocket *socket) const
 }
 
 
+/*!
+  Creates \a numReactors epoll instances, each of which is driven by
+  its own event loop thread. Call this before starting the threads.
+  At most 256 instances are created, since the reactor ID is packed
+  into 8 bits of the socket ID.
+ */
+void TEpoll::instantiate(int numReactors)
+{
+    if (Q_LIKELY(reactors.isEmpty())) {
+        if (Q_UNLIKELY(numReactors > MaxReactors)) {
+            tSystemWarn("Too many event loops: %d, reduced to %d", numReactors, MaxReactors);
+            numReactors = MaxReactors;
+        }
+        for (int i = 0; i < qMax(numReactors, 1); ++i) {
+            reactors << new TEpoll(i);
+        }
+    }
+}
+
+
+int TEpoll::instanceCount()
+{
+    return reactors.count();
+}
+
+/*!
+  Returns the epoll instance driven by the current thread, or the
+  first one if the current thread is not an event loop thread.
+ */
 TEpoll *TEpoll::instance()
 {
-    if (Q_UNLIKELY(!staticInstance)) {
-        staticInstance = new TEpoll();
+    if (Q_LIKELY(threadInstance)) {
+        return threadInstance;
+    }
+
+    if (Q_UNLIKELY(reactors.isEmpty())) {
+        instantiate(1);
+    }
+    return reactors[0];
+}
+
+/*!
+  Returns the epoll instance that polls the socket of \a socketId.
+ */
+TEpoll *TEpoll::instance(quint64 socketId)
+{
+    return instanceAt(reactorOf(socketId));
+}
+
+
+TEpoll *TEpoll::instanceAt(int id)
+{
+    if (Q_UNLIKELY(id < 0 || id >= reactors.count())) {
+        return instance();
     }
-    return staticInstance;
+    return reactors[id];
+}
+
+
+void TEpoll::attachCurrentThread()
+{
+    threadInstance = this;
 }
 
 
@@ -147,7 +281,10 @@ bool TEpoll::addPoll(TEpollSocket *socket, int events)
         }
     } else {
         tSystemDebug("OK epoll_ctl (EPOLL_CTL_ADD) (events:%u)  sd:%d", events, socket->socketDescriptor());
-        pollingSockets.insert(socket->socketUuid(), socket);
+        if (Q_UNLIKELY(!registerSocket(socket))) {
+            tf_epoll_ctl(epollFd, EPOLL_CTL_DEL, socket->socketDescriptor(), NULL);
+            return false;
+        }
     }
     return !ret;
 
@@ -177,7 +314,7 @@ bool TEpoll::modifyPoll(TEpollSocket *socket, int events)
 
 bool TEpoll::deletePoll(TEpollSocket *socket)
 {
-    if (pollingSockets.remove(socket->socketUuid()) == 0) {
+    if (!unregisterSocket(socket)) {
         return false;
     }
 
@@ -194,117 +331,220 @@ bool TEpoll::deletePoll(TEpollSocket *socket)
 }
 
 
-bool TEpoll::waitSendData(int msec)
+void TEpoll::dispatchSendData()
 {
-    return sendRequests.wait(msec);
+    TSendData *dataList[MaxDispatchCount];
+
+    for (;;) {
+        int cnt = sendRequests.dequeue(dataList, MaxDispatchCount);
+
+        for (int i = 0; i < cnt; ++i) {
+            TSendData *sd = dataList[i];
+            TEpollSocket *sock = findSocket(sd->socketId);
+
+            if (Q_LIKELY(sock && sock->socketDescriptor() > 0)) {
+                switch (sd->method) {
+                case TSendData::Send:
+                    sock->enqueueSendData(sd->buffer);
+                    modifyPoll(sock, (EPOLLIN | EPOLLOUT | EPOLLET));  // reset
+                    break;
+
+                case TSendData::Disconnect:
+                    deletePoll(sock);
+                    sock->close();
+                    sock->deleteLater();
+                    break;
+
+                case TSendData::SwitchToWebSocket: {
+                    tSystemDebug("Switch to WebSocket");
+                    Q_ASSERT(sd->buffer == NULL);
+
+                    QByteArray secKey = sd->header.rawHeader("Sec-WebSocket-Key");
+                    tSystemDebug("secKey: %s", secKey.data());
+                    TEpollWebSocket *ws = new TEpollWebSocket(sock->socketDescriptor(), sock->clientAddress(), sd->header);
+
+                    deletePoll(sock);
+                    sock->setSocketDescpriter(0);  // Delegates to new websocket
+                    sock->deleteLater();
+
+                    // Switch to WebSocket
+                    THttpResponseHeader response = ws->handshakeResponse();
+                    ws->enqueueSendData(TEpollSocket::createSendBuffer(response.toByteArray()));
+                    addPoll(ws, (EPOLLIN | EPOLLOUT | EPOLLET));  // reset
+
+                    // WebSocket opening
+                    TSession session;
+                    QByteArray sessionId = sd->header.cookie(TSession::sessionName());
+                    if (!sessionId.isEmpty()) {
+                        // Finds a session
+                        session = TSessionManager::instance().findSession(sessionId);
+                    }
+                    ws->startWorkerForOpening(session);
+                    break; }
+
+                case TSendData::WorkerFinished:
+                    sock->finishWorker();
+                    break;
+
+                default:
+                    tSystemError("Logic error [%s:%d]", __FILE__, __LINE__);
+                    if (sd->buffer) {
+                        delete sd->buffer;
+                    }
+                    break;
+                }
+            } else if (sd->buffer) {
+                delete sd->buffer;  // socket already closed
+            }
+
+            delete sd;
+        }
+
+        if (cnt < MaxDispatchCount) {
+            break;
+        }
+    }
 }
 
 
-void TEpoll::dispatchSendData()
+/*!
+  Assigns a free slot and a new socket ID to the \a socket.
+ */
+bool TEpoll::registerSocket(TEpollSocket *socket)
 {
-    QList<TSendData *> dataList = sendRequests.dequeue();
-
-    for (QListIterator<TSendData *> it(dataList); it.hasNext(); ) {
-        TSendData *sd = it.next();
-        TEpollSocket *sock = pollingSockets[sd->uuid];
-
-        if (Q_LIKELY(sock && sock->socketDescriptor() > 0)) {
-            switch (sd->method) {
-            case TSendData::Send:
-                sock->enqueueSendData(sd->buffer);
-                modifyPoll(sock, (EPOLLIN | EPOLLOUT | EPOLLET));  // reset
-                break;
-
-            case TSendData::Disconnect:
-                deletePoll(sock);
-                sock->close();
-                sock->deleteLater();
-                break;
-
-            case TSendData::SwitchToWebSocket: {
-                tSystemDebug("Switch to WebSocket");
-                Q_ASSERT(sd->buffer == NULL);
-
-                QByteArray secKey = sd->header.rawHeader("Sec-WebSocket-Key");
-                tSystemDebug("secKey: %s", secKey.data());
-                TEpollWebSocket *ws = new TEpollWebSocket(sock->socketDescriptor(), sock->clientAddress(), sd->header);
-
-                deletePoll(sock);
-                sock->setSocketDescpriter(0);  // Delegates to new websocket
-                sock->deleteLater();
-
-                // Switch to WebSocket
-                THttpResponseHeader response = ws->handshakeResponse();
-                ws->enqueueSendData(TEpollSocket::createSendBuffer(response.toByteArray()));
-                addPoll(ws, (EPOLLIN | EPOLLOUT | EPOLLET));  // reset
-
-                // WebSocket opening
-                TSession session;
-                QByteArray sessionId = sd->header.cookie(TSession::sessionName());
-                if (!sessionId.isEmpty()) {
-                    // Finds a session
-                    session = TSessionManager::instance().findSession(sessionId);
-                }
-                ws->startWorkerForOpening(session);
-                break; }
-
-            default:
-                tSystemError("Logic error [%s:%d]", __FILE__, __LINE__);
-                if (sd->buffer) {
-                    delete sd->buffer;
-                }
-                break;
-            }
+    int slot;
+    if (!freeSlots.isEmpty()) {
+        slot = freeSlots.last();
+        freeSlots.pop_back();
+    } else {
+        slot = pollingSockets.count();
+        if (Q_UNLIKELY(slot >= MaxSlots)) {
+            tSystemError("Too many sockets polled  [%s:%d]", __FILE__, __LINE__);
+            return false;
         }
+        pollingSockets.append(0);
+        generations.append(0);
+    }
+
+    // Generation tag to detect stale IDs of closed sockets
+    quint32 gen = ++generations[slot];
+    if (Q_UNLIKELY(gen == 0)) {
+        gen = generations[slot] = 1;
+    }
+
+    pollingSockets[slot] = socket;
+    socket->setSocketId(makeSocketId(gen, reactorId, slot));
+    return true;
+}
+
 
-        delete sd;
+bool TEpoll::unregisterSocket(TEpollSocket *socket)
+{
+    if (findSocket(socket->socketId()) != socket) {
+        return false;
     }
+
+    int slot = slotOf(socket->socketId());
+    pollingSockets[slot] = 0;
+    freeSlots.append(slot);
+    return true;
+}
+
+/*!
+  Returns the socket of \a socketId, or 0 if the ID is stale.
+ */
+TEpollSocket *TEpoll::findSocket(quint64 socketId) const
+{
+    int slot = slotOf(socketId);
+    if (Q_LIKELY(slot < pollingSockets.count() && generations[slot] == generationOf(socketId))) {
+        return pollingSockets[slot];
+    }
+    return 0;
 }
 
 
 void TEpoll::releaseAllPollingSockets()
 {
-    for (QMapIterator<QByteArray, TEpollSocket *> it(pollingSockets); it.hasNext(); ) {
-        it.next();
-        it.value()->deleteLater();
+    for (QVectorIterator<TEpollSocket *> it(pollingSockets); it.hasNext(); ) {
+        TEpollSocket *sock = it.next();
+        if (sock) {
+            sock->deleteLater();
+        }
     }
     pollingSockets.clear();
+    generations.clear();
+    freeSlots.clear();
 }
 
 
-void TEpoll::setSendData(const QByteArray &uuid, const QByteArray &header, QIODevice *body, bool autoRemove, const TAccessLogger &accessLogger)
+void TEpoll::setSendData(quint64 socketId, const QByteArray &header, QIODevice *body, bool autoRemove, const TAccessLogger &accessLogger)
 {
-    QByteArray response = header;
+    QByteArray data;
     QFileInfo fi;
+    TPartialFile *partial = qobject_cast<TPartialFile *>(body);
 
-    if (Q_LIKELY(body)) {
+    if (partial) {
+        fi.setFile(partial->fileName());  // only the parts are sent
+    } else if (Q_LIKELY(body)) {
         QBuffer *buffer = qobject_cast<QBuffer *>(body);
         if (buffer) {
-            response += buffer->data();
+            data = buffer->data();  // shallow copy, sent with the header by writev
         } else {
             fi.setFile(*qobject_cast<QFile *>(body));
         }
     }
 
-    TSendBuffer *sendbuf = TEpollSocket::createSendBuffer(response, fi, autoRemove, accessLogger);
-    sendRequests.enqueue(new TSendData(TSendData::Send, uuid, sendbuf));
+    TSendBuffer *sendbuf = TEpollSocket::createSendBuffer(header, data, fi, autoRemove, accessLogger);
+    if (partial) {
+        sendbuf->setFileParts(partial->parts(), partial->trailer());
+    }
+    sendRequests.enqueue(new TSendData(TSendData::Send, socketId, sendbuf));
+    wakeUp();
+}
+
+
+void TEpoll::setSendData(quint64 socketId, const QByteArray &data)
+{
+    TSendBuffer *sendbuf = TEpollSocket::createSendBuffer(data);
+    sendRequests.enqueue(new TSendData(TSendData::Send, socketId, sendbuf));
+    wakeUp();
 }
 
 
-void TEpoll::setSendData(const QByteArray &uuid, const QByteArray &data)
+/*!
+  Sets the \a data to be sent, adding its size to \a pendingBytes while
+  it waits in the queue. The caller can throttle itself with it.
+ */
+void TEpoll::setSendData(quint64 socketId, const QByteArray &data, const QSharedPointer<TPendingBytes> &pendingBytes)
 {
     TSendBuffer *sendbuf = TEpollSocket::createSendBuffer(data);
-    sendRequests.enqueue(new TSendData(TSendData::Send, uuid, sendbuf));
+    sendbuf->setPendingCounter(pendingBytes);
+    sendRequests.enqueue(new TSendData(TSendData::Send, socketId, sendbuf));
+    wakeUp();
+}
+
+
+void TEpoll::setDisconnect(quint64 socketId)
+{
+    sendRequests.enqueue(new TSendData(TSendData::Disconnect, socketId));
+    wakeUp();
 }
 
 
-void TEpoll::setDisconnect(const QByteArray &uuid)
+/*!
+  Notifies that the action worker has finished the request of the
+  socket of \a socketId. This follows all the data the worker has set
+  to be sent for the request.
+ */
+void TEpoll::setWorkerFinished(quint64 socketId)
 {
-    sendRequests.enqueue(new TSendData(TSendData::Disconnect, uuid));
+    sendRequests.enqueue(new TSendData(TSendData::WorkerFinished, socketId));
+    wakeUp();
 }
 
 
-void TEpoll::setSwitchToWebSocket(const QByteArray &uuid, const THttpRequestHeader &header)
+void TEpoll::setSwitchToWebSocket(quint64 socketId, const THttpRequestHeader &header)
 {
-    sendRequests.enqueue(new TSendData(TSendData::SwitchToWebSocket, uuid, header));
+    sendRequests.enqueue(new TSendData(TSendData::SwitchToWebSocket, socketId, header));
+    wakeUp();
 }
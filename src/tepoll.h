@@ -1,7 +1,9 @@
 #ifndef TEPOLL_H
 #define TEPOLL_H
 
-#include <QMap>
+#include <QVector>
+#include <QAtomicInt>
+#include <QSharedPointer>
 #include <TGlobal>
 #include <TAtomicQueue>
 
@@ -10,6 +12,7 @@ class QByteArray;
 class TEpollSocket;
 class TAccessLogger;
 class TSendData;
+class TPendingBytes;
 class THttpRequestHeader;
 struct epoll_event;
 
@@ -19,6 +22,7 @@ class T_CORE_EXPORT TEpoll
 public:
     ~TEpoll();
 
+    int id() const { return reactorId; }
     int wait(int timeout);
     bool isPolling() const { return polling; }
     TEpollSocket *next();
@@ -30,32 +34,48 @@ public:
     bool addPoll(TEpollSocket *socket, int events);
     bool modifyPoll(TEpollSocket *socket, int events);
     bool deletePoll(TEpollSocket *socket);
-    bool waitSendData(int msec);
     void dispatchSendData();
     void releaseAllPollingSockets();
 
     // For action workers
-    void setSendData(const QByteArray &uuid, const QByteArray &header, QIODevice *body, bool autoRemove, const TAccessLogger &accessLogger);
-    void setSendData(const QByteArray &uuid, const QByteArray &data);
-    void setDisconnect(const QByteArray &uuid);
-    void setSwitchToWebSocket(const QByteArray &uuid, const THttpRequestHeader &header);
+    void setSendData(quint64 socketId, const QByteArray &header, QIODevice *body, bool autoRemove, const TAccessLogger &accessLogger);
+    void setSendData(quint64 socketId, const QByteArray &data);
+    void setSendData(quint64 socketId, const QByteArray &data, const QSharedPointer<TPendingBytes> &pendingBytes);
+    void setDisconnect(quint64 socketId);
+    void setWorkerFinished(quint64 socketId);
+    void setSwitchToWebSocket(quint64 socketId, const THttpRequestHeader &header);
 
+    static void instantiate(int numReactors);
+    static int instanceCount();
     static TEpoll *instance();
+    static TEpoll *instance(quint64 socketId);
+    static TEpoll *instanceAt(int id);
+    void attachCurrentThread();
 
 protected:
     bool modifyPoll(int fd, int events);
+    bool registerSocket(TEpollSocket *socket);
+    bool unregisterSocket(TEpollSocket *socket);
+    TEpollSocket *findSocket(quint64 socketId) const;
+    void wakeUp();
+    void clearWakeUp();
 
 private:
+    int reactorId;
     int epollFd;
+    int eventFd;
+    QAtomicInt wakeUpNotified;
     int listenSocket;
     struct epoll_event *events;
     volatile bool polling;
     int numEvents;
     int eventIterator;
-    QMap<QByteArray, TEpollSocket*> pollingSockets;
-    TAtomicQueue<TSendData *> sendRequests;
+    QVector<TEpollSocket *> pollingSockets;  // indexed by slot of socket ID
+    QVector<quint32> generations;
+    QVector<int> freeSlots;
+    TAtomicRingBuffer<TSendData *> sendRequests;
 
-    TEpoll();
+    TEpoll(int id);
     Q_DISABLE_COPY(TEpoll);
 };
 
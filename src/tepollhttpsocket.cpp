@@ -5,21 +5,62 @@
  * the New BSD License, which is incorporated herein by reference.
  */
 
+#include <QFileInfo>
 #include <TWebApplication>
 #include <TSystemGlobal>
 #include <TAppSettings>
 #include <THttpRequestHeader>
+#include <THttpResponseHeader>
+#include <THttpUtility>
+#include <TActionController>
+#include <TDispatcher>
+#include <TAccessLog>
+#include <sys/epoll.h>
 #include "tepollhttpsocket.h"
-#include "tactionworker.h"
+#include "tactionworkerpool.h"
 #include "tepoll.h"
 #include "tepollwebsocket.h"
+#include "tsendbuffer.h"
+#include "tstaticassetcache.h"
+#include "turlroute.h"
 
 const int BUFFER_RESERVE_SIZE = 1023;
-static int limitBodyBytes = -1;
+const int MAX_CHUNK_LINE_LENGTH = 1024;
+const int MAX_CHUNK_TRAILER_LENGTH = 8192;
+
+int TEpollHttpSocket::limitBodyBytes = 0;
+bool TEpollHttpSocket::directViewRenderMode = false;
+bool TEpollHttpSocket::httpMethodOverride = false;
+bool TEpollHttpSocket::listeningOnTcp = false;
+
+/*
+  Returns the index of the empty line "\r\n\r\n" searching from
+  \a from, or -1. The search for LF is done by memchr() which is
+  vectorized in libc.
+*/
+static int indexOfHeaderEnd(const char *data, int length, int from)
+{
+    const char *end = data + length;
+    const char *p = data + qMax(from, 3);
+
+    while (p < end) {
+        p = (const char *)memchr(p, '\n', end - p);
+        if (!p) {
+            break;
+        }
+        if (*(p - 1) == '\r' && *(p - 2) == '\n' && *(p - 3) == '\r') {
+            return p - 3 - data;
+        }
+        ++p;
+    }
+    return -1;
+}
 
 
 TEpollHttpSocket::TEpollHttpSocket(int socketDescriptor, const QHostAddress &address)
-    : TEpollSocket(socketDescriptor, address), lengthToRead(-1)
+    : TEpollSocket(socketDescriptor, address), lengthToRead(-1), scanPos(0), headerLength(0),
+      requestHeader(), workerJobs(0), chunkState(ChunkSize), chunkReadPos(0), chunkWritePos(0), chunkRemaining(0),
+      chunkRawBytes(0), chunkTrailerLength(0)
 {
     httpBuffer.reserve(BUFFER_RESERVE_SIZE);
 }
@@ -66,6 +107,10 @@ bool TEpollHttpSocket::seekRecvBuffer(int pos)
 
     if (lengthToRead < 0) {
         parse();
+    } else if (chunkReadPos > 0) {
+        if (decodeChunks()) {
+            lengthToRead = 0;
+        }
     } else {
         if (limitBodyBytes > 0 && httpBuffer.length() > limitBodyBytes) {
             throw ClientErrorException(413);  // Request Entity Too Large
@@ -80,44 +125,168 @@ bool TEpollHttpSocket::seekRecvBuffer(int pos)
 void TEpollHttpSocket::startWorker()
 {
     tSystemDebug("TEpollHttpSocket::startWorker");
-    TActionWorker *worker = new TActionWorker(this);
-    worker->moveToThread(Tf::app()->thread());
-    connect(worker, SIGNAL(finished()), worker, SLOT(deleteLater()));
-    worker->start();
+
+    // Keeps the responses in order of the requests
+    if (workerJobs == 0 && !hasSendData() && sendStaticAsset()) {
+        return;  // served in this reactor thread
+    }
+    ++workerJobs;
+    TActionWorkerPool::instance()->enqueue(this);
 }
 
 
-void TEpollHttpSocket::parse()
+void TEpollHttpSocket::finishWorker()
+{
+    if (workerJobs > 0) {
+        --workerJobs;
+    }
+}
+
+/*!
+  Reads the settings used by the reactor threads to decide whether a
+  request can be served there. Call this before starting the threads.
+ */
+void TEpollHttpSocket::loadSettings()
 {
-    if (Q_UNLIKELY(limitBodyBytes < 0)) {
-        limitBodyBytes = Tf::appSettings()->value(Tf::LimitRequestBody, "0").toInt();
+    limitBodyBytes = Tf::appSettings()->value(Tf::LimitRequestBody, "0").toInt();
+    directViewRenderMode = Tf::appSettings()->value(Tf::DirectViewRenderMode).toBool();
+    httpMethodOverride = Tf::appSettings()->value(Tf::EnableHttpMethodOverride).toBool();
+    listeningOnTcp = (Tf::appSettings()->value(Tf::ListenPort).toUInt() > 0);
+}
+
+/*
+  Returns true if the request is for a controller, deciding the same
+  way as TActionContext::execute().
+*/
+static bool isControllerRequest(const QByteArray &rawPath, bool directView)
+{
+    if (directView || !TUrlRoute::instance().findRouting(Tf::Get, rawPath).isEmpty()) {
+        return true;
     }
 
+    QStringList components = TUrlRoute::splitPath(THttpUtility::fromUrlEncoding(rawPath));
+    QString c = components.value(0).toLower();
+    return !c.isEmpty() && !TActionController::disabledControllers().contains(c)
+        && TDispatchTable::typeId(c + QLatin1String("controller")) > 0;
+}
+
+/*!
+  Sends a file in the public directory from the static asset cache for
+  a GET request which no controller handles, without waking any action
+  worker. Only the assets already cached and revalidated within two
+  seconds are served here; the file system is accessed by the workers,
+  which fill the cache, and by the thread revalidating it.
+  Returns true if sent; otherwise returns false.
+ */
+bool TEpollHttpSocket::sendStaticAsset()
+{
+    // Simple GET request only; byte ranges are handled by the worker
+    if (httpMethodOverride || requestHeader.method() != "GET" || httpBuffer.length() != headerLength
+        || requestHeader.hasRawHeader("Range")) {
+        return false;
+    }
+
+    const QByteArray &fullPath = requestHeader.path();
+    QByteArray rawPath = fullPath.mid(0, fullPath.indexOf('?'));
+    if (isControllerRequest(rawPath, directViewRenderMode)) {
+        return false;
+    }
+
+    QString path = THttpUtility::fromUrlEncoding(rawPath);
+    path.remove(0, 1);
+    TStaticAssetCache::AssetPointer asset = TStaticAssetCache::instance()->findCached(path);
+    if (!asset) {
+        return false;  // loaded, or 404 page, by the worker
+    }
+
+    const TStaticAsset::Content &content = asset->content(requestHeader.rawHeader("Accept-Encoding"));
+    bool modified = asset->isModified(requestHeader, content);
+    int statusCode = (modified) ? Tf::OK : Tf::NotModified;
+
+    THttpResponseHeader header;
+    header.setStatusLine(statusCode, THttpUtility::getResponseReasonPhrase(statusCode));
+    asset->setResponseHeader(header, content, modified);
+    if (modified) {
+        header.setContentType(asset->contentType);
+        header.setContentLength(content.size);
+        if (content.encoding.isEmpty()) {
+            header.setRawHeader("Accept-Ranges", "bytes");
+        }
+    }
+    header.setRawHeader("Server", "TreeFrog server");
+    header.setRawHeader("Connection", "Keep-Alive");
+    header.setCurrentDate();
+
+    // Access log
+    TAccessLogger logger;
+    logger.open();
+    logger.setTimestamp(QDateTime::currentDateTime());
+    QByteArray firstLine = requestHeader.method() + ' ' + fullPath;
+    firstLine += QString(" HTTP/%1.%2").arg(requestHeader.majorVersion()).arg(requestHeader.minorVersion()).toLatin1();
+    logger.setRequest(firstLine);
+    logger.setRemoteHost( (listeningOnTcp) ? clientAddress().toString().toLatin1() : QByteArray("(unix)") );
+    logger.setStatusCode(statusCode);
+
+    QByteArray body;
+    QFileInfo file;
+    if (modified) {
+        if (!content.data.isNull()) {
+            body = content.data;
+        } else {
+            file.setFile(content.filePath);
+        }
+    }
+
+    clear();  // request consumed
+    enqueueSendData(TEpollSocket::createSendBuffer(header.toByteArray(), body, file, false, logger));
+    TEpoll::instance(socketId())->modifyPoll(this, (EPOLLIN | EPOLLOUT | EPOLLET));  // reset
+    return true;
+}
+
+
+void TEpollHttpSocket::parse()
+{
     if (Q_LIKELY(lengthToRead < 0)) {
-        int idx = httpBuffer.indexOf("\r\n\r\n");
+        // Resumes the search where the last one stopped so that headers
+        // arriving in many small segments are scanned only once
+        int idx = indexOfHeaderEnd(httpBuffer.constData(), httpBuffer.length(), scanPos);
+        scanPos = httpBuffer.length();
+
         if (idx > 0) {
-            THttpRequestHeader header(httpBuffer);
-            tSystemDebug("content-length: %d", header.contentLength());
+            headerLength = idx + 4;
+            requestHeader = THttpRequestHeader(httpBuffer.constData(), headerLength);
+            tSystemDebug("content-length: %d", requestHeader.contentLength());
 
-            if (limitBodyBytes > 0 && header.contentLength() > (uint)limitBodyBytes) {
+            if (limitBodyBytes > 0 && requestHeader.contentLength() > (uint)limitBodyBytes) {
                 throw ClientErrorException(413);  // Request Entity Too Large
             }
 
-            lengthToRead = qMax(idx + 4 + (qint64)header.contentLength() - httpBuffer.length(), 0LL);
+            if (requestHeader.rawHeader("Transfer-Encoding").toLower().contains("chunked")) {
+                // Decodes the body in place as it arrives
+                chunkState = ChunkSize;
+                chunkReadPos = headerLength;
+                chunkWritePos = headerLength;
+                chunkRemaining = 0;
+                chunkRawBytes = 0;
+                chunkTrailerLength = 0;
+                lengthToRead = decodeChunks() ? 0 : 1;  // unknown until the last chunk
+            } else {
+                lengthToRead = qMax(headerLength + (qint64)requestHeader.contentLength() - httpBuffer.length(), 0LL);
+            }
             tSystemDebug("lengthToRead: %d", (int)lengthToRead);
 
             // Check connection header
-            QByteArray connectionHeader = header.rawHeader("Connection").toLower();
+            QByteArray connectionHeader = requestHeader.rawHeader("Connection").toLower();
             if (connectionHeader.contains("upgrade")) {
-                QByteArray upgradeHeader = header.rawHeader("Upgrade").toLower();
+                QByteArray upgradeHeader = requestHeader.rawHeader("Upgrade").toLower();
                 tSystemDebug("Upgrade: %s", upgradeHeader.data());
                 if (upgradeHeader == "websocket") {
-                    if (TEpollWebSocket::validateHandshakeRequest(header)) {
+                    if (TEpollWebSocket::validateHandshakeRequest(requestHeader)) {
                         // Switch protocols
-                        TEpoll::instance()->setSwitchToWebSocket(socketUuid(), header);
+                        TEpoll::instance()->setSwitchToWebSocket(socketId(), requestHeader);
                     } else {
                         // WebSocket closing
-                        TEpoll::instance()->setDisconnect(socketUuid());
+                        TEpoll::instance()->setDisconnect(socketId());
                     }
                 }
                 clear();  // buffer clear
@@ -129,9 +298,126 @@ void TEpollHttpSocket::parse()
 }
 
 
+/*!
+  Decodes the chunked body received so far, compacting it in place
+  right after the header so that the buffer holds no more than the
+  decoded body and an incomplete line. Returns true when the last chunk
+  and trailer have been received; then the request looks as if it had
+  been sent with Content-Length, followed by any pipelined data.
+  LimitRequestBody applies to the bytes received for the body including
+  the chunk-size lines and trailer.
+ */
+bool TEpollHttpSocket::decodeChunks()
+{
+    char *buf = httpBuffer.data();
+    int len = httpBuffer.length();
+    int startPos = chunkReadPos;
+    bool end = false;
+
+    while (chunkReadPos < len && !end) {
+        char *p = buf + chunkReadPos;
+
+        if (chunkState == ChunkData) {
+            int n = (int)qMin(chunkRemaining, (qint64)(len - chunkReadPos));
+            if (chunkWritePos != chunkReadPos) {
+                memmove(buf + chunkWritePos, p, n);
+            }
+            chunkWritePos += n;
+            chunkReadPos += n;
+            chunkRemaining -= n;
+            if (chunkRemaining == 0) {
+                chunkState = ChunkDataEnd;
+            }
+            continue;
+        }
+
+        // Line-oriented states
+        const char *lf = (const char *)memchr(p, '\n', len - chunkReadPos);
+        if (!lf) {
+            if (len - chunkReadPos > MAX_CHUNK_LINE_LENGTH) {
+                throw ClientErrorException(400);  // Bad Request
+            }
+            break;
+        }
+        int lineLength = lf - p;
+        chunkReadPos += lineLength + 1;
+
+        switch (chunkState) {
+        case ChunkSize: {
+            QByteArray line = QByteArray::fromRawData(p, lineLength);
+            int ext = line.indexOf(';');
+            bool ok;
+            qint64 size = line.left((ext < 0) ? lineLength : ext).trimmed().toLongLong(&ok, 16);
+            if (!ok || size < 0) {
+                throw ClientErrorException(400);  // Bad Request
+            }
+
+            if (limitBodyBytes > 0 && chunkWritePos - headerLength + size > limitBodyBytes) {
+                throw ClientErrorException(413);  // Request Entity Too Large
+            }
+            chunkRemaining = size;
+            chunkState = (size > 0) ? ChunkData : ChunkTrailer;
+            break; }
+
+        case ChunkDataEnd:
+            if (lineLength > 1 || (lineLength == 1 && *p != '\r')) {
+                throw ClientErrorException(400);  // Bad Request
+            }
+            chunkState = ChunkSize;
+            break;
+
+        case ChunkTrailer:
+            if (lineLength == 0 || (lineLength == 1 && *p == '\r')) {
+                end = true;  // end of the body
+                break;
+            }
+
+            // Trailer fields are discarded
+            chunkTrailerLength += lineLength + 1;
+            if (chunkTrailerLength > MAX_CHUNK_TRAILER_LENGTH) {
+                throw ClientErrorException(400);  // Bad Request
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    chunkRawBytes += chunkReadPos - startPos;
+    if (limitBodyBytes > 0 && chunkRawBytes > limitBodyBytes) {
+        throw ClientErrorException(413);  // Request Entity Too Large
+    }
+
+    // Moves the rest not decoded yet, or the pipelined data, next to the body
+    if (chunkReadPos > chunkWritePos) {
+        int rest = len - chunkReadPos;
+        memmove(buf + chunkWritePos, buf + chunkReadPos, rest);
+        httpBuffer.resize(chunkWritePos + rest);
+        chunkReadPos = chunkWritePos;
+    }
+
+    if (end) {
+        requestHeader.removeAllRawHeaders("Transfer-Encoding");
+        requestHeader.setContentLength(chunkWritePos - headerLength);
+        chunkReadPos = 0;
+    }
+    return end;
+}
+
+
 void TEpollHttpSocket::clear()
 {
     lengthToRead = -1;
+    scanPos = 0;
+    headerLength = 0;
+    requestHeader = THttpRequestHeader();
+    chunkState = ChunkSize;
+    chunkReadPos = 0;
+    chunkWritePos = 0;
+    chunkRemaining = 0;
+    chunkRawBytes = 0;
+    chunkTrailerLength = 0;
     httpBuffer.truncate(0);
     httpBuffer.reserve(BUFFER_RESERVE_SIZE);
 }
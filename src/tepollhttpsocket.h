@@ -2,10 +2,11 @@
 #define TEPOLLHTTPSOCKET_H
 
 #include <TGlobal>
+#include <THttpRequestHeader>
 #include "tepollsocket.h"
 
 class QHostAddress;
-class TActionWorker;
+class TActionWorkerPool;
 
 
 class T_CORE_EXPORT TEpollHttpSocket : public TEpollSocket
@@ -17,21 +18,49 @@ public:
     virtual bool canReadRequest();
     QByteArray readRequest();
     virtual void startWorker();
+    virtual void finishWorker();
+
+    static void loadSettings();
 
 protected:
     virtual void *getRecvBuffer(int size);
     virtual bool seekRecvBuffer(int pos);
     void parse();
+    bool decodeChunks();
+    bool sendStaticAsset();
     void clear();
 
 private:
     QByteArray httpBuffer;
     qint64 lengthToRead;
+    int scanPos;       // offset to resume searching the end of header
+    int headerLength;  // length of the parsed header, or 0
+    THttpRequestHeader requestHeader;
+    int workerJobs;    // requests handed to the action workers and not finished
+
+    // Decoder of chunked request body
+    enum ChunkState {
+        ChunkSize,
+        ChunkData,
+        ChunkDataEnd,
+        ChunkTrailer,
+    };
+    int chunkState;
+    int chunkReadPos;   // offset of data not decoded yet, or 0 if not chunked
+    int chunkWritePos;  // end of the decoded body
+    qint64 chunkRemaining;
+    qint64 chunkRawBytes;     // bytes of the chunked body consumed, including framing
+    int chunkTrailerLength;
+
+    static int limitBodyBytes;
+    static bool directViewRenderMode;
+    static bool httpMethodOverride;
+    static bool listeningOnTcp;  // otherwise on a UNIX domain socket
 
     TEpollHttpSocket(int socketDescriptor, const QHostAddress &address);
 
     friend class TEpollSocket;
-    friend class TActionWorker;
+    friend class TActionWorkerPool;
     Q_DISABLE_COPY(TEpollHttpSocket)
 };
 
@@ -7,11 +7,13 @@
 
 #include <sys/types.h>
 #include <sys/epoll.h>
-#include <QUuid>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <QFileInfo>
 #include <TWebApplication>
 #include <TSystemGlobal>
 #include <THttpHeader>
+#include <TfException>
 #include "tepollsocket.h"
 #include "tepollhttpsocket.h"
 #include "tepoll.h"
@@ -20,6 +22,8 @@
 
 class SendData;
 
+const int MaxSendFileBytes = 0x7ffff000;  // Linux's limit of one transfer
+const int MaxSegments = 8;
 static int sendBufSize = 0;
 static int recvBufSize = 0;
 
@@ -57,9 +61,9 @@ TEpollSocket *TEpollSocket::create(int socketDescriptor, const QHostAddress &add
 }
 
 
-TSendBuffer *TEpollSocket::createSendBuffer(const QByteArray &header, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger)
+TSendBuffer *TEpollSocket::createSendBuffer(const QByteArray &header, const QByteArray &body, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger)
 {
-    return new TSendBuffer(header, file, autoRemove, logger);
+    return new TSendBuffer(header, body, file, autoRemove, logger);
 }
 
 
@@ -93,10 +97,9 @@ void TEpollSocket::initBuffer(int socketDescriptor)
 
 
 TEpollSocket::TEpollSocket(int socketDescriptor, const QHostAddress &address)
-    : sd(socketDescriptor), uuid(), clientAddr(address)
+    : sd(socketDescriptor), sid(0), clientAddr(address)
 {
-    uuid = QUuid::createUuid().toByteArray();  // not thread safe
-    tSystemDebug("TEpollSocket  id:%s", uuid.data());
+    tSystemDebug("TEpollSocket  sd:%d", sd);
 }
 
 
@@ -130,7 +133,12 @@ int TEpollSocket::recv()
         }
 
         // Read successfully
-        seekRecvBuffer(len);
+        try {
+            seekRecvBuffer(len);
+        } catch (ClientErrorException &e) {
+            tSystemWarn("Bad request received  status:%d  sd:%d", e.statusCode(), sd);
+            return -1;  // disconnects
+        }
     }
 
     int ret = 0;
@@ -168,22 +176,75 @@ int TEpollSocket::send()
     TAccessLogger &logger = buf->accessLogger();
 
     for (;;) {
-        len = sendBufSize;
-        void *data = buf->getData(len);
-        if (len == 0) {
-            break;
+        const char *data[MaxSegments];
+        int sizes[MaxSegments];
+        int cnt = buf->getSegments(data, sizes, MaxSegments);
+        if (cnt == 0) {
+            // Reads the file body into the buffer unless zero-copy
+            len = sendBufSize;
+            data[0] = buf->getData(len);
+            sizes[0] = len;
+            cnt = (len > 0) ? 1 : 0;
         }
 
-        errno = 0;
-        len = ::send(sd, data, len, MSG_NOSIGNAL);
-        err = errno;
-
-        if (len <= 0) {
+        if (cnt > 0) {
+            struct iovec iov[MaxSegments];
+            for (int i = 0; i < cnt; ++i) {
+                iov[i].iov_base = const_cast<char *>(data[i]);
+                iov[i].iov_len = sizes[i];
+            }
+
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = cnt;
+
+            // Holds the header back until the file body follows
+            int flags = (buf->fileBytesToSend() > 0) ? (MSG_NOSIGNAL | MSG_MORE) : MSG_NOSIGNAL;
+            errno = 0;
+            len = ::sendmsg(sd, &msg, flags);
+            err = errno;
+
+            if (len <= 0) {
+                break;
+            }
+
+            // Sent successfully
+            buf->seekData(len);
+
+        } else if (buf->fileBytesToSend() > 0) {
+            // Zero-copy transfer of the file body
+            off_t offset = buf->filePosition();
+            size_t count = (size_t)qMin(buf->fileBytesToSend(), (qint64)MaxSendFileBytes);
+            errno = 0;
+            len = ::sendfile(sd, buf->fileDescriptor(), &offset, count);
+            err = errno;
+
+            if (len < 0 && (err == EINVAL || err == ENOSYS)) {
+                // Falls back to the buffered path
+                tSystemDebug("sendfile unavailable : errno:%d", err);
+                buf->disableZeroCopy();
+                err = 0;
+                continue;
+            }
+
+            if (Q_UNLIKELY(len == 0)) {
+                tSystemWarn("File truncated while sending  sd:%d", sd);
+                err = EIO;
+                break;
+            }
+
+            if (len < 0) {
+                break;
+            }
+
+            // Sent successfully
+            buf->seekFile(len);
+
+        } else {
             break;
         }
 
-        // Sent successfully
-        buf->seekData(len);
         logger.setResponseBytes(logger.responseBytes() + len);
     }
 
@@ -24,33 +24,37 @@ public:
     void close();
     int socketDescriptor() const { return sd; }
     const QHostAddress &clientAddress() const { return clientAddr; }
-    const QByteArray &socketUuid() const { return uuid; }
+    quint64 socketId() const { return sid; }
 
     virtual bool canReadRequest() { return false; }
     virtual void startWorker() { }
+    virtual void finishWorker() { }
 
     static TEpollSocket *accept(int listeningSocket);
     static TEpollSocket *create(int socketDescriptor, const QHostAddress &address);
-    static TSendBuffer *createSendBuffer(const QByteArray &header, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger);
+    static TSendBuffer *createSendBuffer(const QByteArray &header, const QByteArray &body, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger);
     static TSendBuffer *createSendBuffer(const QByteArray &data);
 
 protected:
     int send();
     int recv();
     void enqueueSendData(TSendBuffer *buffer);
+    bool hasSendData() const { return !sendBuf.isEmpty(); }
     void setSocketDescpriter(int socketDescriptor);
+    void setSocketId(quint64 id) { sid = id; }
     virtual void *getRecvBuffer(int size) = 0;
     virtual bool seekRecvBuffer(int pos) = 0;
 
 private:
     int sd;
-    QByteArray uuid;
+    quint64 sid;
     QHostAddress clientAddr;
     QQueue<TSendBuffer*> sendBuf;
 
     static void initBuffer(int socketDescriptor);
 
     friend class TEpoll;
+    friend class TMultiplexingServer;
     Q_DISABLE_COPY(TEpollSocket)
 };
 
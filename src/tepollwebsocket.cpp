@@ -128,7 +128,7 @@ void TEpollWebSocket::startWorker()
     do {
         TWebSocketFrame::OpCode opcode = frames.first().opCode();
         QByteArray binary = readBinaryRequest();
-        TWebSocketWorker *worker = new TWebSocketWorker(socketUuid(), reqHeader.path(), opcode, binary);
+        TWebSocketWorker *worker = new TWebSocketWorker(socketId(), reqHeader.path(), opcode, binary);
         worker->moveToThread(Tf::app()->thread());
         connect(worker, SIGNAL(finished()), worker, SLOT(deleteLater()));
         worker->start();
@@ -138,7 +138,7 @@ void TEpollWebSocket::startWorker()
 
 void TEpollWebSocket::startWorkerForOpening(const TSession &session)
 {
-    TWebSocketWorker *worker = new TWebSocketWorker(socketUuid(), session);
+    TWebSocketWorker *worker = new TWebSocketWorker(socketId(), session);
     worker->moveToThread(Tf::app()->thread());
     connect(worker, SIGNAL(finished()), worker, SLOT(deleteLater()));
     worker->start();
@@ -370,41 +370,41 @@ THttpResponseHeader TEpollWebSocket::handshakeResponse() const
 }
 
 
-void TEpollWebSocket::sendText(const QByteArray &socketUuid, const QString &message)
+void TEpollWebSocket::sendText(quint64 socketId, const QString &message)
 {
     TWebSocketFrame frame;
     frame.setOpCode(TWebSocketFrame::TextFrame);
     frame.setPayload(message.toUtf8());
-    TEpoll::instance()->setSendData(socketUuid, frame.toByteArray());
+    TEpoll::instance(socketId)->setSendData(socketId, frame.toByteArray());
 }
 
 
-void TEpollWebSocket::sendBinary(const QByteArray &socketUuid, const QByteArray &data)
+void TEpollWebSocket::sendBinary(quint64 socketId, const QByteArray &data)
 {
     TWebSocketFrame frame;
     frame.setOpCode(TWebSocketFrame::BinaryFrame);
     frame.setPayload(data);
-    TEpoll::instance()->setSendData(socketUuid, frame.toByteArray());
+    TEpoll::instance(socketId)->setSendData(socketId, frame.toByteArray());
 }
 
 
-void TEpollWebSocket::sendPing(const QByteArray &socketUuid)
+void TEpollWebSocket::sendPing(quint64 socketId)
 {
     TWebSocketFrame frame;
     frame.setOpCode(TWebSocketFrame::Ping);
-    TEpoll::instance()->setSendData(socketUuid, frame.toByteArray());
+    TEpoll::instance(socketId)->setSendData(socketId, frame.toByteArray());
 }
 
 
-void TEpollWebSocket::sendPong(const QByteArray &socketUuid)
+void TEpollWebSocket::sendPong(quint64 socketId)
 {
     TWebSocketFrame frame;
     frame.setOpCode(TWebSocketFrame::Pong);
-    TEpoll::instance()->setSendData(socketUuid, frame.toByteArray());
+    TEpoll::instance(socketId)->setSendData(socketId, frame.toByteArray());
 }
 
 
-void TEpollWebSocket::disconnect(const QByteArray &socketUuid)
+void TEpollWebSocket::disconnect(quint64 socketId)
 {
-    TEpoll::instance()->setDisconnect(socketUuid);
+    TEpoll::instance(socketId)->setDisconnect(socketId);
 }
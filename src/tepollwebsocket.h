@@ -26,11 +26,11 @@ public:
     void startWorkerForOpening(const TSession &session);
 
     static bool validateHandshakeRequest(const THttpRequestHeader &header);
-    static void sendText(const QByteArray &socketUuid, const QString &message);
-    static void sendBinary(const QByteArray &socketUuid, const QByteArray &data);
-    static void sendPing(const QByteArray &socketUuid);
-    static void sendPong(const QByteArray &socketUuid);
-    static void disconnect(const QByteArray &socketUuid);
+    static void sendText(quint64 socketId, const QString &message);
+    static void sendBinary(quint64 socketId, const QByteArray &data);
+    static void sendPing(quint64 socketId);
+    static void sendPong(quint64 socketId);
+    static void disconnect(quint64 socketId);
 
 protected:
     virtual void *getRecvBuffer(int size);
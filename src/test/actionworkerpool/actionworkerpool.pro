@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = actionworkerpool
+SOURCES = main.cpp
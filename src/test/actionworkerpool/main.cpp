@@ -0,0 +1,202 @@
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTime>
+#include <TWebApplication>
+#include <TActionController>
+#include "tactionworkerpool.h"
+#include "tepoll.h"
+
+const int JobMsecs = 20;
+
+
+/*
+ * Counts the jobs executed, and the ones executing at the same time
+ */
+class JobController : public TActionController
+{
+    Q_OBJECT
+public:
+    JobController() : TActionController() { }
+    JobController(const JobController &) : TActionController() { }
+    bool sessionEnabled() const { return false; }
+
+    static QMutex mutex;
+    static int running;
+    static int maxRunning;
+    static int done;
+
+    static void clearCount()
+    {
+        QMutexLocker locker(&mutex);
+        running = maxRunning = done = 0;
+    }
+
+public slots:
+    void index()
+    {
+        {
+            QMutexLocker locker(&mutex);
+            maxRunning = qMax(++running, maxRunning);
+        }
+        Tf::msleep(JobMsecs);
+        {
+            QMutexLocker locker(&mutex);
+            --running;
+            ++done;
+        }
+        renderText("done");
+    }
+};
+
+QMutex JobController::mutex;
+int JobController::running = 0;
+int JobController::maxRunning = 0;
+int JobController::done = 0;
+
+T_DECLARE_CONTROLLER(JobController, jobcontroller)
+T_REGISTER_CONTROLLER(jobcontroller)
+
+
+class TestActionWorkerPool : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void init();
+    void executeAll();
+    void stop();
+    void restart();
+};
+
+
+// The sockets are not registered, so the responses are discarded
+static void enqueueJobs(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        TActionWorkerPool::instance()->enqueue(new TActionJob(THttpRequestHeader(), 0, "GET /job/index HTTP/1.1\r\nHost: localhost\r\n\r\n",
+                                                              QHostAddress::LocalHost, (quint64)i));
+    }
+}
+
+
+// Waits for the jobs, discarding the send data set by the workers
+static bool waitForJobs(int msecs)
+{
+    QTime time;
+    time.start();
+    while (TActionWorkerPool::jobCount() > 0 && time.elapsed() < msecs) {
+        TEpoll::instance()->dispatchSendData();
+        Tf::msleep(10);
+    }
+    TEpoll::instance()->dispatchSendData();
+    return TActionWorkerPool::jobCount() == 0;
+}
+
+
+static int doneCount()
+{
+    QMutexLocker locker(&JobController::mutex);
+    return JobController::done;
+}
+
+
+void TestActionWorkerPool::initTestCase()
+{
+    TEpoll::instantiate(1);
+}
+
+
+void TestActionWorkerPool::init()
+{
+    JobController::clearCount();
+}
+
+
+void TestActionWorkerPool::executeAll()
+{
+    TActionWorkerPool *pool = TActionWorkerPool::instance();
+    pool->start(4);
+    QVERIFY(pool->isRunning());
+    QCOMPARE(pool->poolSize(), 4);
+
+    enqueueJobs(100);
+    QVERIFY(waitForJobs(10000));
+    QCOMPARE(doneCount(), 100);
+
+    // Executed by all the workers, and never by more
+    QCOMPARE(JobController::maxRunning, 4);
+
+    // Does not start again while running
+    pool->start(8);
+    QCOMPARE(pool->poolSize(), 4);
+}
+
+
+void TestActionWorkerPool::stop()
+{
+    TActionWorkerPool *pool = TActionWorkerPool::instance();
+    QVERIFY(pool->isRunning());
+
+    // Stops without waiting for the timeout
+    enqueueJobs(100);
+    QTime time;
+    time.start();
+    pool->stop(10000);
+    QVERIFY(time.elapsed() < 10000);
+    QVERIFY(!pool->isRunning());
+    QCOMPARE(pool->poolSize(), 0);
+
+    // No jobs left, executed or discarded
+    QCOMPARE(TActionWorkerPool::jobCount(), 0);
+    QCOMPARE(JobController::running, 0);
+    QVERIFY(doneCount() <= 100);
+    TEpoll::instance()->dispatchSendData();
+
+    // Discarded when not running
+    enqueueJobs(1);
+    QCOMPARE(TActionWorkerPool::jobCount(), 0);
+}
+
+
+void TestActionWorkerPool::restart()
+{
+    TActionWorkerPool *pool = TActionWorkerPool::instance();
+    pool->start(2);
+    QCOMPARE(pool->poolSize(), 2);
+
+    enqueueJobs(20);
+    QVERIFY(waitForJobs(10000));
+    QCOMPARE(doneCount(), 20);
+    QVERIFY(JobController::maxRunning <= 2);
+
+    pool->stop(10000);
+    QVERIFY(!pool->isRunning());
+}
+
+
+int main(int argc, char *argv[])
+{
+    QByteArray root = QDir::tempPath().toLocal8Bit() + "/tf_actionworkerpool_test";
+    QDir().mkpath(root + "/config");
+    QFile ini(root + "/config/application.ini");
+    if (!ini.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return 1;
+    }
+    ini.write("InternalEncoding=UTF-8\n"
+              "HttpOutputEncoding=UTF-8\n"
+              "MultiProcessingModule=hybrid\n");
+    ini.close();
+
+    int appArgc = 2;
+    char *appArgv[] = { argv[0], root.data(), 0 };
+    Q_UNUSED(argc);
+    TWebApplication app(appArgc, appArgv);
+
+    TestActionWorkerPool test;
+    return QTest::qExec(&test, QCoreApplication::arguments().mid(0, 1));
+}
+
+#include "main.moc"
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = atomicqueue
+SOURCES = main.cpp
@@ -0,0 +1,146 @@
+#include <QTest>
+#include <QThread>
+#include "tatomicqueue.h"
+
+const int NumItems = 100000;
+const int BatchSize = 256;
+
+
+/*
+ * Compares TAtomicQueue, which swaps a mutex-protected list, with the
+ * lock-free TAtomicRingBuffer.
+ */
+template <class Queue>
+class Producer : public QThread
+{
+public:
+    Producer(Queue *q, int n) : QThread(), queue(q), count(n) { }
+
+protected:
+    void run()
+    {
+        for (int i = 1; i <= count; ++i) {
+            queue->enqueue(i);
+        }
+    }
+
+private:
+    Queue *queue;
+    int count;
+};
+
+
+class AtomicQueueBench : public QObject
+{
+    Q_OBJECT
+private slots:
+    void ringBufferOrder();
+    void ringBufferOverflow();
+    void benchAtomicQueue_data();
+    void benchAtomicQueue();
+    void benchRingBuffer_data();
+    void benchRingBuffer();
+};
+
+
+void AtomicQueueBench::ringBufferOrder()
+{
+    TAtomicRingBuffer<int> queue(16);
+    QCOMPARE(queue.capacity(), 16);
+    QVERIFY(queue.isEmpty());
+
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(queue.tryEnqueue(i));
+    }
+    QVERIFY(!queue.isEmpty());
+
+    int buf[BatchSize];
+    QCOMPARE(queue.dequeue(buf, BatchSize), 10);
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(buf[i], i);
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+
+void AtomicQueueBench::ringBufferOverflow()
+{
+    TAtomicRingBuffer<int> queue(4);
+    for (int i = 0; i < 100; ++i) {
+        queue.enqueue(i);
+    }
+    QVERIFY(!queue.tryEnqueue(100));
+
+    int val;
+    for (int i = 0; i < 100; ++i) {
+        QCOMPARE(queue.dequeue(&val, 1), 1);
+        QCOMPARE(val, i);
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+
+void AtomicQueueBench::benchAtomicQueue_data()
+{
+    QTest::addColumn<int>("producers");
+    QTest::newRow("1") << 1;
+    QTest::newRow("4") << 4;
+}
+
+
+void AtomicQueueBench::benchAtomicQueue()
+{
+    QFETCH(int, producers);
+
+    QBENCHMARK {
+        TAtomicQueue<int> queue;
+        QList<QThread *> threads;
+        for (int i = 0; i < producers; ++i) {
+            threads << new Producer<TAtomicQueue<int> >(&queue, NumItems);
+            threads.last()->start();
+        }
+
+        int total = 0;
+        while (total < producers * NumItems) {
+            total += queue.dequeue().count();
+        }
+
+        qDeleteAll(threads);  // QThread waits in destructor
+        QCOMPARE(total, producers * NumItems);
+    }
+}
+
+
+void AtomicQueueBench::benchRingBuffer_data()
+{
+    QTest::addColumn<int>("producers");
+    QTest::newRow("1") << 1;
+    QTest::newRow("4") << 4;
+}
+
+
+void AtomicQueueBench::benchRingBuffer()
+{
+    QFETCH(int, producers);
+    int buf[BatchSize];
+
+    QBENCHMARK {
+        TAtomicRingBuffer<int> queue(4096);
+        QList<QThread *> threads;
+        for (int i = 0; i < producers; ++i) {
+            threads << new Producer<TAtomicRingBuffer<int> >(&queue, NumItems);
+            threads.last()->start();
+        }
+
+        int total = 0;
+        while (total < producers * NumItems) {
+            total += queue.dequeue(buf, BatchSize);
+        }
+
+        qDeleteAll(threads);
+        QCOMPARE(total, producers * NumItems);
+    }
+}
+
+QTEST_MAIN(AtomicQueueBench)
+#include "main.moc"
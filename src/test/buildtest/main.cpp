@@ -1,5 +1,6 @@
 #include <TSqlORMapper>
 #include <TSqlORMapperIterator>
+#include <TSqlORMapperCursor>
 #include <TSqlQueryORMapper>
 #include <TSqlQueryORMapperIterator>
 #include <TMongoODMapper>
@@ -42,9 +43,23 @@ void build_check_TSqlORMapper()
     mapper.findAllIn(2, QVariantList());
     mapper.updateAll(crt, 1, 1);
     mapper.updateAll(crt, QMap<int, QVariant>());
+    mapper.updateAll(QList<BlogObject>());
+    mapper.insertAll(QList<BlogObject>());
+    mapper.upsertAll(QList<BlogObject>());
     mapper.removeAll(crt);
 }
 
+void build_check_TSqlORMapperCursor()
+{
+    TSqlORMapper<BlogObject> mapper;
+    TSqlORMapperCursor<BlogObject> cur(mapper, TCriteria());
+    cur.isActive();
+    while (cur.next()) {
+        cur.value();
+    }
+    cur.lastError();
+}
+
 void build_check_TSqlORMapperIterator()
 {
     TSqlORMapper<BlogObject> mapper;
@@ -145,6 +160,17 @@ void build_check_TAtomicQueue()
     queue.wait(0);
 }
 
+void build_check_TAtomicRingBuffer()
+{
+    TAtomicRingBuffer<int> queue(16);
+    int buf[4];
+    queue.enqueue(1);
+    queue.tryEnqueue(2);
+    queue.tryDequeue(buf[0]);
+    queue.dequeue(buf, 4);
+    queue.isEmpty();
+}
+
 int main()
 {
     return 0;
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = chunkedresponse
+SOURCES = main.cpp
@@ -0,0 +1,145 @@
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <TWebApplication>
+#include <TActionThread>
+#include <TActionController>
+#include <THttpRequest>
+#include <TSession>
+#include "tsessionmanager.h"
+
+
+class StreamingController : public TActionController
+{
+    Q_OBJECT
+public:
+    StreamingController() : TActionController() { }
+    StreamingController(const StreamingController &) : TActionController() { }
+
+public slots:
+    void index()
+    {
+        session().insert("name", "foo");
+        beginStreaming("text/plain");
+        writeStream("hello");
+        session().insert("after", "streaming");
+    }
+};
+
+T_DECLARE_CONTROLLER(StreamingController, streamingcontroller)
+T_REGISTER_CONTROLLER(streamingcontroller)
+
+/*
+ * Executes requests in this thread, capturing the response
+ */
+class Context : public TActionThread
+{
+public:
+    Context() : TActionThread(0), returnCode(0) { }
+    volatile int returnCode;
+
+    QByteArray request(const QByteArray &header)
+    {
+        output.clear();
+        THttpRequest req(THttpRequestHeader(header), QByteArray(), QHostAddress::LocalHost);
+        execute(req);
+        release();
+        return output;
+    }
+
+protected:
+    void run();
+    qint64 writeResponse(THttpResponseHeader &header, QIODevice *body)
+    {
+        output += header.toByteArray();
+        if (body) {
+            output += body->readAll();
+        }
+        return output.length();
+    }
+    qint64 writeResponseData(const QByteArray &data, bool)
+    {
+        output += data;
+        return data.length();
+    }
+    void closeHttpSocket() { }
+
+private:
+    QByteArray output;
+};
+
+
+class TestChunkedResponse : public QObject
+{
+    Q_OBJECT
+private slots:
+    void sessionCookie();
+};
+
+
+void TestChunkedResponse::sessionCookie()
+{
+    Context *context = dynamic_cast<Context *>(Tf::currentContext());
+    QVERIFY(context);
+
+    QByteArray response = context->request("GET /streaming/index HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    int headerEnd = response.indexOf("\r\n\r\n");
+    QVERIFY(headerEnd > 0);
+    THttpResponseHeader header(response.left(headerEnd + 4));
+
+    QCOMPARE(header.statusCode(), 200);
+    QCOMPARE(header.rawHeader("Transfer-Encoding"), QByteArray("chunked"));
+    QVERIFY(response.mid(headerEnd + 4).startsWith("5\r\nhello\r\n"));
+    QVERIFY(response.endsWith("0\r\n\r\n"));
+
+    // Session cookie sent with the header
+    QByteArray prefix = "\r\nSet-Cookie: " + TSession::sessionName() + '=';
+    int pos = response.left(headerEnd).indexOf(prefix);
+    QVERIFY(pos > 0);
+    pos += prefix.length();
+    QByteArray sessionId = response.mid(pos, response.indexOf("\r\n", pos) - pos).split(';').value(0);
+    QVERIFY(!sessionId.isEmpty());
+
+    TSession session = TSessionManager::instance().findSession(sessionId);
+    QCOMPARE(session.value("name").toString(), QString("foo"));
+    QVERIFY(!session.contains("after"));  // changed after the header was sent
+}
+
+
+void Context::run()
+{
+    TestChunkedResponse obj;
+    returnCode = QTest::qExec(&obj, QCoreApplication::arguments().mid(0, 1));
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Web root of an application storing sessions in the cookie
+    QByteArray root = QDir::tempPath().toLocal8Bit() + "/tf_chunkedresponse_test";
+    QDir().mkpath(root + "/config");
+    QFile ini(root + "/config/application.ini");
+    if (!ini.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return 1;
+    }
+    ini.write("InternalEncoding=UTF-8\n"
+              "HttpOutputEncoding=UTF-8\n"
+              "MultiProcessingModule=thread\n"
+              "Session.Name=TFSESSION\n"
+              "Session.StoreType=cookie\n"
+              "Session.Secret=secret\n"
+              "Session.CsrfProtectionKey=_csrfId\n");
+    ini.close();
+
+    int appArgc = 2;
+    char *appArgv[] = { argv[0], root.data(), 0 };
+    Q_UNUSED(argc);
+    TWebApplication app(appArgc, appArgv);
+
+    Context context;
+    context.start();
+    context.wait();
+    return context.returnCode;
+}
+
+#include "main.moc"
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = controllerpool
+SOURCES = main.cpp
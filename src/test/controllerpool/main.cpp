@@ -0,0 +1,244 @@
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <QSqlQuery>
+#include <TWebApplication>
+#include <TActionThread>
+#include <TActionController>
+#include <THttpRequest>
+#include "tsqldatabasepool.h"
+
+
+/*
+ * State of the controller seen at the beginning of an action
+ */
+struct ControllerState
+{
+    const void *instance;
+    QByteArray dirtyHeader;
+    bool bodyNull;
+    int statusCode;
+    QByteArray contentType;
+    QString flash;
+    QString sessionValue;
+    int variantCount;
+};
+
+
+class PooledController : public TActionController
+{
+    Q_OBJECT
+public:
+    PooledController() : TActionController() { }
+    PooledController(const PooledController &) : TActionController() { }
+    bool reusable() const { return true; }
+
+    static ControllerState state;
+
+public slots:
+    // Leaves the state of every kind, and rolls back the insert
+    void dirty()
+    {
+        recordState();
+        insertLog("dirty");
+        httpResponse().header().setRawHeader("X-Dirty", "1");
+        setStatusCode(Tf::Created);
+        setContentType("application/octet-stream");
+        setFlash("notice", "dirty");
+        session().insert("name", "dirty");
+        QVariantMap vars;
+        vars.insert("dirty", "1");
+        exportVariants(vars);
+        rollbackTransaction();
+        renderText("dirty");
+    }
+
+    void check()
+    {
+        recordState();
+        insertLog("check");
+        renderText("check");
+    }
+
+private:
+    void recordState()
+    {
+        state.instance = this;
+        state.dirtyHeader = httpResponse().header().rawHeader("X-Dirty");
+        state.bodyNull = httpResponse().isBodyNull();
+        state.statusCode = statusCode();
+        state.contentType = contentType();
+        state.flash = flash("notice");
+        state.sessionValue = session().value("name").toString();
+        state.variantCount = allVariants().count();
+    }
+
+    void insertLog(const QString &action)
+    {
+        QSqlQuery query(Tf::currentSqlDatabase(0));
+        query.exec("INSERT INTO log (action) VALUES ('" + action + "')");
+    }
+};
+
+ControllerState PooledController::state;
+
+T_DECLARE_CONTROLLER(PooledController, pooledcontroller)
+T_REGISTER_CONTROLLER(pooledcontroller)
+
+/*
+ * Executes requests in this thread, capturing the response
+ */
+class Context : public TActionThread
+{
+public:
+    Context() : TActionThread(0), returnCode(0) { }
+    volatile int returnCode;
+
+    QByteArray request(const QByteArray &header)
+    {
+        output.clear();
+        THttpRequest req(THttpRequestHeader(header), QByteArray(), QHostAddress::LocalHost);
+        execute(req);
+        release();
+        return output;
+    }
+
+protected:
+    void run();
+    qint64 writeResponse(THttpResponseHeader &header, QIODevice *body)
+    {
+        output += header.toByteArray();
+        if (body) {
+            output += body->readAll();
+        }
+        return output.length();
+    }
+    qint64 writeResponseData(const QByteArray &data, bool)
+    {
+        output += data;
+        return data.length();
+    }
+    void closeHttpSocket() { }
+
+private:
+    QByteArray output;
+};
+
+
+class TestControllerPool : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void clearedState();
+};
+
+
+// Runs the SQL without the transaction of the context
+static int execSql(const QString &sql)
+{
+    QSqlDatabase db = TSqlDatabasePool::instance()->database(0);
+    QSqlQuery query(db);
+    int value = -1;
+    if (query.exec(sql)) {
+        value = (query.next()) ? query.value(0).toInt() : 0;
+    }
+    query.clear();
+    TSqlDatabasePool::instance()->pool(db);
+    return value;
+}
+
+
+static int statusCodeOf(const QByteArray &response)
+{
+    return THttpResponseHeader(response.left(response.indexOf("\r\n\r\n") + 4)).statusCode();
+}
+
+
+void TestControllerPool::initTestCase()
+{
+    QVERIFY(execSql("DROP TABLE IF EXISTS log") >= 0);
+    QVERIFY(execSql("CREATE TABLE log (id INTEGER PRIMARY KEY AUTOINCREMENT, action VARCHAR(20))") >= 0);
+}
+
+
+void TestControllerPool::clearedState()
+{
+    Context *context = dynamic_cast<Context *>(Tf::currentContext());
+    QVERIFY(context);
+
+    QByteArray response = context->request("GET /pooled/dirty HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    QCOMPARE(statusCodeOf(response), (int)Tf::Created);
+    QVERIFY(response.endsWith("dirty"));
+    const void *instance = PooledController::state.instance;
+    QCOMPARE(execSql("SELECT COUNT(*) FROM log"), 0);  // rolled back
+
+    for (int i = 1; i <= 2; ++i) {
+        response = context->request("GET /pooled/check HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        QCOMPARE(statusCodeOf(response), 200);
+        QVERIFY(!response.contains("X-Dirty"));
+        QVERIFY(response.endsWith("check"));
+
+        // Reused with the state of a new controller
+        const ControllerState &st = PooledController::state;
+        QVERIFY(st.instance == instance);
+        QVERIFY(st.dirtyHeader.isEmpty());
+        QVERIFY(st.bodyNull);
+        QCOMPARE(st.statusCode, (int)Tf::OK);
+        QCOMPARE(st.contentType, QByteArray("text/html"));
+        QVERIFY(st.flash.isEmpty());
+        QVERIFY(st.sessionValue.isEmpty());
+        QCOMPARE(st.variantCount, 0);
+
+        // Not rolled back any more
+        QCOMPARE(execSql("SELECT COUNT(*) FROM log"), i);
+    }
+}
+
+
+void Context::run()
+{
+    TestControllerPool obj;
+    returnCode = QTest::qExec(&obj, QCoreApplication::arguments().mid(0, 1));
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Web root of an application with a SQLite database
+    QByteArray root = QDir::tempPath().toLocal8Bit() + "/tf_controllerpool_test";
+    QDir().mkpath(root + "/config");
+    QDir().mkpath(root + "/db");
+    QFile ini(root + "/config/application.ini");
+    QFile dbini(root + "/config/database.ini");
+    if (!ini.open(QIODevice::WriteOnly | QIODevice::Truncate) || !dbini.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return 1;
+    }
+    ini.write("InternalEncoding=UTF-8\n"
+              "HttpOutputEncoding=UTF-8\n"
+              "MultiProcessingModule=thread\n"
+              "MPM.thread.MaxThreadsPerAppServer=2\n"
+              "SqlDatabaseSettingsFiles=database.ini\n"
+              "Session.Name=TFSESSION\n"
+              "Session.StoreType=cookie\n"
+              "Session.Secret=secret\n"
+              "Session.CsrfProtectionKey=_csrfId\n");
+    ini.close();
+    dbini.write("[product]\n"
+                "DriverType=QSQLITE\n"
+                "DatabaseName=db/controllerpool.db\n");
+    dbini.close();
+
+    int appArgc = 2;
+    char *appArgv[] = { argv[0], root.data(), 0 };
+    Q_UNUSED(argc);
+    TWebApplication app(appArgc, appArgv);
+    TSqlDatabasePool::instantiate();
+
+    Context context;
+    context.start();
+    context.wait();
+    return context.returnCode;
+}
+
+#include "main.moc"
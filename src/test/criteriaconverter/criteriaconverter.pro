@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = criteriaconverter
+SOURCES = main.cpp
@@ -0,0 +1,133 @@
+#include <QTest>
+#include <TCriteria>
+#include <TCriteriaConverter>
+
+
+class Item : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int id READ id)
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(int age READ age)
+public:
+    enum PropertyIndex {
+        Id = 0,
+        Name,
+        Age,
+    };
+
+    int id() const { return 0; }
+    QString name() const { return QString(); }
+    int age() const { return 0; }
+};
+
+
+class TestCriteriaConverter : public QObject
+{
+    Q_OBJECT
+private slots:
+    void propertyName();
+    void parameterized_data();
+    void parameterized();
+    void sameShape();
+    void sameAsString_data();
+    void sameAsString();
+};
+
+
+void TestCriteriaConverter::propertyName()
+{
+    QCOMPARE(TCriteriaConverter<Item>::propertyName(Item::Id), QString("id"));
+    QCOMPARE(TCriteriaConverter<Item>::propertyName(Item::Age), QString("age"));
+    QVERIFY(TCriteriaConverter<Item>::propertyName(10).isEmpty());
+}
+
+
+void TestCriteriaConverter::parameterized_data()
+{
+    QTest::addColumn<TCriteria>("criteria");
+    QTest::addColumn<QString>("sql");
+    QTest::addColumn<QVariantList>("values");
+
+    QTest::newRow("equal") << TCriteria(Item::Name, "foo")
+                           << QString("name=?") << (QVariantList() << "foo");
+    QTest::newRow("and") << TCriteria(Item::Name, "foo").add(Item::Age, TSql::GreaterThan, 20)
+                         << QString("name=? AND age>?") << (QVariantList() << "foo" << 20);
+    QTest::newRow("or") << TCriteria(Item::Id, 1).addOr(Item::Id, 2)
+                        << QString("( id=? OR id=? )") << (QVariantList() << 1 << 2);
+    QTest::newRow("in") << TCriteria(Item::Id, TSql::In, QVariantList() << 1 << 2 << 3)
+                        << QString("id IN (?,?,?)") << (QVariantList() << 1 << 2 << 3);
+    QTest::newRow("between") << TCriteria(Item::Age, TSql::Between, 10, 20)
+                             << QString("(age BETWEEN ? AND ?)") << (QVariantList() << 10 << 20);
+    QTest::newRow("isnull") << TCriteria(Item::Name, TSql::IsNull)
+                            << QString("name IS NULL") << QVariantList();
+}
+
+
+void TestCriteriaConverter::parameterized()
+{
+    QFETCH(TCriteria, criteria);
+    QFETCH(QString, sql);
+    QFETCH(QVariantList, values);
+
+    QSqlDatabase db;
+    QVariantList actual;
+    TCriteriaConverter<Item> conv(criteria, db);
+    QCOMPARE(conv.toParameterizedString(actual), sql);
+    QCOMPARE(actual, values);
+}
+
+
+void TestCriteriaConverter::sameShape()
+{
+    QSqlDatabase db;
+    QVariantList v1, v2, v3;
+    QString s1 = TCriteriaConverter<Item>(TCriteria(Item::Id, TSql::In, QVariantList() << 1 << 2), db).toParameterizedString(v1);
+    QString s2 = TCriteriaConverter<Item>(TCriteria(Item::Id, TSql::In, QVariantList() << 3 << 4), db).toParameterizedString(v2);
+    QString s3 = TCriteriaConverter<Item>(TCriteria(Item::Id, TSql::In, QVariantList() << 5), db).toParameterizedString(v3);
+
+    QCOMPARE(s1, s2);
+    QCOMPARE(v2, QVariantList() << 3 << 4);
+    QCOMPARE(s3, QString("id IN (?)"));
+}
+
+
+void TestCriteriaConverter::sameAsString_data()
+{
+    QTest::addColumn<TCriteria>("criteria");
+    QTest::addColumn<QString>("sql");
+    QTest::addColumn<QVariantList>("values");
+
+    // A value formatted to an empty string is skipped, and NULL is bound
+    QVariant empty = QVariantMap();
+    QTest::newRow("null") << TCriteria(Item::Id, TSql::In, QVariantList() << 1 << QVariant())
+                          << QString("id IN (?,?)") << (QVariantList() << 1 << QVariant());
+    QTest::newRow("empty") << TCriteria(Item::Id, TSql::In, QVariantList() << 1 << empty << 2)
+                           << QString("id IN (?,?)") << (QVariantList() << 1 << 2);
+    QTest::newRow("allEmpty") << TCriteria(Item::Id, TSql::NotIn, QVariantList() << empty)
+                              << QString() << QVariantList();
+}
+
+
+void TestCriteriaConverter::sameAsString()
+{
+    QFETCH(TCriteria, criteria);
+    QFETCH(QString, sql);
+    QFETCH(QVariantList, values);
+
+    QSqlDatabase db;
+    QVariantList actual;
+    TCriteriaConverter<Item> conv(criteria, db);
+    QCOMPARE(conv.toParameterizedString(actual), sql);
+    QCOMPARE(actual, values);
+
+    // Same as the SQL with the values formatted
+    QString str = sql;
+    for (int i = 0; i < values.count(); ++i) {
+        str.replace(str.indexOf('?'), 1, TSqlQuery::formatValue(values[i], db));
+    }
+    QCOMPARE(conv.toString(), str);
+}
+
+QTEST_MAIN(TestCriteriaConverter)
+#include "main.moc"
@@ -0,0 +1,168 @@
+#include <QTest>
+#include <QMetaType>
+#include "tdispatcher.h"
+
+const int NumControllers = 50;
+
+
+class BenchController : public QObject
+{
+    Q_OBJECT
+public:
+    BenchController() : QObject() { }
+    BenchController(const BenchController &) : QObject() { }
+
+    static QString lastArgs;
+
+public slots:
+    void index() { lastArgs = "index"; }
+    void show(const QString &id) { lastArgs = id; }
+    void edit(const QString &id, const QString &tab) { lastArgs = id + "," + tab; }
+    void create() { }
+    void save(const QString &) { }
+    void remove(const QString &) { }
+    void list(const QString &, const QString &, const QString &) { }
+};
+
+QString BenchController::lastArgs;
+Q_DECLARE_METATYPE(BenchController)
+
+
+/*
+ * Measures the overhead of dispatching a request to a controller:
+ * construction by the meta type name, the slot lookup and the call.
+ */
+class TestDispatcher : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void invoke_data();
+    void invoke();
+    void benchDispatch_data();
+    void benchDispatch();
+    void benchLegacyDispatch_data();
+    void benchLegacyDispatch();
+};
+
+
+// Dispatching without the table, as before
+static bool legacyInvoke(const QString &metaType, const QByteArray &method, const QStringList &args)
+{
+    static const char *const params[] = { "()", "(QString)", "(QString,QString)", "(QString,QString,QString)" };
+
+    int typeId = QMetaType::type(metaType.toLatin1().constData());
+#if QT_VERSION >= 0x050200
+    QObject *ptr = static_cast<QObject *>(QMetaType::create(typeId));
+#else
+    QObject *ptr = static_cast<QObject *>(QMetaType::construct(typeId));
+#endif
+
+    bool res = false;
+    for (int i = qMin(args.count(), 3); i >= 0; --i) {
+        QByteArray mtd = method + params[i];
+        int idx = ptr->metaObject()->indexOfSlot(mtd.constData());
+        if (idx >= 0) {
+            QMetaMethod mm = ptr->metaObject()->method(idx);
+            switch (i) {
+            case 0:
+                res = mm.invoke(ptr, Qt::AutoConnection);
+                break;
+            case 1:
+                res = mm.invoke(ptr, Qt::AutoConnection, Q_ARG(QString, args[0]));
+                break;
+            default:
+                res = mm.invoke(ptr, Qt::AutoConnection, Q_ARG(QString, args[0]), Q_ARG(QString, args[1]));
+                break;
+            }
+            break;
+        }
+    }
+    QMetaType::destroy(typeId, ptr);
+    return res;
+}
+
+
+void TestDispatcher::initTestCase()
+{
+    for (int i = 0; i < NumControllers; ++i) {
+        QByteArray name = "bench" + QByteArray::number(i) + "controller";
+        qRegisterMetaType<BenchController>(name.constData());
+    }
+}
+
+
+void TestDispatcher::invoke_data()
+{
+    QTest::addColumn<QByteArray>("action");
+    QTest::addColumn<QStringList>("args");
+    QTest::addColumn<QString>("result");
+
+    QTest::newRow("1") << QByteArray("index") << QStringList() << "index";
+    QTest::newRow("2") << QByteArray("show") << (QStringList() << "12") << "12";
+    QTest::newRow("3") << QByteArray("edit") << (QStringList() << "12" << "a") << "12,a";
+    QTest::newRow("4") << QByteArray("show") << (QStringList() << "1" << "2" << "3") << "1";
+}
+
+
+void TestDispatcher::invoke()
+{
+    QFETCH(QByteArray, action);
+    QFETCH(QStringList, args);
+    QFETCH(QString, result);
+
+    for (int i = 0; i < 2; ++i) {  // resolves and then hits the table
+        BenchController::lastArgs.clear();
+        TDispatcher<QObject> dispatcher("bench7controller");
+        QVERIFY(dispatcher.invoke(action, args));
+        QCOMPARE(BenchController::lastArgs, result);
+    }
+
+    TDispatcher<QObject> dispatcher("bench7controller");
+    QVERIFY(!dispatcher.invoke("nosuchaction", args));
+}
+
+
+void TestDispatcher::benchDispatch_data()
+{
+    QTest::addColumn<QByteArray>("action");
+    QTest::addColumn<QStringList>("args");
+    QTest::newRow("no args") << QByteArray("index") << QStringList();
+    QTest::newRow("2 args") << QByteArray("edit") << (QStringList() << "12" << "a");
+}
+
+
+void TestDispatcher::benchDispatch()
+{
+    QFETCH(QByteArray, action);
+    QFETCH(QStringList, args);
+
+    QBENCHMARK {
+        for (int i = 0; i < NumControllers; ++i) {
+            TDispatcher<QObject> dispatcher(QString("bench%1controller").arg(i));
+            dispatcher.invoke(action, args);
+        }
+    }
+}
+
+
+void TestDispatcher::benchLegacyDispatch_data()
+{
+    benchDispatch_data();
+}
+
+
+void TestDispatcher::benchLegacyDispatch()
+{
+    QFETCH(QByteArray, action);
+    QFETCH(QStringList, args);
+
+    QBENCHMARK {
+        for (int i = 0; i < NumControllers; ++i) {
+            legacyInvoke(QString("bench%1controller").arg(i), action, args);
+        }
+    }
+}
+
+QTEST_MAIN(TestDispatcher)
+#include "main.moc"
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = epollwakeup
+SOURCES = main.cpp
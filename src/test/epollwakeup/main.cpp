@@ -0,0 +1,238 @@
+#include <QTest>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <TAtomicQueue>
+#include "tepoll.h"
+
+const int NumMessages = 2000;
+const quint64 UnknownSocketId = 0xFFFFFF;  // not registered, so the send data is discarded
+
+
+/*
+ * Sets send data to the event loop from another thread after a delay,
+ * as an action worker does
+ */
+class Worker : public QThread
+{
+public:
+    Worker(int delayMsecs, int count = 1) : QThread(), delay(delayMsecs), num(count) { }
+
+protected:
+    void run()
+    {
+        msleep(delay);
+        for (int i = 0; i < num; ++i) {
+            TEpoll::instanceAt(0)->setWorkerFinished(UnknownSocketId);
+        }
+    }
+
+private:
+    int delay;
+    int num;
+};
+
+
+/*
+ * Measures the latency of handing send data from a worker thread to
+ * the event loop, one at a time.
+ *  - Polling: sets the data to a TAtomicQueue, on which the event loop
+ *    waits for up to 4 msecs and polls with timeout 0, as it did before.
+ *  - EventFd: sets the data to TEpoll, which wakes up the event loop
+ *    blocking in wait().
+ */
+class Producer : public QThread
+{
+public:
+    Producer(const QElapsedTimer *t, TAtomicQueue<int> *q = 0) : QThread(), timer(t), queue(q), sentAt(0), mutex(), handled() { }
+
+    qint64 sentTime()
+    {
+        QMutexLocker locker(&mutex);
+        return sentAt;
+    }
+
+    void setHandled() { handled.release(); }
+
+protected:
+    void run()
+    {
+        for (int i = 0; i < NumMessages; ++i) {
+            {
+                QMutexLocker locker(&mutex);
+                sentAt = timer->nsecsElapsed();
+            }
+            if (queue) {
+                queue->enqueue(i);
+            } else {
+                TEpoll::instanceAt(0)->setSendData(UnknownSocketId, QByteArray("data"));
+            }
+            handled.acquire();
+        }
+    }
+
+private:
+    const QElapsedTimer *timer;
+    TAtomicQueue<int> *queue;
+    qint64 sentAt;
+    QMutex mutex;
+    QSemaphore handled;
+};
+
+
+class EpollWakeUp : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void timeout();
+    void wakeUp();
+    void coalesced();
+    void polling();
+    void eventFd();
+
+private:
+    static int drain(TEpoll *epoll);
+    static void report(const char *name, QList<qint64> &latencies);
+};
+
+
+void EpollWakeUp::initTestCase()
+{
+    TEpoll::instantiate(1);
+    TEpoll::instanceAt(0)->attachCurrentThread();
+}
+
+/*
+  Reads the events as the event loop does; returns the number of the
+  sockets, which must be none.
+ */
+int EpollWakeUp::drain(TEpoll *epoll)
+{
+    int sockets = 0;
+    while (epoll->next()) {
+        ++sockets;
+    }
+    epoll->dispatchSendData();
+    return sockets;
+}
+
+
+void EpollWakeUp::timeout()
+{
+    TEpoll *epoll = TEpoll::instance();
+    QElapsedTimer time;
+    time.start();
+    QCOMPARE(epoll->wait(100), 0);
+    QVERIFY(time.elapsed() >= 90);
+}
+
+
+void EpollWakeUp::wakeUp()
+{
+    TEpoll *epoll = TEpoll::instance();
+
+    for (int i = 0; i < 3; ++i) {
+        Worker worker(50);
+        worker.start();
+
+        // Woken up by the worker long before the timeout
+        QElapsedTimer time;
+        time.start();
+        QCOMPARE(epoll->wait(5000), 1);
+        QVERIFY(time.elapsed() < 2000);
+        QCOMPARE(drain(epoll), 0);
+        QVERIFY(worker.wait(5000));
+
+        // Drained; the next wait times out
+        time.start();
+        QCOMPARE(epoll->wait(100), 0);
+        QVERIFY(time.elapsed() >= 90);
+    }
+}
+
+
+void EpollWakeUp::coalesced()
+{
+    TEpoll *epoll = TEpoll::instance();
+
+    // Many notifications are read at once
+    Worker worker(0, 100);
+    worker.start();
+    QVERIFY(worker.wait(5000));
+
+    QCOMPARE(epoll->wait(1000), 1);
+    QCOMPARE(drain(epoll), 0);
+    QCOMPARE(epoll->wait(100), 0);
+}
+
+
+void EpollWakeUp::report(const char *name, QList<qint64> &latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    qint64 p50 = latencies[latencies.count() * 50 / 100];
+    qint64 p99 = latencies[latencies.count() * 99 / 100];
+    qDebug("%s: p50 %lld usecs  p99 %lld usecs", name, p50 / 1000, p99 / 1000);
+}
+
+
+void EpollWakeUp::polling()
+{
+    int epfd = epoll_create(1);
+    struct epoll_event events[16];
+    TAtomicQueue<int> queue;
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<qint64> latencies;
+    Producer producer(&timer, &queue);
+    producer.start();
+
+    int numEvents = 0;
+    while (latencies.count() < NumMessages) {
+        if (!numEvents) {
+            queue.wait(4);  // mitigation of busy loop
+        }
+
+        if (!queue.dequeue().isEmpty()) {
+            latencies << timer.nsecsElapsed() - producer.sentTime();
+            producer.setHandled();
+        }
+        numEvents = epoll_wait(epfd, events, 16, 0);
+    }
+
+    QVERIFY(producer.wait(5000));
+    ::close(epfd);
+    report("polling", latencies);
+}
+
+
+void EpollWakeUp::eventFd()
+{
+    TEpoll *epoll = TEpoll::instance();
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<qint64> latencies;
+    Producer producer(&timer);
+    producer.start();
+
+    while (latencies.count() < NumMessages) {
+        int num = epoll->wait(1000);
+        QVERIFY(num > 0);
+        latencies << timer.nsecsElapsed() - producer.sentTime();
+        QCOMPARE(drain(epoll), 0);
+        producer.setHandled();
+    }
+
+    QVERIFY(producer.wait(5000));
+    report("eventfd", latencies);
+}
+
+QTEST_MAIN(EpollWakeUp)
+#include "main.moc"
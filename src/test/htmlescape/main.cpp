@@ -1,6 +1,7 @@
 #include <QtTest/QtTest>
 #include <QFile>
 #include <THttpUtility>
+#include "../../thtmlescapekernel.h"
 
 
 class HtmlParser : public QObject
@@ -13,9 +14,29 @@ private slots:
     void escapeQuotes();
     void escapeNoQuotes_data();
     void escapeNoQuotes();
+    void escapePosition_data();
+    void escapePosition();
+    void appendEscaped();
+    void benchmark_data();
+    void benchmark();
+    void benchmarkUtf8_data();
+    void benchmarkUtf8();
 };
 
 
+static QString benchmarkText(int length, bool dirty)
+{
+    const QString clean = QString::fromUtf8("The quick brown fox jumps over the lazy dog \xe3\x81\x93\xe3\x82\x93 ");
+    const QString special = "<a href=\"x\">Tom & 'Jerry'</a> ";
+    QString text;
+    while (text.length() < length) {
+        text += (dirty) ? special : clean;
+    }
+    text.truncate(length);
+    return text;
+}
+
+
 void HtmlParser::escapeCompat_data()
 {
      QTest::addColumn<QString>("string");
@@ -85,5 +106,110 @@ void HtmlParser::escapeNoQuotes()
     QCOMPARE(actualStr, correct);
 }
 
+void HtmlParser::escapePosition_data()
+{
+    QTest::addColumn<int>("kernel");
+
+    // The kernels the CPU supports
+    QTest::newRow("scalar") << (int)THtmlEscapeKernel::Scalar;
+    if (THtmlEscapeKernel::utf16(THtmlEscapeKernel::Sse2)) {
+        QTest::newRow("sse2") << (int)THtmlEscapeKernel::Sse2;
+    }
+    if (THtmlEscapeKernel::utf16(THtmlEscapeKernel::Avx2)) {
+        QTest::newRow("avx2") << (int)THtmlEscapeKernel::Avx2;
+    }
+}
+
+void HtmlParser::escapePosition()
+{
+    QFETCH(int, kernel);
+    THtmlEscapeKernel::Utf16FindFunc findUtf16 = THtmlEscapeKernel::utf16((THtmlEscapeKernel::Type)kernel);
+    THtmlEscapeKernel::ByteFindFunc findBytes = THtmlEscapeKernel::bytes((THtmlEscapeKernel::Type)kernel);
+    QVERIFY(findUtf16);
+    QVERIFY(findBytes);
+
+    // Special characters at every position across the SIMD blocks
+    const QString specials = "&<>\"'";
+    const char *entities[] = { "&amp;", "&lt;", "&gt;", "&quot;", "&#039;" };
+
+    for (int len = 1; len < 80; ++len) {
+        for (int pos = 0; pos < len; ++pos) {
+            for (int k = 0; k < specials.length(); ++k) {
+                QString str(len, QLatin1Char('a'));
+                str[pos] = specials[k];
+                const QByteArray utf8 = str.toUtf8();
+                const ushort *u = str.utf16();
+                const uchar *b = (const uchar *)utf8.constData();
+                const bool quote = (k >= 3);
+
+                QCOMPARE(findUtf16(u, 0, len, true, true), pos);
+                QCOMPARE(findBytes(b, 0, len, true, true), pos);
+                QCOMPARE(findUtf16(u, pos + 1, len, true, true), len);
+                QCOMPARE(findBytes(b, pos + 1, len, true, true), len);
+                QCOMPARE(findUtf16(u, 0, len, false, false), (quote) ? len : pos);
+                QCOMPARE(findBytes(b, 0, len, false, false), (quote) ? len : pos);
+
+                QString correct = str.left(pos) + entities[k] + str.mid(pos + 1);
+                QCOMPARE(THttpUtility::htmlEscape(str), correct);
+
+                QByteArray bytes;
+                THttpUtility::appendHtmlEscaped(bytes, utf8);
+                QCOMPARE(bytes, correct.toUtf8());
+            }
+        }
+        QString clean(len, QChar(0x3042));
+        QCOMPARE(findUtf16(clean.utf16(), 0, len, true, true), len);
+        QCOMPARE(THttpUtility::htmlEscape(clean), clean);
+    }
+}
+
+void HtmlParser::appendEscaped()
+{
+    QString str = "prefix:";
+    THttpUtility::appendHtmlEscaped(str, "<a href=\"hoge\">a & b</a>", Tf::NoQuotes);
+    QCOMPARE(str, QString("prefix:&lt;a href=\"hoge\"&gt;a &amp; b&lt;/a&gt;"));
+
+    QByteArray bytes = "prefix:";
+    THttpUtility::appendHtmlEscaped(bytes, QString::fromUtf8("\xe3\x81\x82 'a' & \"b\"").toUtf8());
+    QCOMPARE(bytes, QByteArray("prefix:\xe3\x81\x82 &#039;a&#039; &amp; &quot;b&quot;"));
+}
+
+void HtmlParser::benchmark_data()
+{
+    QTest::addColumn<QString>("string");
+
+    QTest::newRow("short clean") << benchmarkText(16, false);
+    QTest::newRow("short dirty") << benchmarkText(16, true);
+    QTest::newRow("long clean") << benchmarkText(64 * 1024, false);
+    QTest::newRow("long dirty") << benchmarkText(64 * 1024, true);
+}
+
+void HtmlParser::benchmark()
+{
+    QFETCH(QString, string);
+    QString escaped;
+    QBENCHMARK {
+        escaped = THttpUtility::htmlEscape(string);
+    }
+    QVERIFY(escaped.length() >= string.length());
+}
+
+void HtmlParser::benchmarkUtf8_data()
+{
+    benchmark_data();
+}
+
+void HtmlParser::benchmarkUtf8()
+{
+    QFETCH(QString, string);
+    const QByteArray utf8 = string.toUtf8();
+    QByteArray escaped;
+    QBENCHMARK {
+        escaped.truncate(0);
+        THttpUtility::appendHtmlEscaped(escaped, utf8);
+    }
+    QVERIFY(escaped.length() >= utf8.length());
+}
+
 QTEST_MAIN(HtmlParser)
 #include "main.moc"
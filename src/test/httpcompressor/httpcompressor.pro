@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = httpcompressor
+SOURCES = main.cpp
@@ -0,0 +1,82 @@
+#include <QTest>
+#include <QtEndian>
+#include "thttpcompressor.h"
+
+
+class TestHttpCompressor : public QObject
+{
+    Q_OBJECT
+private slots:
+    void crc32();
+    void deflate();
+    void gzip();
+    void negotiate_data();
+    void negotiate();
+};
+
+
+void TestHttpCompressor::crc32()
+{
+    QCOMPARE(THttpCompressor::crc32("123456789"), (quint32)0xCBF43926);
+    QCOMPARE(THttpCompressor::crc32(""), (quint32)0);
+}
+
+
+void TestHttpCompressor::deflate()
+{
+    QByteArray data = QByteArray("<html><body>hello</body></html>").repeated(100);
+    QByteArray deflated = THttpCompressor::deflate(data);
+    QVERIFY(deflated.length() < data.length());
+
+    // Restores the length prefix of qCompress()
+    quint32 len = qToBigEndian((quint32)data.length());
+    QByteArray prefixed = QByteArray((const char *)&len, 4) + deflated;
+    QCOMPARE(qUncompress(prefixed), data);
+}
+
+
+void TestHttpCompressor::gzip()
+{
+    QByteArray data = QByteArray("{\"key\":\"value\"}").repeated(100);
+    QByteArray gz = THttpCompressor::gzip(data);
+    QVERIFY(gz.length() < data.length());
+    QCOMPARE((uchar)gz[0], (uchar)0x1f);
+    QCOMPARE((uchar)gz[1], (uchar)0x8b);
+    QCOMPARE((int)gz[2], 8);
+
+    // Deflate data same as the zlib stream
+    QByteArray deflated = THttpCompressor::deflate(data);
+    QCOMPARE(gz.mid(10, gz.length() - 18), deflated.mid(2, deflated.length() - 6));
+
+    quint32 trailer[2];
+    memcpy(trailer, gz.constData() + gz.length() - 8, 8);
+    QCOMPARE(qFromLittleEndian(trailer[0]), THttpCompressor::crc32(data));
+    QCOMPARE(qFromLittleEndian(trailer[1]), (quint32)data.length());
+
+    QVERIFY(THttpCompressor::gzip(QByteArray()).isEmpty());
+}
+
+
+void TestHttpCompressor::negotiate_data()
+{
+    QTest::addColumn<QByteArray>("acceptEncoding");
+    QTest::addColumn<QByteArray>("encoding");
+
+    QTest::newRow("1") << QByteArray("gzip, deflate, br") << QByteArray("gzip");
+    QTest::newRow("2") << QByteArray("deflate") << QByteArray("deflate");
+    QTest::newRow("3") << QByteArray("gzip;q=0, deflate") << QByteArray("deflate");
+    QTest::newRow("4") << QByteArray("gzip; q=0.5") << QByteArray("gzip");
+    QTest::newRow("5") << QByteArray("identity") << QByteArray();
+    QTest::newRow("6") << QByteArray() << QByteArray();
+}
+
+
+void TestHttpCompressor::negotiate()
+{
+    QFETCH(QByteArray, acceptEncoding);
+    QFETCH(QByteArray, encoding);
+    QCOMPARE(THttpCompressor::negotiate(acceptEncoding), encoding);
+}
+
+QTEST_MAIN(TestHttpCompressor)
+#include "main.moc"
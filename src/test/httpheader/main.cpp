@@ -60,6 +60,12 @@ void TestHttpHeader::parseHttpRequestHeader()
     QFETCH(QString, data);
     QHttpRequestHeader qhttp(data);
     THttpRequestHeader thttp(data.toLatin1());
+
+    // Parsing in place gives the same result
+    QByteArray raw = data.toLatin1();
+    raw += raw.endsWith("\r\n") ? "\r\n" : "\r\n\r\n";
+    THttpRequestHeader tview(raw.constData(), raw.length());
+    QCOMPARE(tview.toByteArray(), thttp.toByteArray());
 //     qDebug("Qt: %s", qPrintable(qhttp.toString()));
 //     qDebug("Tf: %s", thttp.toByteArray().data());
 
@@ -0,0 +1,137 @@
+#include <QTest>
+#include <QTemporaryFile>
+#include "tpartialfile.h"
+
+typedef QList<QPair<qint64, qint64> > RangeList;
+Q_DECLARE_METATYPE(RangeList)
+
+
+class TestPartialFile : public QObject
+{
+    Q_OBJECT
+private slots:
+    void parseRange_data();
+    void parseRange();
+    void readSingleRange();
+    void readMultipleRanges();
+    void seek();
+};
+
+
+void TestPartialFile::parseRange_data()
+{
+    QTest::addColumn<QByteArray>("range");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<RangeList>("ranges");
+
+    QTest::newRow("1") << QByteArray("bytes=0-499") << true << (RangeList() << qMakePair(0LL, 500LL));
+    QTest::newRow("2") << QByteArray("bytes=500-999") << true << (RangeList() << qMakePair(500LL, 500LL));
+    QTest::newRow("3") << QByteArray("bytes=-500") << true << (RangeList() << qMakePair(500LL, 500LL));
+    QTest::newRow("4") << QByteArray("bytes=900-") << true << (RangeList() << qMakePair(900LL, 100LL));
+    QTest::newRow("5") << QByteArray("bytes=0-0, -1") << true << (RangeList() << qMakePair(0LL, 1LL) << qMakePair(999LL, 1LL));
+    QTest::newRow("6") << QByteArray("bytes=900-2000") << true << (RangeList() << qMakePair(900LL, 100LL));
+    QTest::newRow("7") << QByteArray("bytes=-2000") << true << (RangeList() << qMakePair(0LL, 1000LL));
+    QTest::newRow("8") << QByteArray("bytes=1000-") << true << RangeList();
+    QTest::newRow("9") << QByteArray("bytes=-0") << true << RangeList();
+    QTest::newRow("10") << QByteArray("bytes=1000-1100, 0-9") << true << (RangeList() << qMakePair(0LL, 10LL));
+    QTest::newRow("11") << QByteArray("bytes=500-100") << false << RangeList();
+    QTest::newRow("12") << QByteArray("bytes=a-b") << false << RangeList();
+    QTest::newRow("13") << QByteArray("bytes=-") << false << RangeList();
+    QTest::newRow("14") << QByteArray("items=0-9") << false << RangeList();
+    QTest::newRow("15") << QByteArray("bytes=") << false << RangeList();
+    QTest::newRow("16") << QByteArray("bytes=500-599, 0-99") << true << (RangeList() << qMakePair(0LL, 100LL) << qMakePair(500LL, 100LL));
+    QTest::newRow("17") << QByteArray("bytes=0-99, 50-199") << true << (RangeList() << qMakePair(0LL, 200LL));
+    QTest::newRow("18") << QByteArray("bytes=0-99, 100-199, 300-399") << true << (RangeList() << qMakePair(0LL, 200LL) << qMakePair(300LL, 100LL));
+    QTest::newRow("19") << QByteArray("bytes=0-499, 500-999") << true << (RangeList() << qMakePair(0LL, 1000LL));
+    QTest::newRow("20") << QByteArray("bytes=-100, 900-") << true << (RangeList() << qMakePair(900LL, 100LL));
+    // More than the content
+    QTest::newRow("21") << QByteArray("bytes=0-, 0-") << false << RangeList();
+    QTest::newRow("22") << QByteArray("bytes=0-600, 400-999") << false << RangeList();
+    QTest::newRow("23") << QByteArray("bytes=0-9" + QByteArray(", 0-99").repeated(11)) << false << RangeList();
+}
+
+
+void TestPartialFile::parseRange()
+{
+    QFETCH(QByteArray, range);
+    QFETCH(bool, valid);
+    QFETCH(RangeList, ranges);
+
+    RangeList result;
+    QCOMPARE(TPartialFile::parseRange(range, 1000, result), valid);
+    QCOMPARE(result, ranges);
+}
+
+
+void TestPartialFile::readSingleRange()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write("0123456789abcdefghij");
+    file.flush();
+
+    QByteArray trailer;
+    QList<TPartialFile::Part> parts = TPartialFile::createParts(RangeList() << qMakePair(5LL, 10LL), 20, "text/plain", "B", trailer);
+    QCOMPARE(parts.count(), 1);
+    QVERIFY(parts[0].header.isEmpty());
+    QVERIFY(trailer.isEmpty());
+
+    TPartialFile partial(file.fileName(), parts, trailer);
+    QVERIFY(partial.open(QIODevice::ReadOnly));
+    QCOMPARE(partial.size(), 10LL);
+    QCOMPARE(partial.readAll(), QByteArray("56789abcde"));
+    QCOMPARE(TPartialFile::contentRange(5, 10, 20), QByteArray("bytes 5-14/20"));
+}
+
+
+void TestPartialFile::readMultipleRanges()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write("0123456789abcdefghij");
+    file.flush();
+
+    QByteArray trailer;
+    QList<TPartialFile::Part> parts = TPartialFile::createParts(RangeList() << qMakePair(0LL, 2LL) << qMakePair(18LL, 2LL), 20, "text/plain", "B", trailer);
+    QCOMPARE(parts.count(), 2);
+
+    QByteArray expected = "\r\n--B\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-1/20\r\n\r\n01"
+                          "\r\n--B\r\nContent-Type: text/plain\r\nContent-Range: bytes 18-19/20\r\n\r\nij"
+                          "\r\n--B--\r\n";
+    TPartialFile partial(file.fileName(), parts, trailer);
+    QVERIFY(partial.open(QIODevice::ReadOnly));
+    QCOMPARE(partial.size(), (qint64)expected.length());
+
+    // Reads in small pieces across the parts
+    QByteArray data;
+    char buf[7];
+    qint64 len;
+    while ((len = partial.read(buf, sizeof(buf))) > 0) {
+        data.append(buf, len);
+    }
+    QCOMPARE(data, expected);
+}
+
+
+void TestPartialFile::seek()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write("0123456789abcdefghij");
+    file.flush();
+
+    QByteArray trailer;
+    QList<TPartialFile::Part> parts = TPartialFile::createParts(RangeList() << qMakePair(2LL, 3LL) << qMakePair(10LL, 3LL), 20, QByteArray(), "B", trailer);
+    TPartialFile partial(file.fileName(), parts, trailer);
+    QVERIFY(partial.open(QIODevice::ReadOnly));
+
+    QByteArray all = partial.readAll();
+    int pos = all.indexOf("abc");
+    QVERIFY(pos > 0);
+    QVERIFY(partial.seek(pos + 1));
+    QCOMPARE(partial.read(2), QByteArray("bc"));
+    QCOMPARE(partial.readAll(), trailer);
+}
+
+QTEST_MAIN(TestPartialFile)
+#include "main.moc"
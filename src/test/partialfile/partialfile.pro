@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = partialfile
+SOURCES = main.cpp
@@ -0,0 +1,103 @@
+#include <QTest>
+#include "tsessioncache.h"
+
+
+class TestCache : public TSessionCache
+{
+public:
+    TestCache(int capacity, int expirationSecs) : TSessionCache(capacity, expirationSecs), now(1000000) { }
+    qint64 now;
+
+protected:
+    qint64 currentMSecs() const { return now; }
+};
+
+
+class TestSessionCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void findAndStore();
+    void expiration();
+    void eviction();
+    void disabled();
+};
+
+
+void TestSessionCache::findAndStore()
+{
+    TestCache cache(100, 0);
+    TSession session;
+    QVERIFY(!cache.find("abc", session));
+
+    TSession s1("abc");
+    s1.insert("name", "foo");
+    QVERIFY(cache.needsStore(s1));
+    cache.insert(s1);
+    QVERIFY(!cache.needsStore(s1));
+
+    QVERIFY(cache.find("abc", session));
+    QCOMPARE(session.id(), QByteArray("abc"));
+    QCOMPARE(session.value("name").toString(), QString("foo"));
+
+    // Modified
+    session.insert("name", "bar");
+    QVERIFY(cache.needsStore(session));
+
+    cache.remove("abc");
+    QVERIFY(!cache.find("abc", session));
+    QCOMPARE(cache.count(), 0);
+}
+
+
+void TestSessionCache::expiration()
+{
+    TestCache cache(100, 60);
+    TSession s1("abc");
+    s1.insert("name", "foo");
+    cache.insert(s1);
+
+    TSession session;
+    cache.now += 29999;
+    QVERIFY(!cache.needsStore(s1));
+    cache.now += 1;
+    QVERIFY(cache.needsStore(s1));  // refreshes the stored one
+    QVERIFY(cache.find("abc", session));
+
+    cache.now += 30000;
+    QVERIFY(!cache.find("abc", session));
+    QCOMPARE(cache.count(), 0);
+}
+
+
+void TestSessionCache::eviction()
+{
+    TestCache cache(TSessionCache::ShardCount * 2, 0);
+    for (int i = 0; i < 1000; ++i) {
+        TSession s(QByteArray::number(i));
+        s.insert("i", i);
+        cache.insert(s);
+    }
+    QVERIFY(cache.count() <= cache.capacity());
+
+    // The most recent one survives
+    TSession session;
+    QVERIFY(cache.find("999", session));
+    QCOMPARE(session.value("i").toInt(), 999);
+    QVERIFY(!cache.find("0", session));
+}
+
+
+void TestSessionCache::disabled()
+{
+    TestCache cache(0, 0);
+    TSession s1("abc");
+    cache.insert(s1);
+    QVERIFY(cache.needsStore(s1));
+
+    TSession session;
+    QVERIFY(!cache.find("abc", session));
+}
+
+QTEST_MAIN(TestSessionCache)
+#include "main.moc"
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = sessioncache
+SOURCES = main.cpp
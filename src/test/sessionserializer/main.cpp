@@ -0,0 +1,172 @@
+#include <QTest>
+#include <QDataStream>
+#include <QDateTime>
+#include "tsessionserializer.h"
+
+
+static QVariantMap typicalSession()
+{
+    QVariantMap map;
+    map.insert("_csrfId", QByteArray("9f86d081884c7d659a2feaa0c55ad015a3bf4f1b"));
+    map.insert("userId", 12345);
+    map.insert("userName", QString::fromUtf8("yamada taro"));
+    map.insert("loggedIn", true);
+    map.insert("lastAccess", QDateTime(QDate(2015, 4, 1), QTime(12, 30, 0)));
+    map.insert("cartItems", QStringList() << "A-100" << "B-200" << "C-300");
+    map.insert("flash_notice", QString("Updated successfully."));
+    map.insert("score", 98.5);
+    map.insert("counter", Q_INT64_C(-123456789012));
+    return map;
+}
+
+
+static QByteArray dataStreamSerialize(const QVariantMap &map)
+{
+    QByteArray ba;
+    QDataStream ds(&ba, QIODevice::WriteOnly);
+    ds << map;
+    return ba;
+}
+
+
+class TestSessionSerializer : public QObject
+{
+    Q_OBJECT
+private slots:
+    void roundTrip();
+    void singleValue();
+    void legacyFormat();
+    void broken();
+    void compareSize();
+    void benchSerialize_data();
+    void benchSerialize();
+    void benchDeserialize_data();
+    void benchDeserialize();
+};
+
+
+void TestSessionSerializer::roundTrip()
+{
+    QVariantMap map = typicalSession();
+    map.insert("empty", QVariant());
+    map.insert("maxUInt", QVariant((qulonglong)Q_UINT64_C(0xffffffffffffffff)));
+    map.insert(QString::fromUtf8("\xe3\x82\xad\xe3\x83\xbc"), QString::fromUtf8("\xe5\x80\xa4"));
+
+    QByteArray data = TSessionSerializer::serialize(map);
+    QVERIFY(TSessionSerializer::isCompactFormat(data));
+
+    QVariantMap res;
+    QVERIFY(TSessionSerializer::deserialize(data, res));
+    QCOMPARE(res, map);
+    QCOMPARE(res.value("userId").type(), QVariant::Int);
+    QCOMPARE(res.value("counter").type(), QVariant::LongLong);
+    QCOMPARE(TSessionSerializer::keys(data), map.keys());
+
+    QVERIFY(TSessionSerializer::deserialize(TSessionSerializer::serialize(QVariantMap()), res));
+    QVERIFY(res.isEmpty());
+}
+
+
+void TestSessionSerializer::singleValue()
+{
+    QByteArray data = TSessionSerializer::serialize(typicalSession());
+    QCOMPARE(TSessionSerializer::value(data, "userName").toString(), QString("yamada taro"));
+    QCOMPARE(TSessionSerializer::value(data, "score").toDouble(), 98.5);
+    QCOMPARE(TSessionSerializer::value(data, "cartItems").toStringList().count(), 3);
+    QCOMPARE(TSessionSerializer::value(data, "none", 7).toInt(), 7);
+}
+
+
+void TestSessionSerializer::legacyFormat()
+{
+    QVariantMap map = typicalSession();
+    QByteArray data = dataStreamSerialize(map);
+    QVERIFY(!TSessionSerializer::isCompactFormat(data));
+
+    QVariantMap res;
+    QVERIFY(TSessionSerializer::deserialize(data, res));
+    QCOMPARE(res, map);
+    QCOMPARE(TSessionSerializer::value(data, "userId").toInt(), 12345);
+}
+
+
+void TestSessionSerializer::broken()
+{
+    QByteArray data = TSessionSerializer::serialize(typicalSession());
+    QVariantMap res;
+    for (int len = 3; len < data.length(); ++len) {
+        QVERIFY(!TSessionSerializer::deserialize(data.left(len), res));
+    }
+}
+
+
+void TestSessionSerializer::compareSize()
+{
+    QVariantMap map = typicalSession();
+    int compact = TSessionSerializer::serialize(map).length();
+    int stream = dataStreamSerialize(map).length();
+    qDebug("compact: %d bytes  QDataStream: %d bytes", compact, stream);
+    QVERIFY(compact < stream);
+}
+
+
+void TestSessionSerializer::benchSerialize_data()
+{
+    QTest::addColumn<bool>("compact");
+    QTest::newRow("TSessionSerializer") << true;
+    QTest::newRow("QDataStream") << false;
+}
+
+
+void TestSessionSerializer::benchSerialize()
+{
+    QFETCH(bool, compact);
+    QVariantMap map = typicalSession();
+
+    if (compact) {
+        QBENCHMARK {
+            TSessionSerializer::serialize(map);
+        }
+    } else {
+        QBENCHMARK {
+            dataStreamSerialize(map);
+        }
+    }
+}
+
+
+void TestSessionSerializer::benchDeserialize_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::newRow("TSessionSerializer") << 0;
+    QTest::newRow("TSessionSerializer value") << 1;
+    QTest::newRow("QDataStream") << 2;
+}
+
+
+void TestSessionSerializer::benchDeserialize()
+{
+    QFETCH(int, mode);
+    QVariantMap map = typicalSession();
+    QByteArray data = (mode == 2) ? dataStreamSerialize(map) : TSessionSerializer::serialize(map);
+
+    if (mode == 0) {
+        QBENCHMARK {
+            QVariantMap res;
+            TSessionSerializer::deserialize(data, res);
+        }
+    } else if (mode == 1) {
+        QBENCHMARK {
+            TSessionSerializer::value(data, "flash_notice");
+        }
+    } else {
+        QBENCHMARK {
+            QVariantMap res;
+            QDataStream ds(data);
+            ds >> res;
+        }
+    }
+}
+
+QTEST_MAIN(TestSessionSerializer)
+#include "main.moc"
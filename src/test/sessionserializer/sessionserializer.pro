@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = sessionserializer
+SOURCES = main.cpp
@@ -0,0 +1,314 @@
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <TWebApplication>
+#include <TSession>
+#include "tsessionsharedmemorystore.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+const int PayloadSize = 480;  // payload bytes of a slab
+
+
+static TSession createSession(const QByteArray &id, const QByteArray &value)
+{
+    TSession session(id);
+    session.insert("value", value);
+    return session;
+}
+
+
+// Named after the web root by FNV-1a
+static QByteArray shmName()
+{
+    quint32 h = 2166136261u;
+    QByteArray path = Tf::app()->webRootPath().toUtf8();
+    for (int i = 0; i < path.length(); ++i) {
+        h ^= (uchar)path[i];
+        h *= 16777619u;
+    }
+    return "/tfsess_" + QByteArray::number(h, 16);
+}
+
+
+static QByteArray findValue(const QByteArray &id)
+{
+    TSessionSharedMemoryStore store;
+    TSession session = store.find(id, QDateTime::currentDateTime().addSecs(-60));
+    return (session.id() == id) ? session.value("value").toByteArray() : QByteArray();
+}
+
+
+class TestSessionSharedMemoryStore : public QObject
+{
+    Q_OBJECT
+private slots:
+    void recreateStale();  // must run first
+    void storeAndFind();
+    void expired();
+    void remove();
+    void garbageCollect();
+    void invalidId();
+    void oversized();
+    void chaining_data();
+    void chaining();
+    void overwrite();
+    void takeOverLock();
+};
+
+
+void TestSessionSharedMemoryStore::recreateStale()
+{
+    // A child process creates the shared memory
+    pid_t pid = ::fork();
+    QVERIFY(pid >= 0);
+    if (pid == 0) {
+        TSessionSharedMemoryStore store;
+        TSession session = createSession("stale", "foo");
+        ::_exit(store.store(session) ? 0 : 1);
+    }
+    int status = -1;
+    QCOMPARE(::waitpid(pid, &status, 0), pid);
+    QCOMPARE(status, 0);
+
+    // Clears the ready flag at the top, as if the creator died before
+    // initializing it
+    int fd = ::shm_open(shmName().constData(), O_RDWR, 0600);
+    QVERIFY(fd >= 0);
+    struct stat before;
+    QCOMPARE(::fstat(fd, &before), 0);
+    void *ptr = ::mmap(0, sizeof(int), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    QVERIFY(ptr != MAP_FAILED);
+    *static_cast<int *>(ptr) = 0;
+    ::munmap(ptr, sizeof(int));
+    ::close(fd);
+
+    // Recreated when attached first in this process
+    QVERIFY(findValue("stale").isEmpty());
+    TSessionSharedMemoryStore store;
+    TSession session = createSession("stale", "bar");
+    QVERIFY(store.store(session));
+    QCOMPARE(findValue("stale"), QByteArray("bar"));
+    QVERIFY(store.remove(QByteArray("stale")));
+
+    fd = ::shm_open(shmName().constData(), O_RDWR, 0600);
+    QVERIFY(fd >= 0);
+    struct stat after;
+    QCOMPARE(::fstat(fd, &after), 0);
+    ::close(fd);
+    QVERIFY(after.st_ino != before.st_ino);
+}
+
+
+void TestSessionSharedMemoryStore::storeAndFind()
+{
+    TSessionSharedMemoryStore store;
+    TSession session = createSession("storeandfind", "foo");
+    QVERIFY(store.store(session));
+    QCOMPARE(findValue("storeandfind"), QByteArray("foo"));
+    QVERIFY(store.find("notfound", QDateTime::currentDateTime().addSecs(-60)).id().isEmpty());
+}
+
+
+void TestSessionSharedMemoryStore::expired()
+{
+    TSessionSharedMemoryStore store;
+    TSession session = createSession("expired", "foo");
+    QVERIFY(store.store(session));
+
+    // Not modified since the time
+    QVERIFY(store.find("expired", QDateTime::currentDateTime().addSecs(10)).id().isEmpty());
+    // Removed when found expired
+    QVERIFY(findValue("expired").isEmpty());
+}
+
+
+void TestSessionSharedMemoryStore::remove()
+{
+    TSessionSharedMemoryStore store;
+    TSession session = createSession("remove", "foo");
+    QVERIFY(store.store(session));
+    QVERIFY(store.remove(QByteArray("remove")));
+    QVERIFY(findValue("remove").isEmpty());
+    QVERIFY(!store.remove(QByteArray("remove")));
+}
+
+
+void TestSessionSharedMemoryStore::garbageCollect()
+{
+    TSessionSharedMemoryStore store;
+    for (int i = 0; i < 10; ++i) {
+        TSession session = createSession("gc" + QByteArray::number(i), QByteArray(i * 200, 'x'));
+        QVERIFY(store.store(session));
+    }
+
+    QVERIFY(store.remove(QDateTime::currentDateTime().addSecs(-60)));
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(findValue("gc" + QByteArray::number(i)), QByteArray(i * 200, 'x'));
+    }
+
+    QVERIFY(store.remove(QDateTime::currentDateTime().addSecs(10)));
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(findValue("gc" + QByteArray::number(i)).isEmpty());
+    }
+}
+
+
+void TestSessionSharedMemoryStore::invalidId()
+{
+    TSessionSharedMemoryStore store;
+    TSession session = createSession(QByteArray(256, 'a'), "foo");
+    QVERIFY(!store.store(session));
+    QVERIFY(findValue(QByteArray(256, 'a')).isEmpty());
+
+    session = createSession(QByteArray(255, 'a'), "foo");
+    QVERIFY(store.store(session));
+    QCOMPARE(findValue(QByteArray(255, 'a')), QByteArray("foo"));
+    QVERIFY(store.remove(QByteArray(255, 'a')));
+}
+
+
+void TestSessionSharedMemoryStore::oversized()
+{
+    // Larger than all the slabs
+    TSessionSharedMemoryStore store;
+    TSession session = createSession("oversized", QByteArray(65 * 1024 * 1024, 'x'));
+    QVERIFY(!store.store(session));
+    QVERIFY(findValue("oversized").isEmpty());
+
+    // The slabs have been given back
+    session = createSession("oversized", QByteArray(32 * 1024 * 1024, 'x'));
+    QVERIFY(store.store(session));
+    QCOMPARE(findValue("oversized").length(), 32 * 1024 * 1024);
+    QVERIFY(store.remove(QByteArray("oversized")));
+}
+
+
+void TestSessionSharedMemoryStore::chaining_data()
+{
+    QTest::addColumn<int>("length");
+
+    // Across the boundaries of the slabs
+    QTest::newRow("1") << 0;
+    QTest::newRow("2") << 1;
+    for (int n = 1; n <= 4; ++n) {
+        for (int d = -64; d <= 64; d += 16) {
+            QTest::newRow(QByteArray::number(n * PayloadSize + d).constData()) << n * PayloadSize + d;
+        }
+    }
+    QTest::newRow("100KB") << 100 * 1024;
+}
+
+
+void TestSessionSharedMemoryStore::chaining()
+{
+    QFETCH(int, length);
+
+    QByteArray value;
+    for (int i = 0; i < length; ++i) {
+        value += (char)('a' + i % 26);
+    }
+
+    TSessionSharedMemoryStore store;
+    TSession session = createSession("chaining", value);
+    QVERIFY(store.store(session));
+    QCOMPARE(findValue("chaining"), value);
+    QVERIFY(store.remove(QByteArray("chaining")));
+}
+
+
+void TestSessionSharedMemoryStore::overwrite()
+{
+    TSessionSharedMemoryStore store;
+    const int lengths[] = { 10, 5000, 100, 20000, 0, 1000 };
+
+    for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); ++i) {
+        QByteArray value(lengths[i], 'a' + i);
+        TSession session = createSession("overwrite", value);
+        QVERIFY(store.store(session));
+        QCOMPARE(findValue("overwrite"), value);
+    }
+
+    // The replaced slabs are released; 200MB in total
+    QByteArray value(1024 * 1024, 'z');
+    for (int i = 0; i < 200; ++i) {
+        value[0] = (char)('a' + i % 26);
+        TSession session = createSession("overwrite", value);
+        QVERIFY(store.store(session));
+    }
+    QCOMPARE(findValue("overwrite"), value);
+    QVERIFY(store.remove(QByteArray("overwrite")));
+}
+
+
+void TestSessionSharedMemoryStore::takeOverLock()
+{
+    // Kills processes storing sessions at random, some of which die
+    // holding a lock
+    for (int round = 0; round < 20; ++round) {
+        pid_t pid = ::fork();
+        QVERIFY(pid >= 0);
+        if (pid == 0) {
+            TSessionSharedMemoryStore store;
+            for (int i = 0; ; ++i) {
+                TSession session = createSession("takeover" + QByteArray::number(i % 16), QByteArray(i % 2000, 'x'));
+                store.store(session);
+                store.remove(QByteArray("takeover" + QByteArray::number((i + 8) % 16)));
+            }
+        }
+
+        ::usleep(1000 + qrand() % 5000);
+        ::kill(pid, SIGKILL);
+        QCOMPARE(::waitpid(pid, 0, 0), pid);
+
+        // Works with the locks left
+        TSessionSharedMemoryStore store;
+        for (int i = 0; i < 16; ++i) {
+            QByteArray id = "takeover" + QByteArray::number(i);
+            QByteArray value(i * 100, 'a' + round);
+            TSession session = createSession(id, value);
+            QVERIFY(store.store(session));
+            QCOMPARE(findValue(id), value);
+        }
+        QVERIFY(store.remove(QDateTime::currentDateTime().addSecs(10)));
+        for (int i = 0; i < 16; ++i) {
+            QVERIFY(findValue("takeover" + QByteArray::number(i)).isEmpty());
+        }
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    QByteArray root = QDir::tempPath().toLocal8Bit() + "/tf_sessionsharedmemorystore_test_" + QByteArray::number(::getpid());
+    QDir().mkpath(root + "/config");
+    QFile ini(root + "/config/application.ini");
+    if (!ini.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return 1;
+    }
+    ini.write("InternalEncoding=UTF-8\n"
+              "HttpOutputEncoding=UTF-8\n"
+              "MultiProcessingModule=thread\n"
+              "Session.StoreType=sharedmemory\n");
+    ini.close();
+
+    int appArgc = 2;
+    char *appArgv[] = { argv[0], root.data(), 0 };
+    TWebApplication app(appArgc, appArgv);
+
+    TestSessionSharedMemoryStore test;
+    int ret = QTest::qExec(&test, argc, argv);
+
+    // Removes the shared memory
+    ::shm_unlink(shmName().constData());
+#if QT_VERSION >= 0x050000
+    QDir(root).removeRecursively();
+#endif
+    return ret;
+}
+
+#include "main.moc"
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = sessionsharedmemorystore
+SOURCES = main.cpp
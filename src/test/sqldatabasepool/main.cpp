@@ -0,0 +1,218 @@
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+#include <QTime>
+#include <TWebApplication>
+#include <TfException>
+#include "tsqldatabasepool.h"
+
+
+/*
+ * Gets a connection, pools it and exits, or waits for one if all
+ * connections are in use
+ */
+class Client : public QThread
+{
+public:
+    Client() : QThread(), acquired(false) { }
+    QString name;
+    volatile bool acquired;
+
+protected:
+    void run()
+    {
+        try {
+            QSqlDatabase db = TSqlDatabasePool::instance()->database(0);
+            name = db.connectionName();
+            acquired = db.isValid();
+            TSqlDatabasePool::instance()->pool(db);
+        } catch (...) {
+            acquired = false;
+        }
+    }
+};
+
+
+class TestSqlDatabasePool : public QObject
+{
+    Q_OBJECT
+private slots:
+    void reuse();
+    void waitTimeout();
+    void waitForRelease();
+    void expiry();
+    void orphanedExpiry();
+    void unconfigured();
+};
+
+
+static TSqlDatabasePool *pool()
+{
+    return TSqlDatabasePool::instance();
+}
+
+
+void TestSqlDatabasePool::reuse()
+{
+    QSqlDatabase db = pool()->database(0);
+    QVERIFY(db.isOpen());
+    QString name = db.connectionName();
+    pool()->pool(db);
+    QVERIFY(!db.isValid());
+
+    TSqlDatabasePool::Statistics before = pool()->statistics(0);
+    QCOMPARE(before.inUse, 0);
+    QCOMPARE(before.idle, 1);
+
+    // Hands out the same connection without opening another
+    db = pool()->database(0);
+    QCOMPARE(db.connectionName(), name);
+    TSqlDatabasePool::Statistics after = pool()->statistics(0);
+    QCOMPARE(after.opened, before.opened);
+    QCOMPARE(after.affinityHits, before.affinityHits + 1);
+    QCOMPARE(after.inUse, 1);
+    pool()->pool(db);
+}
+
+
+void TestSqlDatabasePool::waitTimeout()
+{
+    QSqlDatabase db1 = pool()->database(0);
+    QSqlDatabase db2 = pool()->database(0);
+    QVERIFY(db1.isOpen());
+    QVERIFY(db2.isOpen());
+    QVERIFY(db1.connectionName() != db2.connectionName());
+
+    // All in use; gives up after PoolWaitTimeout
+    quint64 timedOut = pool()->statistics(0).timedOut;
+    QTime time;
+    time.start();
+    bool thrown = false;
+    try {
+        pool()->database(0);
+    } catch (RuntimeException &) {
+        thrown = true;
+    }
+    int elapsed = time.elapsed();
+    QVERIFY(thrown);
+    QVERIFY(elapsed >= 500);
+    QVERIFY(elapsed < 5000);
+    QCOMPARE(pool()->statistics(0).timedOut, timedOut + 1);
+
+    pool()->pool(db1);
+    pool()->pool(db2);
+}
+
+
+void TestSqlDatabasePool::waitForRelease()
+{
+    QSqlDatabase db1 = pool()->database(0);
+    QSqlDatabase db2 = pool()->database(0);
+    QString name = db1.connectionName();
+    quint64 waited = pool()->statistics(0).waited;
+
+    Client client;
+    client.start();
+    QTest::qSleep(100);
+    pool()->pool(db1);
+    QVERIFY(client.wait(5000));
+    QVERIFY(client.acquired);
+    QCOMPARE(client.name, name);
+    QCOMPARE(pool()->statistics(0).waited, waited + 1);
+
+    pool()->pool(db2);
+}
+
+
+void TestSqlDatabasePool::expiry()
+{
+    // Both connections are left idle by this thread
+    QSqlDatabase db1 = pool()->database(0);
+    QSqlDatabase db2 = pool()->database(0);
+    pool()->pool(db1);
+    pool()->pool(db2);
+    quint64 opened = pool()->statistics(0).opened;
+
+    // Closed when this thread gets one after PoolIdleTimeout
+    QTest::qSleep(2100);
+    QSqlDatabase db = pool()->database(0);
+    QVERIFY(db.isOpen());
+    QCOMPARE(pool()->statistics(0).opened, opened + 1);
+    pool()->pool(db);
+}
+
+
+void TestSqlDatabasePool::orphanedExpiry()
+{
+    QSqlDatabase db = pool()->database(0);
+
+    // The other connection is left idle by an exited thread
+    Client client;
+    client.start();
+    QVERIFY(client.wait(5000));
+    QVERIFY(client.acquired);
+    QCOMPARE(pool()->statistics(0).idle, 1);
+
+    // Closed by the timer
+    QTest::qWait(12000);
+    TSqlDatabasePool::Statistics stats = pool()->statistics(0);
+    QCOMPARE(stats.idle, 0);
+    QCOMPARE(stats.inUse, 1);
+
+    pool()->pool(db);
+}
+
+
+void TestSqlDatabasePool::unconfigured()
+{
+    // No connections for the second database; fails without waiting
+    for (int id = 1; id <= 2; ++id) {
+        QTime time;
+        time.start();
+        bool thrown = false;
+        try {
+            pool()->database(id);
+        } catch (RuntimeException &) {
+            thrown = true;
+        }
+        QVERIFY(thrown);
+        QVERIFY(time.elapsed() < 500);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Web root of an application with a SQLite database
+    QByteArray root = QDir::tempPath().toLocal8Bit() + "/tf_sqldatabasepool_test";
+    QDir().mkpath(root + "/config");
+    QDir().mkpath(root + "/db");
+    QFile ini(root + "/config/application.ini");
+    QFile dbini(root + "/config/database.ini");
+    if (!ini.open(QIODevice::WriteOnly | QIODevice::Truncate) || !dbini.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return 1;
+    }
+    ini.write("InternalEncoding=UTF-8\n"
+              "MultiProcessingModule=thread\n"
+              "MPM.thread.MaxThreadsPerAppServer=2\n"
+              "SqlDatabaseSettingsFiles=database.ini unconfigured.ini\n");
+    ini.close();
+    dbini.write("[product]\n"
+                "DriverType=QSQLITE\n"
+                "DatabaseName=db/sqldatabasepool.db\n"
+                "PoolWaitTimeout=500\n"
+                "PoolIdleTimeout=1\n");
+    dbini.close();
+
+    int appArgc = 2;
+    char *appArgv[] = { argv[0], root.data(), 0 };
+    Q_UNUSED(argc);
+    TWebApplication app(appArgc, appArgv);
+    TSqlDatabasePool::instantiate();
+
+    TestSqlDatabasePool obj;
+    return QTest::qExec(&obj, QCoreApplication::arguments().mid(0, 1));
+}
+
+#include "main.moc"
@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = sqldatabasepool
+SOURCES = main.cpp
@@ -0,0 +1,263 @@
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <QSqlQuery>
+#include <TWebApplication>
+#include <TActionThread>
+#include <TSqlORMapper>
+#include "tsqldatabasepool.h"
+#include "../buildtest/blogobject.h"
+
+
+/*
+ * Exposes the statements generated
+ */
+class BlogMapper : public TSqlORMapper<BlogObject>
+{
+public:
+    using TSqlORMapper<BlogObject>::Insert;
+    using TSqlORMapper<BlogObject>::Upsert;
+    using TSqlORMapper<BlogObject>::writeStatement;
+    using TSqlORMapper<BlogObject>::updateStatement;
+    using TSqlORMapper<BlogObject>::columnNames;
+    using TSqlORMapper<BlogObject>::writeEach;
+    using TSqlORMapper<BlogObject>::hasDuplicateKey;
+};
+
+
+/*
+ * Executes the test in this thread, which provides the database
+ */
+class Context : public TActionThread
+{
+public:
+    Context() : TActionThread(0), returnCode(0) { }
+    volatile int returnCode;
+
+protected:
+    void run();
+};
+
+
+class TestSqlORMapper : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void init();
+    void statements();
+    void insertAll();
+    void upsertAll();
+    void upsertDuplicateKey();
+    void updateAll();
+};
+
+
+static BlogObject createBlog(int id, const QString &title, int lockRevision = 1)
+{
+    BlogObject blog;
+    blog.id = id;
+    blog.title = title;
+    blog.body = title + " body";
+    blog.created_at = QDateTime(QDate(2000, 1, 1), QTime(0, 0));
+    blog.lock_revision = lockRevision;
+    return blog;
+}
+
+
+// Rows of id, title, created_at and lock_revision in order of id
+static QList<QStringList> selectRows()
+{
+    QList<QStringList> rows;
+    QSqlQuery query(Tf::currentSqlDatabase(0));
+    query.exec("SELECT id, title, created_at, lock_revision FROM blog ORDER BY id");
+    while (query.next()) {
+        rows << (QStringList() << query.value(0).toString() << query.value(1).toString()
+                 << query.value(2).toString() << query.value(3).toString());
+    }
+    return rows;
+}
+
+
+void TestSqlORMapper::initTestCase()
+{
+    QSqlQuery query(Tf::currentSqlDatabase(0));
+    QVERIFY(query.exec("DROP TABLE IF EXISTS blog"));
+    QVERIFY(query.exec("CREATE TABLE blog (id INTEGER PRIMARY KEY AUTOINCREMENT, title VARCHAR(20), body VARCHAR(200),"
+                       " created_at TIMESTAMP, updated_at TIMESTAMP, lock_revision INTEGER)"));
+}
+
+
+void TestSqlORMapper::init()
+{
+    QSqlQuery query(Tf::currentSqlDatabase(0));
+    QVERIFY(query.exec("DELETE FROM blog"));
+}
+
+
+void TestSqlORMapper::statements()
+{
+    BlogMapper mapper;
+
+    QCOMPARE(mapper.writeStatement(mapper.columnNames(false, true), 2, BlogMapper::Insert),
+             QString("INSERT INTO blog (\"title\", \"body\", \"created_at\", \"updated_at\", \"lock_revision\")"
+                     " VALUES (?, ?, ?, ?, ?), (?, ?, ?, ?, ?)"));
+
+    // Keeps created_at and increments lock_revision
+    QCOMPARE(mapper.writeStatement(mapper.columnNames(true, true), 1, BlogMapper::Upsert),
+             QString("INSERT INTO blog (\"id\", \"title\", \"body\", \"created_at\", \"updated_at\", \"lock_revision\")"
+                     " VALUES (?, ?, ?, ?, ?, ?) ON CONFLICT (\"id\") DO UPDATE SET \"title\"=EXCLUDED.\"title\","
+                     " \"body\"=EXCLUDED.\"body\", \"updated_at\"=EXCLUDED.\"updated_at\","
+                     " \"lock_revision\"=blog.\"lock_revision\"+1"));
+
+    QCOMPARE(mapper.updateStatement(mapper.columnNames(true, false)),
+             QString("UPDATE blog SET \"title\"=?, \"body\"=?, \"updated_at\"=?, \"lock_revision\"=blog.\"lock_revision\"+1"
+                     " WHERE \"id\"=?"));
+}
+
+
+void TestSqlORMapper::insertAll()
+{
+    QList<BlogObject> blogs;
+    for (int i = 0; i < 600; ++i) {  // more than a statement
+        blogs << createBlog(0, QString("t%1").arg(i));
+    }
+
+    TSqlORMapper<BlogObject> mapper;
+    QCOMPARE(mapper.insertAll(blogs), 600);
+
+    QList<QStringList> rows = selectRows();
+    QCOMPARE(rows.count(), 600);
+    QCOMPARE(rows[0][1], QString("t0"));
+    QCOMPARE(rows[599][1], QString("t599"));
+    QCOMPARE(rows[0][3], QString("1"));
+    QVERIFY(!rows[0][2].isEmpty());
+    QVERIFY(!rows[0][2].startsWith("2000"));  // set to the current time
+}
+
+
+void TestSqlORMapper::upsertAll()
+{
+    TSqlORMapper<BlogObject> mapper;
+    QCOMPARE(mapper.insertAll(QList<BlogObject>() << createBlog(0, "a") << createBlog(0, "b")), 2);
+    QList<QStringList> before = selectRows();
+    QCOMPARE(before.count(), 2);
+
+    // Existing rows, with stale created_at and lock_revision, and a new one
+    QList<BlogObject> blogs;
+    blogs << createBlog(before[0][0].toInt(), "a2", 10) << createBlog(before[1][0].toInt(), "b2", 10) << createBlog(0, "c");
+    QCOMPARE(mapper.upsertAll(blogs), 3);
+
+    QList<QStringList> rows = selectRows();
+    QCOMPARE(rows.count(), 3);
+    for (int i = 0; i < 2; ++i) {
+        QCOMPARE(rows[i][0], before[i][0]);
+        QCOMPARE(rows[i][2], before[i][2]);  // created_at kept
+        QCOMPARE(rows[i][3], QString("2"));  // lock_revision incremented
+    }
+    QCOMPARE(rows[0][1], QString("a2"));
+    QCOMPARE(rows[1][1], QString("b2"));
+    QCOMPARE(rows[2][1], QString("c"));
+    QCOMPARE(rows[2][3], QString("1"));
+}
+
+
+void TestSqlORMapper::upsertDuplicateKey()
+{
+    BlogMapper mapper;
+    QCOMPARE(mapper.insertAll(QList<BlogObject>() << createBlog(0, "a")), 1);
+    int id = selectRows()[0][0].toInt();
+
+    // Written in order; the last one of the same key is kept
+    QList<BlogObject> blogs;
+    blogs << createBlog(id, "a2") << createBlog(id + 100, "n1") << createBlog(id, "a3") << createBlog(id + 100, "n2");
+    QVERIFY(mapper.hasDuplicateKey(blogs, 0, blogs.count(), "id"));
+    QVERIFY(!mapper.hasDuplicateKey(blogs, 0, 2, "id"));
+    QCOMPARE(mapper.upsertAll(blogs), 4);
+
+    QList<QStringList> rows = selectRows();
+    QCOMPARE(rows.count(), 2);
+    QCOMPARE(rows[0][1], QString("a3"));
+    QCOMPARE(rows[0][3], QString("3"));
+    QCOMPARE(rows[1][1], QString("n2"));
+    QCOMPARE(rows[1][3], QString("2"));
+
+    // Same by the one-by-one fallback used for PostgreSQL
+    QCOMPARE(mapper.writeEach(blogs, BlogMapper::Upsert), 4);
+    rows = selectRows();
+    QCOMPARE(rows.count(), 2);
+    QCOMPARE(rows[0][1], QString("a3"));
+    QCOMPARE(rows[0][3], QString("5"));
+    QCOMPARE(rows[1][1], QString("n2"));
+    QCOMPARE(rows[1][3], QString("4"));
+}
+
+
+void TestSqlORMapper::updateAll()
+{
+    TSqlORMapper<BlogObject> mapper;
+    QCOMPARE(mapper.insertAll(QList<BlogObject>() << createBlog(0, "a") << createBlog(0, "b")), 2);
+    QList<QStringList> before = selectRows();
+
+    QList<BlogObject> blogs;
+    blogs << createBlog(before[0][0].toInt(), "a2", 10) << createBlog(before[1][0].toInt(), "b2", 10);
+    QCOMPARE(mapper.updateAll(blogs), 2);
+
+    QList<QStringList> rows = selectRows();
+    QCOMPARE(rows.count(), 2);
+    QCOMPARE(rows[0][1], QString("a2"));
+    QCOMPARE(rows[1][1], QString("b2"));
+    for (int i = 0; i < 2; ++i) {
+        QCOMPARE(rows[i][2], before[i][2]);  // created_at kept
+        QCOMPARE(rows[i][3], QString("2"));  // incremented in the row
+    }
+
+    // Same as the upsert
+    QCOMPARE(mapper.upsertAll(blogs), 2);
+    rows = selectRows();
+    QCOMPARE(rows[0][3], QString("3"));
+}
+
+
+void Context::run()
+{
+    TestSqlORMapper obj;
+    returnCode = QTest::qExec(&obj, QCoreApplication::arguments().mid(0, 1));
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Web root of an application with a SQLite database
+    QByteArray root = QDir::tempPath().toLocal8Bit() + "/tf_sqlormapper_test";
+    QDir().mkpath(root + "/config");
+    QDir().mkpath(root + "/db");
+    QFile ini(root + "/config/application.ini");
+    QFile dbini(root + "/config/database.ini");
+    if (!ini.open(QIODevice::WriteOnly | QIODevice::Truncate) || !dbini.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return 1;
+    }
+    ini.write("InternalEncoding=UTF-8\n"
+              "HttpOutputEncoding=UTF-8\n"
+              "MultiProcessingModule=thread\n"
+              "MPM.thread.MaxThreadsPerAppServer=2\n"
+              "SqlDatabaseSettingsFiles=database.ini\n");
+    ini.close();
+    dbini.write("[product]\n"
+                "DriverType=QSQLITE\n"
+                "DatabaseName=db/sqlormapper.db\n");
+    dbini.close();
+
+    int appArgc = 2;
+    char *appArgv[] = { argv[0], root.data(), 0 };
+    Q_UNUSED(argc);
+    TWebApplication app(appArgc, appArgv);
+    TSqlDatabasePool::instantiate();
+
+    Context context;
+    context.start();
+    context.wait();
+    return context.returnCode;
+}
+
+#include "main.moc"
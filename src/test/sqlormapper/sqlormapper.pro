@@ -0,0 +1,4 @@
+include(../test.pri)
+TARGET = sqlormapper
+SOURCES = main.cpp
+HEADERS += ../buildtest/blogobject.h
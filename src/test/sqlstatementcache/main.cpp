@@ -0,0 +1,108 @@
+#include <QTest>
+#include <QSqlDatabase>
+#include <TSqlQuery>
+#include "tsqlstatementcache.h"
+
+// Same as MaxStatementsPerConnection in tsqlstatementcache.cpp
+const int MaxStatements = 128;
+
+
+class TestSqlStatementCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void reuse();
+    void holdOverLimit();
+    void leastRecentlyUsed();
+
+private:
+    QSqlDatabase db;
+};
+
+
+static QString statement(int n)
+{
+    return QString("SELECT id + %1 FROM t WHERE id = ?").arg(n);
+}
+
+
+void TestSqlStatementCache::initTestCase()
+{
+    db = QSqlDatabase::addDatabase("QSQLITE", "statementcache");
+    db.setDatabaseName(":memory:");
+    QVERIFY(db.open());
+    QSqlQuery query(db);
+    QVERIFY(query.exec("CREATE TABLE t (id INTEGER PRIMARY KEY)"));
+    QVERIFY(query.exec("INSERT INTO t (id) VALUES (1)"));
+}
+
+
+void TestSqlStatementCache::cleanupTestCase()
+{
+    TSqlStatementCache::clear(db.connectionName());
+    db.close();
+}
+
+
+void TestSqlStatementCache::reuse()
+{
+    QSqlError error;
+    QSharedPointer<TSqlQuery> q1 = TSqlStatementCache::prepare(db, statement(0), &error);
+    QSharedPointer<TSqlQuery> q2 = TSqlStatementCache::prepare(db, statement(0), &error);
+    QVERIFY(q1);
+    QVERIFY(q1 == q2);
+
+    QVERIFY(!TSqlStatementCache::prepare(db, "SELECT FROM", &error));
+    QVERIFY(error.isValid());
+}
+
+
+void TestSqlStatementCache::holdOverLimit()
+{
+    TSqlStatementCache::clear(db.connectionName());
+
+    QSqlError error;
+    QSharedPointer<TSqlQuery> held = TSqlStatementCache::prepare(db, statement(0), &error);
+    QVERIFY(held);
+
+    // Fills the cache past the limit while the query is held
+    for (int i = 1; i <= MaxStatements * 2; ++i) {
+        QVERIFY(TSqlStatementCache::prepare(db, statement(i), &error));
+    }
+
+    held->bind(0, 1);
+    QVERIFY(held->exec());
+    QVERIFY(held->next());
+    QCOMPARE(held->value(0).toInt(), 1);
+    held->finish();
+
+    // Evicted, so prepared again
+    QSharedPointer<TSqlQuery> q = TSqlStatementCache::prepare(db, statement(0), &error);
+    QVERIFY(q);
+    QVERIFY(q.data() != held.data());
+}
+
+
+void TestSqlStatementCache::leastRecentlyUsed()
+{
+    TSqlStatementCache::clear(db.connectionName());
+
+    QSqlError error;
+    QSharedPointer<TSqlQuery> first = TSqlStatementCache::prepare(db, statement(0), &error);
+    QSharedPointer<TSqlQuery> second = TSqlStatementCache::prepare(db, statement(1), &error);
+    for (int i = 2; i < MaxStatements; ++i) {
+        TSqlStatementCache::prepare(db, statement(i), &error);
+    }
+
+    // Uses the first one again, so the second one is the oldest
+    QVERIFY(TSqlStatementCache::prepare(db, statement(0), &error) == first);
+    TSqlStatementCache::prepare(db, statement(MaxStatements), &error);
+
+    QVERIFY(TSqlStatementCache::prepare(db, statement(0), &error) == first);
+    QVERIFY(TSqlStatementCache::prepare(db, statement(1), &error) != second);
+}
+
+QTEST_MAIN(TestSqlStatementCache)
+#include "main.moc"
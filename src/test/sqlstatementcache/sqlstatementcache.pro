@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = sqlstatementcache
+SOURCES = main.cpp
@@ -0,0 +1,220 @@
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <THttpRequestHeader>
+#include "tstaticassetcache.h"
+
+
+class TestCache : public TStaticAssetCache
+{
+public:
+    TestCache(const QString &root, qint64 maxMemory) : TStaticAssetCache(root, maxMemory), now(1000) { }
+    uint now;
+
+protected:
+    uint currentTime() const { return now; }
+    QByteArray mediaType(const QString &suffix) const { return (suffix == "css") ? "text/css" : "application/octet-stream"; }
+};
+
+
+class TestStaticAssetCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void init();
+    void cleanup();
+    void find();
+    void notFound();
+    void encoded();
+    void conditional();
+    void reload();
+    void findCached();
+    void revalidate();
+    void memoryBudget();
+
+private:
+    void writeFile(const QString &name, const QByteArray &data);
+    QString root;
+};
+
+
+void TestStaticAssetCache::init()
+{
+    root = QDir::tempPath() + "/tf_staticassetcache_test/";
+    QDir().mkpath(root + "css");
+}
+
+
+void TestStaticAssetCache::cleanup()
+{
+    QDir dir(root + "css");
+    for (QStringListIterator it(dir.entryList(QDir::Files)); it.hasNext(); ) {
+        dir.remove(it.next());
+    }
+    QDir().rmpath(root + "css");
+}
+
+
+void TestStaticAssetCache::writeFile(const QString &name, const QByteArray &data)
+{
+    QFile file(root + name);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write(data);
+}
+
+
+void TestStaticAssetCache::find()
+{
+    writeFile("css/a.css", "body {}");
+    TestCache cache(root, 1024);
+
+    TStaticAssetCache::AssetPointer asset = cache.find("css/a.css");
+    QVERIFY(asset);
+    QCOMPARE(asset->contentType, QByteArray("text/css"));
+    QCOMPARE(asset->identity.data, QByteArray("body {}"));
+    QCOMPARE(asset->identity.size, (qint64)7);
+    QVERIFY(asset->identity.etag.startsWith('"'));
+    QVERIFY(!asset->lastModifiedString.isEmpty());
+    QCOMPARE(cache.memoryUsage(), (qint64)7);
+
+    // Same entry while valid
+    QCOMPARE(cache.find("css/a.css").data(), asset.data());
+}
+
+
+void TestStaticAssetCache::notFound()
+{
+    writeFile("css/a.css", "body {}");
+    TestCache cache(root, 1024);
+
+    QVERIFY(!cache.find("css/none.css"));
+    QVERIFY(!cache.find("css"));
+    QVERIFY(!cache.find("../tf_staticassetcache_test/css/a.css"));
+    QVERIFY(!cache.find("css/../../a.css"));
+}
+
+
+void TestStaticAssetCache::encoded()
+{
+    writeFile("css/a.css", "body {}");
+    writeFile("css/a.css.gz", "gzipped");
+    TestCache cache(root, 1024);
+
+    TStaticAssetCache::AssetPointer asset = cache.find("css/a.css");
+    QVERIFY(asset);
+    QCOMPARE(asset->encoded.count(), 1);
+    QCOMPARE(asset->content("gzip, deflate").encoding, QByteArray("gzip"));
+    QCOMPARE(asset->content("gzip, deflate").data, QByteArray("gzipped"));
+    QVERIFY(asset->content("deflate").encoding.isEmpty());
+    QVERIFY(asset->content("gzip;q=0").encoding.isEmpty());
+    QVERIFY(asset->content("").encoding.isEmpty());
+    QVERIFY(asset->content("gzip").etag != asset->identity.etag);
+}
+
+
+void TestStaticAssetCache::conditional()
+{
+    writeFile("css/a.css", "body {}");
+    TestCache cache(root, 1024);
+    TStaticAssetCache::AssetPointer asset = cache.find("css/a.css");
+    QVERIFY(asset);
+
+    THttpRequestHeader header;
+    QVERIFY(asset->isModified(header, asset->identity));
+
+    header.setRawHeader("If-None-Match", asset->identity.etag);
+    QVERIFY(!asset->isModified(header, asset->identity));
+
+    header.setRawHeader("If-None-Match", "\"other\"");
+    QVERIFY(asset->isModified(header, asset->identity));
+
+    THttpRequestHeader header2;
+    header2.setRawHeader("If-Modified-Since", asset->lastModifiedString);
+    QVERIFY(!asset->isModified(header2, asset->identity));
+}
+
+
+void TestStaticAssetCache::reload()
+{
+    writeFile("css/a.css", "body {}");
+    TestCache cache(root, 1024);
+    TStaticAssetCache::AssetPointer asset = cache.find("css/a.css");
+    QVERIFY(asset);
+
+    writeFile("css/a.css", "body { color: red; }");
+    QCOMPARE(cache.find("css/a.css")->identity.data, QByteArray("body {}"));  // not checked yet
+
+    cache.now++;
+    TStaticAssetCache::AssetPointer reloaded = cache.find("css/a.css");
+    QCOMPARE(reloaded->identity.data, QByteArray("body { color: red; }"));
+    QCOMPARE(cache.memoryUsage(), (qint64)20);
+
+    QFile::remove(root + "css/a.css");
+    cache.now++;
+    QVERIFY(!cache.find("css/a.css"));
+    QCOMPARE(cache.memoryUsage(), (qint64)0);
+}
+
+
+void TestStaticAssetCache::findCached()
+{
+    writeFile("css/a.css", "body {}");
+    TestCache cache(root, 1024);
+
+    QVERIFY(!cache.findCached("css/a.css"));  // not loaded yet
+    TStaticAssetCache::AssetPointer asset = cache.find("css/a.css");
+    QCOMPARE(cache.findCached("css/a.css").data(), asset.data());
+    QVERIFY(!cache.findCached("css/../../a.css"));
+
+    // Served within the staleness window only
+    QFile::remove(root + "css/a.css");
+    cache.now += 2;
+    QCOMPARE(cache.findCached("css/a.css").data(), asset.data());
+    cache.now++;
+    QVERIFY(!cache.findCached("css/a.css"));
+    QVERIFY(!cache.find("css/a.css"));
+    QVERIFY(!cache.findCached("css/a.css"));
+}
+
+
+void TestStaticAssetCache::revalidate()
+{
+    writeFile("css/a.css", "body {}");
+    writeFile("css/b.css", "p {}");
+    TestCache cache(root, 1024);
+    TStaticAssetCache::AssetPointer a = cache.find("css/a.css");
+    QVERIFY(a);
+    QVERIFY(cache.find("css/b.css"));
+
+    // Unchanged asset is kept available without find()
+    cache.now += 10;
+    QVERIFY(!cache.findCached("css/a.css"));
+    cache.revalidate();
+    QCOMPARE(cache.findCached("css/a.css").data(), a.data());
+
+    // Removed asset is discarded
+    QFile::remove(root + "css/b.css");
+    cache.now++;
+    cache.revalidate();
+    QVERIFY(cache.findCached("css/a.css"));
+    QVERIFY(!cache.findCached("css/b.css"));
+    QCOMPARE(cache.memoryUsage(), (qint64)7);
+}
+
+
+void TestStaticAssetCache::memoryBudget()
+{
+    writeFile("css/a.css", "0123456789");
+    writeFile("css/b.css", "0123456789");
+    TestCache cache(root, 15);
+
+    QCOMPARE(cache.find("css/a.css")->identity.data, QByteArray("0123456789"));
+    TStaticAssetCache::AssetPointer b = cache.find("css/b.css");
+    QVERIFY(b);
+    QVERIFY(b->identity.data.isNull());  // sent from the file
+    QCOMPARE(b->identity.size, (qint64)10);
+    QCOMPARE(cache.memoryUsage(), (qint64)10);
+}
+
+QTEST_MAIN(TestStaticAssetCache)
+#include "main.moc"
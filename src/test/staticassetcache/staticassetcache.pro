@@ -0,0 +1,3 @@
+include(../test.pri)
+TARGET = staticassetcache
+SOURCES = main.cpp
@@ -3,3 +3,6 @@ SUBDIRS  = htmlescape httpheader hmac htmlparser
 SUBDIRS += mailmessage  multipartformdata  smtpmailer viewhelper paginator
 SUBDIRS += fieldnametovariablename rand urlrouter urlrouter urlrouter2
 SUBDIRS += sharedmemorylogstream buildtest
+SUBDIRS += atomicqueue dispatcher sessioncache sessionserializer criteriaconverter staticassetcache httpcompressor partialfile chunkedresponse sqlormapper sqlstatementcache sqldatabasepool controllerpool
+unix:!macx:SUBDIRS += epollwakeup actionworkerpool
+unix:SUBDIRS += sessionsharedmemorystore
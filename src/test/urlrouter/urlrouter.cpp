@@ -1,8 +1,129 @@
 #include <QTest>
 #include <QDebug>
+#include <QHash>
+#include <THttpUtility>
 #include "../../turlroute.h"
 
 
+/*
+ * Linear scan of the routes, which is how findRouting() matched them
+ * before they were compiled into the trie. Used as the oracle.
+ */
+class LinearUrlRoute
+{
+public:
+    bool addRouteFromString(const QString &line);
+    TRouting findRouting(Tf::HttpMethod method, const QStringList &components) const;
+    void clear() { routes.clear(); }
+
+private:
+    QList<TRoute> routes;
+};
+
+
+bool LinearUrlRoute::addRouteFromString(const QString &line)
+{
+    QStringList items = line.simplified().split(' ');
+    if (items.count() != 3) {
+        return false;
+    }
+
+    QString path = THttpUtility::trimmedQuotes(items[1]);
+    QString dest = THttpUtility::trimmedQuotes(items[2]);
+    if (path.contains(":params") && !path.endsWith(":params")) {
+        return false;
+    }
+
+    static QHash<QString, int> directives;
+    if (directives.isEmpty()) {
+        directives.insert("match", TRoute::Match);
+        directives.insert("get", TRoute::Get);
+        directives.insert("post", TRoute::Post);
+        directives.insert("put", TRoute::Put);
+        directives.insert("patch", TRoute::Patch);
+        directives.insert("delete", TRoute::Delete);
+        directives.insert("trace", TRoute::Trace);
+        directives.insert("connect", TRoute::Connect);
+    }
+
+    TRoute rt;
+    rt.method = directives.value(items[0].toLower(), TRoute::Invalid);
+    if (rt.method == TRoute::Invalid) {
+        return false;
+    }
+
+    rt.componentList = TUrlRoute::splitPath(path);
+    rt.hasVariableParams = rt.componentList.contains(":params");
+    for (int i = 0; i < rt.componentList.count(); ++i) {
+        const QString &c = rt.componentList[i];
+        if (c.startsWith(":")) {
+            if (c != ":param" && c != ":params") {
+                return false;
+            }
+        } else {
+            rt.keywordIndexes << i;
+        }
+    }
+
+    QStringList list = dest.split('#');
+    if (list.count() != 2) {
+        return false;
+    }
+    rt.controller = list[0].toLower().toLatin1() + "controller";
+    rt.action = list[1].toLatin1();
+    routes << rt;
+    return true;
+}
+
+
+TRouting LinearUrlRoute::findRouting(Tf::HttpMethod method, const QStringList &components) const
+{
+    bool denied = false;
+    for (QListIterator<TRoute> i(routes); i.hasNext(); ) {
+        const TRoute &rt = i.next();
+
+        // Too long or short?
+        if (rt.hasVariableParams) {
+            if (components.length() < rt.componentList.length() - 1) {
+                continue;
+            }
+        } else {
+            if (components.length() != rt.componentList.length()) {
+                continue;
+            }
+        }
+
+        bool matched = true;
+        for (QListIterator<int> it(rt.keywordIndexes); it.hasNext(); ) {
+            int idx = it.next();
+            if (components.value(idx) != rt.componentList[idx]) {
+                matched = false;
+                break;
+            }
+        }
+        if (!matched) {
+            continue;
+        }
+
+        denied = true;
+        if (rt.method == TRoute::Match || rt.method == method) {
+            QStringList params = components;
+            if (params.count() == 1 && params[0].isEmpty()) {  // means path="/"
+                params.clear();
+            } else {
+                QListIterator<int> it(rt.keywordIndexes);
+                it.toBack();
+                while (it.hasPrevious()) {
+                    params.removeAt(it.previous());
+                }
+            }
+            return TRouting(rt.controller, rt.action, params);
+        }
+    }
+    return (denied) ? TRouting("", "") : TRouting();
+}
+
+
 class TestUrlRouter : public QObject, public TUrlRoute
 {
     Q_OBJECT
@@ -36,6 +157,15 @@ private slots:
 
     void should_not_create_route_if_destination_empty_and_route_does_not_accept_controller_and_action();
     void should_not_create_route_if_bad_param();
+    void should_route_raw_path_same_as_split_path_data();
+    void should_route_raw_path_same_as_split_path();
+    void should_route_first_matching_route();
+    void benchmark_find_routing_data();
+    void benchmark_find_routing();
+
+private:
+    void addRoute(const QString &line);
+    LinearUrlRoute linear;
     // void should_not_create_route_if_it_does_not_accept_action_parameter_and_no_default_is_given();
     // void should_not_create_route_if_it_accepts_controller_but_not_action_and_no_default_given();
     // void should_create_route_if_it_accepts_controller_but_not_action_but_default_given();
@@ -55,6 +185,14 @@ private slots:
 void TestUrlRouter::init()
 {
     clear();
+    linear.clear();
+}
+
+// Adds the route to both the trie and the oracle
+void TestUrlRouter::addRoute(const QString &line)
+{
+    QVERIFY(addRouteFromString(line));
+    QVERIFY(linear.addRouteFromString(line));
 }
 
 void TestUrlRouter::cleanup()
@@ -314,6 +452,134 @@ void TestUrlRouter::should_not_create_route_if_bad_param()
     QCOMPARE(result, false);
 }
 
+void TestUrlRouter::should_route_raw_path_same_as_split_path_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<int>("method");
+    QTest::addColumn<bool>("found");
+    QTest::addColumn<QString>("action");  // empty if denied
+    QTest::addColumn<QStringList>("params");
+
+    QTest::newRow("1") << "/" << (int)Tf::Get << true << "index" << QStringList();
+    QTest::newRow("2") << "/foo/p1/bar/" << (int)Tf::Get << true << "bar" << (QStringList() << "p1");
+    QTest::newRow("3") << "/foo/p%201/baz/p+2/p3" << (int)Tf::Get << true << "baz" << (QStringList() << "p 1" << "p 2" << "p3");
+    QTest::newRow("4") << "/foo//bar" << (int)Tf::Get << true << "bar" << (QStringList() << "");
+    QTest::newRow("5") << "/fo%6F/p1/bar" << (int)Tf::Get << true << "bar" << (QStringList() << "p1");
+    QTest::newRow("6") << "/hoge/%E3%81%82" << (int)Tf::Get << true << "hoge" << (QStringList() << QString::fromUtf8("\xE3\x81\x82"));
+    QTest::newRow("7") << "/hoge" << (int)Tf::Get << true << "" << QStringList();
+    QTest::newRow("8") << "//" << (int)Tf::Get << true << "index" << QStringList();
+    QTest::newRow("9") << "/hoge" << (int)Tf::Post << true << "hoge" << QStringList();
+    QTest::newRow("10") << "/foo/p1/baz" << (int)Tf::Get << true << "baz" << (QStringList() << "p1");
+    QTest::newRow("11") << "/foo/p1/qux" << (int)Tf::Get << false << "" << QStringList();
+    QTest::newRow("12") << "/hoge/a/b" << (int)Tf::Get << false << "" << QStringList();
+}
+
+void TestUrlRouter::should_route_raw_path_same_as_split_path()
+{
+    QFETCH(QString, path);
+    QFETCH(int, method);
+    QFETCH(bool, found);
+    QFETCH(QString, action);
+    QFETCH(QStringList, params);
+
+    addRoute("GET  /foo/:param/bar 'dummy#bar'");
+    addRoute("GET  /foo/:param/baz/:params 'dummy#baz'");
+    addRoute("POST /hoge 'dummy#hoge'");
+    addRoute("GET  /hoge/:param 'dummy#hoge'");
+    addRoute("GET  / 'dummy#index'");
+
+    QByteArray raw = path.toLatin1();
+    QStringList components = TUrlRoute::splitPath(THttpUtility::fromUrlEncoding(raw));
+    TRouting expected = linear.findRouting((Tf::HttpMethod)method, components);
+    TRouting r1 = findRouting((Tf::HttpMethod)method, components);
+    TRouting r2 = findRouting((Tf::HttpMethod)method, raw);
+
+    // Oracle against the table
+    QCOMPARE(expected.isEmpty(), !found);
+    QCOMPARE(expected.isDenied(), found && action.isEmpty());
+    QCOMPARE(QString(expected.action), action);
+    QCOMPARE(expected.params, params);
+    if (found && !action.isEmpty()) {
+        QCOMPARE(expected.controller, QByteArray("dummycontroller"));
+    }
+
+    // Trie against the oracle
+    for (int i = 0; i < 2; ++i) {
+        const TRouting &r = (i == 0) ? r1 : r2;
+        QCOMPARE(r.isEmpty(), expected.isEmpty());
+        QCOMPARE(r.isDenied(), expected.isDenied());
+        QCOMPARE(r.controller, expected.controller);
+        QCOMPARE(r.action, expected.action);
+        QCOMPARE(r.params, expected.params);
+    }
+}
+
+void TestUrlRouter::should_route_first_matching_route()
+{
+    addRouteFromString("GET  /foo/:param 'dummy#param'");
+    addRouteFromString("GET  /foo/bar 'dummy#bar'");
+    addRouteFromString("GET  /:params 'dummy#params'");
+
+    TRouting r = findRouting(Tf::Get, QByteArray("/foo/bar"));
+    QCOMPARE(QString(r.action), QString("param"));
+    QCOMPARE(r.params, QStringList() << "bar");
+
+    r = findRouting(Tf::Get, QByteArray("/foo/bar/baz"));
+    QCOMPARE(QString(r.action), QString("params"));
+    QCOMPARE(r.params, QStringList() << "foo" << "bar" << "baz");
+}
+
+void TestUrlRouter::benchmark_find_routing_data()
+{
+    QTest::addColumn<int>("lookup");
+    QTest::newRow("linear scan") << 0;
+    QTest::newRow("trie split path") << 1;
+    QTest::newRow("trie raw path") << 2;
+}
+
+void TestUrlRouter::benchmark_find_routing()
+{
+    QFETCH(int, lookup);
+
+    // Several hundred routes like a large application
+    for (int i = 0; i < 100; ++i) {
+        QString ctrl = QString("resource%1").arg(i);
+        addRoute(QString("GET  /%1 '%1#index'").arg(ctrl));
+        addRoute(QString("GET  /%1/:param '%1#show'").arg(ctrl));
+        addRoute(QString("POST /%1/:param/edit '%1#update'").arg(ctrl));
+        addRoute(QString("GET  /%1/:param/items/:params '%1#items'").arg(ctrl));
+    }
+
+    QList<QByteArray> paths;
+    paths << "/resource0" << "/resource50/123" << "/resource99/123/items/4/5"
+          << "/resource75/123/edit" << "/notfound/path";
+
+    // Same results by all the lookups
+    for (int i = 0; i < paths.count(); ++i) {
+        TRouting expected = linear.findRouting(Tf::Get, TUrlRoute::splitPath(THttpUtility::fromUrlEncoding(paths[i])));
+        TRouting r = findRouting(Tf::Get, paths[i]);
+        QCOMPARE(r.isEmpty(), expected.isEmpty());
+        QCOMPARE(r.action, expected.action);
+        QCOMPARE(r.params, expected.params);
+    }
+
+    QBENCHMARK {
+        for (int i = 0; i < paths.count(); ++i) {
+            switch (lookup) {
+            case 0:
+                linear.findRouting(Tf::Get, TUrlRoute::splitPath(THttpUtility::fromUrlEncoding(paths[i])));
+                break;
+            case 1:
+                findRouting(Tf::Get, TUrlRoute::splitPath(THttpUtility::fromUrlEncoding(paths[i])));
+                break;
+            default:
+                findRouting(Tf::Get, paths[i]);
+                break;
+            }
+        }
+    }
+}
+
 // void TestUrlRouter::should_create_route_if_destination_is_empty_but_controller_and_action_parameters_given()
 // {
 //     QString route = "GET /:controller/:action";
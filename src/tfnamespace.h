@@ -156,6 +156,11 @@ namespace Tf
         LimitRequestBody,
         EnableCsrfProtectionModule,
         EnableHttpMethodOverride,
+        StaticFileCacheSize,
+        HttpCompressionEnabled,
+        HttpCompressionLevel,
+        HttpCompressionMinLength,
+        HttpCompressionMimeTypes,
         SessionName,
         SessionStoreType,
         SessionAutoIdRegeneration,
@@ -165,6 +170,7 @@ namespace Tf
         SessionGcMaxLifeTime,
         SessionSecret,
         SessionCsrfProtectionKey,
+        SessionCacheSize,
         MPMThreadMaxAppServers,
         MPMThreadMaxThreadsPerAppServer,
         MPMPreforkMaxAppServers,
@@ -0,0 +1,24 @@
+#ifndef THTMLESCAPEKERNEL_H
+#define THTMLESCAPEKERNEL_H
+
+#include <TGlobal>
+
+
+class T_CORE_EXPORT THtmlEscapeKernel
+{
+public:
+    enum Type {
+        Scalar = 0,
+        Sse2,
+        Avx2,
+    };
+
+    typedef int (*Utf16FindFunc)(const ushort *s, int from, int len, bool dquot, bool squot);
+    typedef int (*ByteFindFunc)(const uchar *s, int from, int len, bool dquot, bool squot);
+
+    static Utf16FindFunc utf16(Type type);
+    static ByteFindFunc bytes(Type type);
+    static Type best();
+};
+
+#endif // THTMLESCAPEKERNEL_H
@@ -0,0 +1,226 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QStringList>
+#include <QtEndian>
+#include <TAppSettings>
+#include <THttpResponseHeader>
+#include "thttpcompressor.h"
+
+/*!
+  \class THttpCompressor
+  \brief The THttpCompressor class compresses HTTP response bodies with
+  the gzip or deflate content-coding.
+
+  The compression is done by qCompress(), which uses the zlib bundled
+  with Qt, so no other library is needed. It is enabled by
+  HttpCompression.Enabled in application.ini; the level, the minimum
+  length of bodies and the media types to compress are also set there.
+*/
+
+class Crc32Table
+{
+public:
+    quint32 table[256];
+
+    Crc32Table()
+    {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+    }
+};
+
+
+static const Crc32Table &crc32Table()
+{
+    static const Crc32Table table;
+    return table;
+}
+
+
+struct CompressionSettings
+{
+    bool enabled;
+    int level;
+    qint64 minLength;
+    QList<QByteArray> mimeTypes;
+
+    CompressionSettings()
+    {
+        enabled = Tf::appSettings()->value(Tf::HttpCompressionEnabled, false).toBool();
+        level = qBound(-1, Tf::appSettings()->value(Tf::HttpCompressionLevel, -1).toInt(), 9);
+        minLength = Tf::appSettings()->value(Tf::HttpCompressionMinLength, 1024).toLongLong();
+
+        QStringList types = Tf::appSettings()->value(Tf::HttpCompressionMimeTypes).toStringList();
+        if (types.isEmpty()) {
+            types << "text/html" << "text/css" << "text/plain" << "text/xml" << "text/javascript"
+                  << "application/javascript" << "application/json" << "application/xml" << "image/svg+xml";
+        }
+        for (QStringListIterator it(types); it.hasNext(); ) {
+            QByteArray type = it.next().trimmed().toLatin1().toLower();
+            if (!type.isEmpty()) {
+                mimeTypes << type;
+            }
+        }
+    }
+};
+
+
+static const CompressionSettings &settings()
+{
+    static const CompressionSettings compressionSettings;
+    return compressionSettings;
+}
+
+/*!
+  Returns the zlib stream of the \a data compressed with the \a level,
+  which is the body of the deflate content-coding.
+ */
+QByteArray THttpCompressor::deflate(const QByteArray &data, int level)
+{
+    if (data.isEmpty()) {
+        return QByteArray();
+    }
+    // Strips the length prefixed by qCompress()
+    return qCompress(data, level).mid(4);
+}
+
+/*!
+  Returns the \a data compressed with the \a level in the gzip format.
+ */
+QByteArray THttpCompressor::gzip(const QByteArray &data, int level)
+{
+    if (data.isEmpty()) {
+        return QByteArray();
+    }
+
+    // Raw deflate data in the zlib stream: 2 bytes header and 4 bytes Adler-32 trailer
+    const QByteArray zlib = qCompress(data, level);
+    const int rawLength = zlib.length() - 4 - 2 - 4;
+    if (rawLength < 0) {
+        return QByteArray();
+    }
+
+    static const char header[] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+    QByteArray out;
+    out.reserve(sizeof(header) + rawLength + 8);
+    out.append(header, sizeof(header));
+    out.append(zlib.constData() + 6, rawLength);
+
+    quint32 trailer[2];
+    trailer[0] = qToLittleEndian(crc32(data));
+    trailer[1] = qToLittleEndian((quint32)data.length());
+    out.append((const char *)trailer, sizeof(trailer));
+    return out;
+}
+
+/*!
+  Returns the CRC-32 checksum of the \a data.
+ */
+quint32 THttpCompressor::crc32(const QByteArray &data)
+{
+    const quint32 *table = crc32Table().table;
+    const uchar *p = (const uchar *)data.constData();
+    const uchar *end = p + data.length();
+    quint32 crc = 0xFFFFFFFFU;
+
+    while (p < end) {
+        crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+/*!
+  Returns true if the Accept-Encoding header value \a acceptEncoding
+  accepts the content-coding \a encoding; otherwise returns false.
+ */
+bool THttpCompressor::acceptsEncoding(const QByteArray &acceptEncoding, const QByteArray &encoding)
+{
+    int idx = acceptEncoding.indexOf(encoding);
+    if (idx < 0) {
+        return false;
+    }
+
+    // Rejects "gzip;q=0"
+    int end = acceptEncoding.indexOf(',', idx);
+    QByteArray param = acceptEncoding.mid(idx + encoding.length(), (end < 0) ? -1 : end - idx - encoding.length());
+    int q = param.indexOf("q=");
+    return (q < 0 || param.mid(q + 2).trimmed().toDouble() > 0);
+}
+
+/*!
+  Returns the content-coding to use for the Accept-Encoding header value
+  \a acceptEncoding, "gzip" or "deflate", or an empty byte array.
+ */
+QByteArray THttpCompressor::negotiate(const QByteArray &acceptEncoding)
+{
+    if (acceptsEncoding(acceptEncoding, "gzip")) {
+        return "gzip";
+    }
+    if (acceptsEncoding(acceptEncoding, "deflate")) {
+        return "deflate";
+    }
+    return QByteArray();
+}
+
+/*!
+  Returns true if the compression is enabled in the application
+  settings; otherwise returns false.
+ */
+bool THttpCompressor::isEnabled()
+{
+    return settings().enabled;
+}
+
+/*!
+  Returns true if the body of the \a contentType and the \a length is
+  to be compressed; otherwise returns false. Media types compressed
+  already, such as images, are not in the default list.
+ */
+bool THttpCompressor::isCompressible(const QByteArray &contentType, qint64 length)
+{
+    const CompressionSettings &s = settings();
+    if (!s.enabled || length < qMax(s.minLength, Q_INT64_C(1))) {
+        return false;
+    }
+
+    int idx = contentType.indexOf(';');
+    QByteArray type = contentType.left(idx).trimmed().toLower();
+    return s.mimeTypes.contains(type);
+}
+
+/*!
+  Compresses the \a body in the content-coding accepted by
+  \a acceptEncoding if it is compressible, and sets the headers to
+  \a header. Returns true if compressed; otherwise returns false.
+ */
+bool THttpCompressor::compress(THttpResponseHeader &header, QByteArray &body, const QByteArray &acceptEncoding)
+{
+    if (!isCompressible(header.contentType(), body.length()) || header.hasRawHeader("Content-Encoding")) {
+        return false;
+    }
+
+    header.setRawHeader("Vary", "Accept-Encoding");
+    QByteArray encoding = negotiate(acceptEncoding);
+    if (encoding.isEmpty()) {
+        return false;
+    }
+
+    QByteArray compressed = (encoding == "gzip") ? gzip(body, settings().level) : deflate(body, settings().level);
+    if (compressed.isEmpty() || compressed.length() >= body.length()) {
+        return false;
+    }
+
+    body = compressed;
+    header.setRawHeader("Content-Encoding", encoding);
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef THTTPCOMPRESSOR_H
+#define THTTPCOMPRESSOR_H
+
+#include <QByteArray>
+#include <TGlobal>
+
+class THttpResponseHeader;
+
+
+class T_CORE_EXPORT THttpCompressor
+{
+public:
+    static QByteArray gzip(const QByteArray &data, int level = -1);
+    static QByteArray deflate(const QByteArray &data, int level = -1);
+    static QByteArray negotiate(const QByteArray &acceptEncoding);
+    static bool acceptsEncoding(const QByteArray &acceptEncoding, const QByteArray &encoding);
+    static quint32 crc32(const QByteArray &data);
+
+    static bool isEnabled();
+    static bool isCompressible(const QByteArray &contentType, qint64 length);
+    static bool compress(THttpResponseHeader &header, QByteArray &body, const QByteArray &acceptEncoding);
+
+private:
+    THttpCompressor();
+    Q_DISABLE_COPY(THttpCompressor)
+};
+
+#endif // THTTPCOMPRESSOR_H
@@ -100,12 +100,33 @@ THttpRequestHeader::THttpRequestHeader(const THttpRequestHeader &other)
 */
 THttpRequestHeader::THttpRequestHeader(const QByteArray &str)
 {
-    int i = str.indexOf('\n');
-    if (i > 0) {
+    int len = str.indexOf("\r\n\r\n");
+    len = (len < 0) ? str.length() : len + 2;
+    parseRequest(str.constData(), len);
+}
+
+/*!
+  Constructs an HTTP request header by parsing the \a length bytes of
+  \a data, which end with an empty line.
+*/
+THttpRequestHeader::THttpRequestHeader(const char *data, int length)
+{
+    parseRequest(data, qMax(length - 2, 0));
+}
+
+/*!
+  Parses the request line and the header fields in the first \a length
+  bytes of \a data.
+*/
+void THttpRequestHeader::parseRequest(const char *data, int length)
+{
+    const char *eol = (const char *)memchr(data, '\n', length);
+    if (eol && eol > data) {
         // Parses the string
-        parse(str.mid(i + 1));
+        int i = eol - data + 1;
+        parse(data + i, length - i);
 
-        QByteArray line = str.left(i).trimmed();
+        QByteArray line = QByteArray::fromRawData(data, eol - data).trimmed();
         i = line.indexOf(' ');
         if (i > 0) {
             reqMethod = line.left(i);
@@ -30,6 +30,7 @@ public:
     THttpRequestHeader();
     THttpRequestHeader(const THttpRequestHeader &other);
     THttpRequestHeader(const QByteArray &str);
+    THttpRequestHeader(const char *data, int length);
     THttpRequestHeader &operator=(const THttpRequestHeader &other);
 
     const QByteArray &method() const { return reqMethod; }
@@ -40,6 +41,8 @@ public:
     virtual QByteArray toByteArray() const;
 
 private:
+    void parseRequest(const char *data, int length);
+
     QByteArray reqMethod;
     QByteArray reqUri;
 };
@@ -437,14 +437,30 @@ QVariantMap THttpRequest::allParameters() const
 
 
 QList<THttpRequest> THttpRequest::generate(const QByteArray &byteArray, const QHostAddress &address)
+{
+    return generate(byteArray, address, THttpRequestHeader(), 0);
+}
+
+/*!
+  Generates the requests from \a byteArray, whose first header of
+  \a headerLength bytes has already been parsed into \a firstHeader.
+  The remaining pipelined requests are parsed in place.
+*/
+QList<THttpRequest> THttpRequest::generate(const QByteArray &byteArray, const QHostAddress &address, const THttpRequestHeader &firstHeader, int headerLength)
 {
     QList<THttpRequest> reqList;
     int from = 0;
     int headidx;
 
+    if (headerLength > 0) {
+        int contlen = firstHeader.contentLength();
+        reqList << THttpRequest(firstHeader, (contlen > 0) ? byteArray.mid(headerLength, contlen) : QByteArray(), address);
+        from = headerLength + contlen;
+    }
+
     while ((headidx = byteArray.indexOf("\r\n\r\n", from)) > 0) {
         headidx += 4;
-        THttpRequestHeader header(byteArray.mid(from));
+        THttpRequestHeader header(byteArray.constData() + from, headidx - from);
 
         int contlen = header.contentLength();
         if (contlen <= 0) {
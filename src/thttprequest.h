@@ -77,6 +77,7 @@ public:
 #endif
 
     static QList<THttpRequest> generate(const QByteArray &byteArray, const QHostAddress &address);
+    static QList<THttpRequest> generate(const QByteArray &byteArray, const QHostAddress &address, const THttpRequestHeader &firstHeader, int headerLength);
 
 protected:
     QByteArray boundary() const;
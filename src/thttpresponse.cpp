@@ -61,6 +61,19 @@ void THttpResponse::setBody(const QByteArray &body)
     bodyDevice = (tmpByteArray.isNull()) ? 0 : new QBuffer(&tmpByteArray);
 }
 
+/*!
+  Clears the header and the body.
+ */
+void THttpResponse::clear()
+{
+    if (bodyDevice) {
+        delete bodyDevice;
+        bodyDevice = 0;
+    }
+    tmpByteArray.clear();
+    resHeader = THttpResponseHeader();
+}
+
 /*!
   Sets the file to read the content from the given \a filePath.
 */
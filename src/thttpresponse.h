@@ -21,6 +21,7 @@ public:
     bool isBodyNull() const;
     void setBody(const QByteArray &body);
     void setBodyFile(const QString &filePath);
+    void clear();
     QIODevice *bodyIODevice() { return bodyDevice; }
     qint64 bodyLength() const { return (bodyDevice) ? bodyDevice->size() : 0; }
 
@@ -22,10 +22,8 @@ public:
     QList<THttpRequest> read();
     bool canReadRequest() const;
     qint64 write(const THttpHeader *header, QIODevice *body);
-    int idleTime() const;
-
-protected:
     qint64 writeRawData(const char *data, qint64 size);
+    int idleTime() const;
 
 protected slots:
     void readRequest();
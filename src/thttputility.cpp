@@ -10,11 +10,22 @@
 #include <QLocale>
 #include "tsystemglobal.h"
 #include "thttputility.h"
+#include "thtmlescapekernel.h"
 #if defined(Q_OS_WIN)
 #include <qt_windows.h>
 #else
 #include <time.h>
 #endif
+#include <string.h>
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+# define T_HTML_ESCAPE_SSE2
+# include <emmintrin.h>
+// __builtin_cpu_supports() needs the CPU model of libgcc
+# if defined(__x86_64__) && !defined(__APPLE__) && (defined(__clang__) || (__GNUC__ * 100 + __GNUC_MINOR__ >= 409))
+#  define T_HTML_ESCAPE_AVX2
+#  include <immintrin.h>
+# endif
+#endif
 
 #define HTTP_DATE_TIME_FORMAT "ddd, d MMM yyyy hh:mm:ss"
 
@@ -102,6 +113,266 @@ QByteArray THttpUtility::toUrlEncoding(const QString &input, const QByteArray &e
     return input.toUtf8().toPercentEncoding(exclude, "~").replace("%20", "+");
 }
 
+/*
+  HTML escaping kernels
+
+  A kernel returns the index of the first character to be escaped in
+  the UTF-16 or ASCII-compatible (e.g. UTF-8) characters \a s from
+  \a from, or \a len if none. The SIMD ones compare 8, 16 or 32 bytes
+  at a time, so that runs without special characters are skipped fast.
+  The quotes not to be escaped are replaced with '&' in the comparison.
+*/
+template <typename T>
+static int findHtmlSpecialScalar(const T *s, int from, int len, bool dquot, bool squot)
+{
+    for (int i = from; i < len; ++i) {
+        switch (s[i]) {
+        case '&': case '<': case '>':
+            return i;
+        case '"':
+            if (dquot) return i;
+            break;
+        case '\'':
+            if (squot) return i;
+            break;
+        default:
+            break;
+        }
+    }
+    return len;
+}
+
+#ifdef T_HTML_ESCAPE_SSE2
+
+static int findHtmlSpecialSse2(const ushort *s, int from, int len, bool dquot, bool squot)
+{
+    const __m128i amp = _mm_set1_epi16('&');
+    const __m128i lt = _mm_set1_epi16('<');
+    const __m128i gt = _mm_set1_epi16('>');
+    const __m128i dq = _mm_set1_epi16((dquot) ? '"' : '&');
+    const __m128i sq = _mm_set1_epi16((squot) ? '\'' : '&');
+
+    int i = from;
+    for (; i + 8 <= len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi16(v, amp), _mm_cmpeq_epi16(v, lt)),
+                                 _mm_or_si128(_mm_cmpeq_epi16(v, gt), _mm_or_si128(_mm_cmpeq_epi16(v, dq), _mm_cmpeq_epi16(v, sq))));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return i + (__builtin_ctz(mask) >> 1);
+        }
+    }
+    return findHtmlSpecialScalar(s, i, len, dquot, squot);
+}
+
+
+static int findHtmlSpecialSse2(const uchar *s, int from, int len, bool dquot, bool squot)
+{
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i dq = _mm_set1_epi8((dquot) ? '"' : '&');
+    const __m128i sq = _mm_set1_epi8((squot) ? '\'' : '&');
+
+    int i = from;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, lt)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, gt), _mm_or_si128(_mm_cmpeq_epi8(v, dq), _mm_cmpeq_epi8(v, sq))));
+        int mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return findHtmlSpecialScalar(s, i, len, dquot, squot);
+}
+
+#endif // T_HTML_ESCAPE_SSE2
+#ifdef T_HTML_ESCAPE_AVX2
+
+__attribute__((target("avx2")))
+static int findHtmlSpecialAvx2(const ushort *s, int from, int len, bool dquot, bool squot)
+{
+    const __m256i amp = _mm256_set1_epi16('&');
+    const __m256i lt = _mm256_set1_epi16('<');
+    const __m256i gt = _mm256_set1_epi16('>');
+    const __m256i dq = _mm256_set1_epi16((dquot) ? '"' : '&');
+    const __m256i sq = _mm256_set1_epi16((squot) ? '\'' : '&');
+
+    int i = from;
+    for (; i + 16 <= len; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi16(v, amp), _mm256_cmpeq_epi16(v, lt)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi16(v, gt), _mm256_or_si256(_mm256_cmpeq_epi16(v, dq), _mm256_cmpeq_epi16(v, sq))));
+        uint mask = (uint)_mm256_movemask_epi8(m);
+        if (mask) {
+            return i + (__builtin_ctz(mask) >> 1);
+        }
+    }
+    return findHtmlSpecialSse2(s, i, len, dquot, squot);
+}
+
+
+__attribute__((target("avx2")))
+static int findHtmlSpecialAvx2(const uchar *s, int from, int len, bool dquot, bool squot)
+{
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i dq = _mm256_set1_epi8((dquot) ? '"' : '&');
+    const __m256i sq = _mm256_set1_epi8((squot) ? '\'' : '&');
+
+    int i = from;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, amp), _mm256_cmpeq_epi8(v, lt)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, gt), _mm256_or_si256(_mm256_cmpeq_epi8(v, dq), _mm256_cmpeq_epi8(v, sq))));
+        uint mask = (uint)_mm256_movemask_epi8(m);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return findHtmlSpecialSse2(s, i, len, dquot, squot);
+}
+
+#endif // T_HTML_ESCAPE_AVX2
+
+
+/*!
+  \class THtmlEscapeKernel
+  \brief The THtmlEscapeKernel class provides the kernels that find the
+  characters to be escaped in HTML.
+
+  The kernels return the index of the first character to be escaped
+  from \a from, or \a len if none. A kernel of the \a type which is not
+  built in or not supported by the CPU is null.
+*/
+
+THtmlEscapeKernel::Utf16FindFunc THtmlEscapeKernel::utf16(Type type)
+{
+    switch (type) {
+    case Scalar:
+        return &findHtmlSpecialScalar<ushort>;
+#if defined(T_HTML_ESCAPE_SSE2)
+    case Sse2:
+        return &findHtmlSpecialSse2;
+#endif
+#if defined(T_HTML_ESCAPE_AVX2)
+    case Avx2:
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return &findHtmlSpecialAvx2;
+        }
+        return 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+
+THtmlEscapeKernel::ByteFindFunc THtmlEscapeKernel::bytes(Type type)
+{
+    switch (type) {
+    case Scalar:
+        return &findHtmlSpecialScalar<uchar>;
+#if defined(T_HTML_ESCAPE_SSE2)
+    case Sse2:
+        return &findHtmlSpecialSse2;
+#endif
+#if defined(T_HTML_ESCAPE_AVX2)
+    case Avx2:
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return &findHtmlSpecialAvx2;
+        }
+        return 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+/*!
+  Returns the type of the fastest kernel the CPU supports.
+*/
+THtmlEscapeKernel::Type THtmlEscapeKernel::best()
+{
+    static const Type type = (utf16(Avx2)) ? Avx2 : (utf16(Sse2)) ? Sse2 : Scalar;
+    return type;
+}
+
+
+static THtmlEscapeKernel::Utf16FindFunc utf16EscapeKernel()
+{
+    static const THtmlEscapeKernel::Utf16FindFunc find = THtmlEscapeKernel::utf16(THtmlEscapeKernel::best());
+    return find;
+}
+
+
+static THtmlEscapeKernel::ByteFindFunc byteEscapeKernel()
+{
+    static const THtmlEscapeKernel::ByteFindFunc find = THtmlEscapeKernel::bytes(THtmlEscapeKernel::best());
+    return find;
+}
+
+
+static inline const char *htmlEntity(uint c, int &length)
+{
+    switch (c) {
+    case '&':
+        length = 5;
+        return "&amp;";
+    case '<':
+        length = 4;
+        return "&lt;";
+    case '>':
+        length = 4;
+        return "&gt;";
+    case '"':
+        length = 6;
+        return "&quot;";
+    default:  // '\''
+        length = 6;
+        return "&#039;";
+    }
+}
+
+/*
+  Appends the \a len characters \a src escaped to the \a output,
+  in which the first character to be escaped is at \a pos. The output
+  is resized once to the escaped length and written in place.
+*/
+template <typename T, typename String>
+static void writeHtmlEscaped(String &output, const T *src, int len, int pos, bool dquot, bool squot, int (*find)(const T *, int, int, bool, bool))
+{
+    // Escaped length
+    int escapedLength = len;
+    for (int i = pos; i < len; i = find(src, i + 1, len, dquot, squot)) {
+        int n;
+        htmlEntity(src[i], n);
+        escapedLength += n - 1;
+    }
+
+    const int start = output.length();
+    output.resize(start + escapedLength);
+    T *dst = reinterpret_cast<T *>(output.data()) + start;
+
+    int from = 0;
+    for (int i = pos; i < len; i = find(src, from, len, dquot, squot)) {
+        memcpy(dst, src + from, (i - from) * sizeof(T));
+        dst += i - from;
+
+        int n;
+        const char *entity = htmlEntity(src[i], n);
+        for (int j = 0; j < n; ++j) {
+            *dst++ = (uchar)entity[j];
+        }
+        from = i + 1;
+    }
+    memcpy(dst, src + from, (len - from) * sizeof(T));
+}
+
 /*!
   Returns a converted copy of \a input. All applicable characters in \a input
   are converted to HTML entities. The conversions performed are:
@@ -114,37 +385,63 @@ QByteArray THttpUtility::toUrlEncoding(const QString &input, const QByteArray &e
 */
 QString THttpUtility::htmlEscape(const QString &input, Tf::EscapeFlag flag)
 {
-    const QLatin1Char amp('&');
-    const QLatin1Char lt('<');
-    const QLatin1Char gt('>');
-    const QLatin1Char dquot('"');
-    const QLatin1Char squot('\'');
-    const QLatin1String eamp("&amp;");
-    const QLatin1String elt("&lt;");
-    const QLatin1String egt("&gt;");
-    const QString edquot("&quot;");
-    const QString esquot("&#039;");
+    const ushort *src = input.utf16();
+    const int len = input.length();
+    const bool dquot = (flag == Tf::Compatible || flag == Tf::Quotes);
+    const bool squot = (flag == Tf::Quotes);
+
+    const THtmlEscapeKernel::Utf16FindFunc find = utf16EscapeKernel();
+    int pos = find(src, 0, len, dquot, squot);
+    if (pos >= len) {
+        return input;  // nothing to escape, shares the data
+    }
 
     QString escaped;
-    escaped.reserve(int(input.length() * 1.1));
-    for (int i = 0; i < input.length(); ++i) {
-        if (input.at(i) == amp) {
-            escaped += eamp;
-        } else if (input.at(i) == lt) {
-            escaped += elt;
-        } else if (input.at(i) == gt) {
-            escaped += egt;
-        } else if (input.at(i) == dquot) {
-            escaped += (flag == Tf::Compatible || flag == Tf::Quotes) ? edquot : input.at(i);
-        } else if (input.at(i) == squot) {
-            escaped += (flag == Tf::Quotes) ? esquot : input.at(i);
-        } else {
-            escaped += input.at(i);
-        }
-    }
+    writeHtmlEscaped(escaped, src, len, pos, dquot, squot, find);
     return escaped;
 }
 
+/*!
+  Appends a converted copy of \a input to \a output, in the same way as
+  htmlEscape(const QString &, Tf::EscapeFlag) without a temporary string.
+*/
+void THttpUtility::appendHtmlEscaped(QString &output, const QString &input, Tf::EscapeFlag flag)
+{
+    const ushort *src = input.utf16();
+    const int len = input.length();
+    const bool dquot = (flag == Tf::Compatible || flag == Tf::Quotes);
+    const bool squot = (flag == Tf::Quotes);
+
+    const THtmlEscapeKernel::Utf16FindFunc find = utf16EscapeKernel();
+    int pos = find(src, 0, len, dquot, squot);
+    if (pos >= len) {
+        output += input;
+    } else {
+        writeHtmlEscaped(output, src, len, pos, dquot, squot, find);
+    }
+}
+
+/*!
+  Appends a converted copy of \a input to \a output. The \a input must
+  be in an ASCII-compatible encoding such as UTF-8, whose multibyte
+  characters never contain the bytes to be escaped.
+*/
+void THttpUtility::appendHtmlEscaped(QByteArray &output, const QByteArray &input, Tf::EscapeFlag flag)
+{
+    const uchar *src = (const uchar *)input.constData();
+    const int len = input.length();
+    const bool dquot = (flag == Tf::Compatible || flag == Tf::Quotes);
+    const bool squot = (flag == Tf::Quotes);
+
+    const THtmlEscapeKernel::ByteFindFunc find = byteEscapeKernel();
+    int pos = find(src, 0, len, dquot, squot);
+    if (pos >= len) {
+        output += input;
+    } else {
+        writeHtmlEscaped(output, src, len, pos, dquot, squot, find);
+    }
+}
+
 /*!
   This function overloads htmlEscape(const QString &, Tf::EscapeFlag).
 */
@@ -20,6 +20,8 @@ public:
     static QString htmlEscape(const char *input, Tf::EscapeFlag flag = Tf::Quotes);
     static QString htmlEscape(const QByteArray &input, Tf::EscapeFlag flag = Tf::Quotes);
     static QString htmlEscape(const QVariant &input, Tf::EscapeFlag flag = Tf::Quotes);
+    static void appendHtmlEscaped(QString &output, const QString &input, Tf::EscapeFlag flag = Tf::Quotes);
+    static void appendHtmlEscaped(QByteArray &output, const QByteArray &input, Tf::EscapeFlag flag = Tf::Quotes);
     static QString jsonEscape(const QString &input);
     static QString jsonEscape(const char *input);
     static QString jsonEscape(const QByteArray &input);
@@ -205,48 +205,71 @@ QByteArray TInternetMessageHeader::toByteArray() const
     return res;
 }
 
+static inline bool isLws(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');  // same as QByteArray::trimmed()
+}
+
+
+static inline QByteArray trimmed(const char *begin, const char *end)
+{
+    while (begin < end && isLws(*begin)) {
+        ++begin;
+    }
+    while (end > begin && isLws(*(end - 1))) {
+        --end;
+    }
+    return QByteArray(begin, end - begin);
+}
+
 /*!
   Parses the \a header. This function is for internal use only.
 */
 void TInternetMessageHeader::parse(const QByteArray &header)
 {
-    QByteArray field, value;
-    int i = 0;
-    int headerlen;
-
-    value.reserve(255);
+    int headerlen = header.indexOf("\r\n\r\n");
+    headerlen = (headerlen < 0) ? header.length() : headerlen + 2;
+    parse(header.constData(), headerlen);
+}
 
-    headerlen = header.indexOf("\r\n\r\n");
-    if (headerlen < 0)
-        headerlen = header.length();
+/*!
+  Parses the header fields in the first \a length bytes of \a header,
+  which end with the CRLF of the last field, without copying them
+  beforehand. This function is for internal use only.
+*/
+void TInternetMessageHeader::parse(const char *header, int length)
+{
+    const char *end = header + length;
+    const char *p = header;
 
-    while (i < headerlen) {
-        int j = header.indexOf(':', i); // field-name
-        if (j < 0)
+    while (p < end) {
+        const char *colon = (const char *)memchr(p, ':', end - p); // field-name
+        if (!colon)
             break;
 
-        field = header.mid(i, j - i).trimmed();
+        QByteArray field = trimmed(p, colon);
+        QByteArray value;
 
         // any number of LWS is allowed before and after the value
-        ++j;
-        value.resize(0);
+        const char *q = colon + 1;
         do {
-            i = header.indexOf('\n', j);
-            if (i < 0) {
-                i = header.length();
+            const char *eol = (const char *)memchr(q, '\n', end - q);
+            if (!eol) {
+                eol = end;
             }
 
             if (!value.isEmpty())
                 value += ' ';
 
-            value += header.mid(j, i - j).trimmed();
-            j = ++i;
-        } while (i < headerlen && (header.at(i) == ' ' || header.at(i) == '\t'));
+            value += trimmed(q, eol);
+            p = q = eol + 1;
+        } while (p < end && (*p == ' ' || *p == '\t'));
 
         headerPairList << qMakePair(field, value);
     }
 }
 
+
 /*!
   Removes all the entries with the key \a key from the HTTP header.
 */
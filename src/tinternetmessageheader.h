@@ -40,6 +40,7 @@ public:
 
 protected:
     void parse(const QByteArray &header);
+    void parse(const char *header, int length);
 
     typedef QPair<QByteArray, QByteArray> RawHeaderPair;
     typedef QList<RawHeaderPair> RawHeaderPairList;
@@ -16,6 +16,7 @@ class QIODevice;
 class THttpHeader;
 class THttpSendBuffer;
 class TEpollSocket;
+class TReactorThread;
 
 
 class T_CORE_EXPORT TMultiplexingServer : public QThread, public TApplicationServerBase
@@ -33,16 +34,21 @@ public:
 
 protected:
     void run();
+    void eventLoop(int reactorId);
 
 signals:
     bool incomingRequest(TEpollSocket *socket);
 
 private:
     int maxWorkers;
+    int numReactors;
     volatile bool stopped;
     int listenSocket;
 
     TMultiplexingServer(int listeningSocket, QObject *parent = 0);  // Constructor
+
+    friend class TReactorThread;
+    friend class TStaticAssetChecker;
     Q_DISABLE_COPY(TMultiplexingServer)
 };
 
@@ -13,14 +13,65 @@
 #include <TThreadApplicationServer>
 #include <TSystemGlobal>
 #include <TActionWorker>
+#include "tactionworkerpool.h"
 #include "tepoll.h"
 #include "tepollsocket.h"
+#include "tepollhttpsocket.h"
+#include "tstaticassetcache.h"
+
+#ifndef EPOLLEXCLUSIVE
+# define EPOLLEXCLUSIVE (1u << 28)
+#endif
 
 const int SEND_BUF_SIZE = 16 * 1024;
 const int RECV_BUF_SIZE = 128 * 1024;
 static TMultiplexingServer *multiplexingServer = 0;
 
 
+/*
+ * TReactorThread class
+ * Drives an additional event loop of the multiplexing server.
+ */
+class TReactorThread : public QThread
+{
+public:
+    TReactorThread(int id) : QThread(), reactorId(id) { }
+
+protected:
+    void run()
+    {
+        TMultiplexingServer::instance()->eventLoop(reactorId);
+    }
+
+private:
+    int reactorId;
+};
+
+
+/*
+ * TStaticAssetChecker class
+ * Revalidates the cached static assets every second, so that the event
+ * loops serve them without accessing the file system.
+ */
+class TStaticAssetChecker : public QThread
+{
+public:
+    TStaticAssetChecker() : QThread() { }
+
+protected:
+    void run()
+    {
+        TMultiplexingServer *server = TMultiplexingServer::instance();
+        while (!server->stopped) {
+            TStaticAssetCache::instance()->revalidate();
+            for (int i = 0; i < 10 && !server->stopped; ++i) {
+                msleep(100);
+            }
+        }
+    }
+};
+
+
 static void cleanup()
 {
     if (multiplexingServer) {
@@ -83,7 +134,7 @@ static void setNoDeleyOption(int fd)
 
 
 TMultiplexingServer::TMultiplexingServer(int listeningSocket, QObject *parent)
-    : QThread(parent), TApplicationServerBase(), maxWorkers(0), stopped(false),
+    : QThread(parent), TApplicationServerBase(), maxWorkers(0), numReactors(1), stopped(false),
       listenSocket(listeningSocket)
 {
     Q_ASSERT(Tf::app()->multiProcessingModule() == TWebApplication::Hybrid);
@@ -117,29 +168,76 @@ void TMultiplexingServer::run()
     }
     tSystemDebug("MaxWorkers: %d", maxWorkers);
 
-    int appsvrnum = qMax(Tf::app()->maxNumberOfAppServers(), 1);
+    numReactors = Tf::appSettings()->readValue(QLatin1String("MPM.") + mpm + ".EventLoopsPerAppServer", "1").toInt();
+    if (numReactors <= 0) {
+        numReactors = qMax(QThread::idealThreadCount(), 1);
+    }
+    tSystemDebug("EventLoops: %d", numReactors);
+
+    // Settings read by the event loops
+    TEpollHttpSocket::loadSettings();
+
+    // Starts the worker threads
+    TActionWorkerPool::instance()->start(maxWorkers);
 
     setNoDeleyOption(listenSocket);
 
+    // Starts the event loops, each of which owns its epoll instance
+    TEpoll::instantiate(numReactors);
+    QList<TReactorThread *> reactorThreads;
+    for (int i = 1; i < TEpoll::instanceCount(); ++i) {
+        TReactorThread *thread = new TReactorThread(i);
+        reactorThreads << thread;
+        thread->start();
+    }
+
+    TStaticAssetChecker assetChecker;
+    assetChecker.start();
+
+    eventLoop(0);
+    assetChecker.wait();
+
+    for (QListIterator<TReactorThread *> it(reactorThreads); it.hasNext(); ) {
+        TReactorThread *thread = it.next();
+        thread->wait();
+        delete thread;
+    }
+
+    TActionWorker::waitForAllDone(10000);
+    TActionWorkerPool::instance()->stop(10000);
+}
+
+
+void TMultiplexingServer::eventLoop(int reactorId)
+{
+    TEpoll *epoll = TEpoll::instanceAt(reactorId);
+    epoll->attachCurrentThread();
+
+    int appsvrnum = qMax(Tf::app()->maxNumberOfAppServers(), 1);
+
+    // All the event loops accept on the shared listening socket;
+    // a connection is pinned to the loop which accepted it.
+    int lsnEvents = EPOLLIN;
+    if (numReactors > 1) {
+        lsnEvents |= EPOLLEXCLUSIVE;  // wakes up only one of the loops
+    }
+
     TEpollSocket *lsn = TEpollSocket::create(listenSocket, QHostAddress());
-    TEpoll::instance()->addPoll(lsn, EPOLLIN);
+    if (!epoll->addPoll(lsn, lsnEvents) && lsnEvents != EPOLLIN) {
+        epoll->addPoll(lsn, EPOLLIN);  // EPOLLEXCLUSIVE unsupported
+    }
     int numEvents = 0;
 
     for (;;) {
-        if (!numEvents && TActionWorker::workerCount() > 0) {
-            TEpoll::instance()->waitSendData(4);  // mitigation of busy loop
-        }
+        epoll->dispatchSendData();
 
-        TEpoll::instance()->dispatchSendData();
-
-        // Poll Sending/Receiving/Incoming
-        int timeout = (TActionWorker::workerCount() > 0) ? 0 : 100;
-        numEvents = TEpoll::instance()->wait(timeout);
+        // Poll Sending/Receiving/Incoming, and wake-up by send data
+        numEvents = epoll->wait(100);
         if (numEvents < 0)
             break;
 
         TEpollSocket *sock;
-        while ( (sock = TEpoll::instance()->next()) ) {
+        while ( (sock = epoll->next()) ) {
 
             int cltfd = sock->socketDescriptor();
             if (cltfd == listenSocket) {
@@ -148,37 +246,31 @@ void TMultiplexingServer::run()
                     if (Q_UNLIKELY(!acceptedSock))
                         break;
 
-                    TEpoll::instance()->addPoll(acceptedSock, (EPOLLIN | EPOLLOUT | EPOLLET));
+                    epoll->addPoll(acceptedSock, (EPOLLIN | EPOLLOUT | EPOLLET));
 
-                    if (appsvrnum > 1) {
+                    if (appsvrnum > 1 || numReactors > 1) {
                         break;  // Load smoothing
                     }
                 }
                 continue;
 
             } else {
-                if ( TEpoll::instance()->canSend() ) {
+                if ( epoll->canSend() ) {
                     // Send data
-                    int len = TEpoll::instance()->send(sock);
+                    int len = epoll->send(sock);
                     if (Q_UNLIKELY(len < 0)) {
-                        TEpoll::instance()->deletePoll(sock);
+                        epoll->deletePoll(sock);
                         sock->close();
                         sock->deleteLater();
                         continue;
                     }
                 }
 
-                if ( TEpoll::instance()->canReceive() ) {
-                    if (TActionWorker::workerCount() >= maxWorkers) {
-                        // not receive
-                        TEpoll::instance()->modifyPoll(sock, (EPOLLIN | EPOLLOUT | EPOLLET));  // reset
-                        continue;
-                    }
-
+                if ( epoll->canReceive() ) {
                     // Receive data
-                    int len = TEpoll::instance()->recv(sock);
+                    int len = epoll->recv(sock);
                     if (Q_UNLIKELY(len < 0)) {
-                        TEpoll::instance()->deletePoll(sock);
+                        epoll->deletePoll(sock);
                         sock->close();
                         sock->deleteLater();
                         continue;
@@ -188,9 +280,9 @@ void TMultiplexingServer::run()
 #if 0  //TODO: delete here for HTTP 2.0 support
                         // Stop receiving, otherwise the responses is sometimes
                         // placed in the wrong order in case of HTTP-pipeline.
-                        TEpoll::instance()->modifyPoll(sock, (EPOLLOUT | EPOLLET));
+                        epoll->modifyPoll(sock, (EPOLLOUT | EPOLLET));
 #endif
-                        sock->startWorker();
+                        sock->startWorker();  // queues the request to the worker pool
                         //emit incomingRequest(sock);
                     }
                 }
@@ -203,8 +295,10 @@ void TMultiplexingServer::run()
         }
     }
 
-    TEpoll::instance()->releaseAllPollingSockets();
-    TActionWorker::waitForAllDone(10000);
+    epoll->deletePoll(lsn);
+    lsn->setSocketDescpriter(0);  // not close the listening socket
+    delete lsn;
+    epoll->releaseAllPollingSockets();
 }
 
 
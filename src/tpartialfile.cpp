@@ -0,0 +1,316 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <string.h>
+#include <QtAlgorithms>
+#include "tpartialfile.h"
+
+/*!
+  \class TPartialFile
+  \brief The TPartialFile class provides a device that reads the byte
+  ranges of a file as the body of a 206 Partial Content response.
+
+  The device consists of parts, each of which is a header followed by a
+  region of the file, and a trailer. A single range has neither header
+  nor trailer; multiple ranges are given the boundaries and headers of
+  multipart/byteranges by createParts(). Only the regions requested are
+  read from the file. The epoll MPM sends the regions directly from the
+  file by sendfile(), taking them from parts() and trailer().
+*/
+
+static inline bool toNumber(const QByteArray &str, qint64 &value)
+{
+    if (str.isEmpty() || str.length() > 18) {
+        return false;
+    }
+
+    for (int i = 0; i < str.length(); ++i) {
+        if (str[i] < '0' || str[i] > '9') {
+            return false;
+        }
+    }
+    value = str.toLongLong();
+    return true;
+}
+
+
+TPartialFile::TPartialFile(const QString &fileName, const QList<Part> &parts, const QByteArray &trailer, QObject *parent)
+    : QIODevice(parent), file(fileName), partList(parts), trailerData(trailer), partIndex(0), partPos(0)
+{ }
+
+
+TPartialFile::~TPartialFile()
+{
+    close();
+}
+
+
+bool TPartialFile::open(OpenMode mode)
+{
+    if (mode & (WriteOnly | Append)) {
+        setErrorString("TPartialFile is read-only");
+        return false;
+    }
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        setErrorString(file.errorString());
+        return false;
+    }
+
+    partIndex = 0;
+    partPos = 0;
+    return QIODevice::open(mode | Unbuffered);  // seek() relocates the part
+}
+
+
+void TPartialFile::close()
+{
+    if (isOpen()) {
+        QIODevice::close();
+    }
+    file.close();
+}
+
+/*!
+  Returns the number of bytes of all the parts and the trailer.
+ */
+qint64 TPartialFile::size() const
+{
+    qint64 total = trailerData.length();
+    for (QListIterator<Part> it(partList); it.hasNext(); ) {
+        const Part &part = it.next();
+        total += part.header.length() + part.length;
+    }
+    return total;
+}
+
+
+bool TPartialFile::seek(qint64 pos)
+{
+    if (!QIODevice::seek(pos)) {
+        return false;
+    }
+    locate(pos);
+    return true;
+}
+
+
+void TPartialFile::locate(qint64 pos)
+{
+    partIndex = 0;
+    partPos = pos;
+    while (partIndex < partList.count()) {
+        const Part &part = partList[partIndex];
+        qint64 len = part.header.length() + part.length;
+        if (partPos < len) {
+            break;
+        }
+        partPos -= len;
+        ++partIndex;
+    }
+}
+
+
+qint64 TPartialFile::readData(char *data, qint64 maxSize)
+{
+    qint64 total = 0;
+
+    while (total < maxSize && partIndex < partList.count()) {
+        const Part &part = partList[partIndex];
+        const qint64 headerLength = part.header.length();
+        qint64 len;
+
+        if (partPos < headerLength) {
+            len = qMin(headerLength - partPos, maxSize - total);
+            memcpy(data + total, part.header.constData() + partPos, len);
+        } else if (partPos < headerLength + part.length) {
+            qint64 offset = part.offset + partPos - headerLength;
+            if (file.pos() != offset && !file.seek(offset)) {
+                return (total > 0) ? total : -1;
+            }
+
+            len = file.read(data + total, qMin(headerLength + part.length - partPos, maxSize - total));
+            if (len <= 0) {
+                // Truncated file
+                setErrorString(file.errorString());
+                return (total > 0) ? total : -1;
+            }
+        } else {
+            ++partIndex;
+            partPos = 0;
+            continue;
+        }
+
+        partPos += len;
+        total += len;
+    }
+
+    if (total < maxSize && partIndex >= partList.count()) {
+        // Trailer
+        qint64 len = qMin(trailerData.length() - partPos, maxSize - total);
+        if (len > 0) {
+            memcpy(data + total, trailerData.constData() + partPos, len);
+            partPos += len;
+            total += len;
+        }
+    }
+    return total;
+}
+
+
+qint64 TPartialFile::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+/*!
+  Parses the value \a range of a Range header for the content of
+  \a length bytes. Returns false if the value is not valid, in which
+  case the header is to be ignored. Otherwise returns true and sets the
+  satisfiable ones to \a ranges as pairs of offset and count; if
+  \a ranges is empty, none is satisfiable.
+
+  The ranges are sorted, and the overlapping or adjacent ones are
+  merged. If the ranges requested add up to more than the content,
+  e.g. "bytes=0-,0-", the value is not valid, not to send the same
+  bytes repeatedly.
+ */
+bool TPartialFile::parseRange(const QByteArray &range, qint64 length, QList<QPair<qint64, qint64> > &ranges)
+{
+    ranges.clear();
+
+    int eq = range.indexOf('=');
+    if (eq < 0 || range.left(eq).trimmed().toLower() != "bytes") {
+        return false;
+    }
+
+    const QList<QByteArray> specs = range.mid(eq + 1).split(',');
+    if (specs.count() > MaxRangeCount) {
+        return false;
+    }
+
+    bool found = false;
+    qint64 total = 0;
+    for (QListIterator<QByteArray> it(specs); it.hasNext(); ) {
+        const QByteArray spec = it.next().trimmed();
+        if (spec.isEmpty()) {
+            continue;
+        }
+
+        int dash = spec.indexOf('-');
+        if (dash < 0) {
+            return false;
+        }
+
+        const QByteArray firstStr = spec.left(dash).trimmed();
+        const QByteArray lastStr = spec.mid(dash + 1).trimmed();
+        qint64 first = 0;
+        qint64 last = 0;
+
+        if ((!firstStr.isEmpty() && !toNumber(firstStr, first))
+            || (!lastStr.isEmpty() && !toNumber(lastStr, last))) {
+            return false;
+        }
+
+        if (firstStr.isEmpty()) {
+            // Suffix range, the last N bytes
+            if (lastStr.isEmpty()) {
+                return false;
+            }
+            found = true;
+            if (last > 0 && length > 0) {
+                qint64 count = qMin(last, length);
+                ranges << qMakePair(length - count, count);
+                total += count;
+            }
+        } else {
+            if (!lastStr.isEmpty() && last < first) {
+                return false;
+            }
+            found = true;
+            if (first < length) {
+                qint64 end = (lastStr.isEmpty()) ? length - 1 : qMin(last, length - 1);
+                ranges << qMakePair(first, end - first + 1);
+                total += end - first + 1;
+            }
+        }
+
+        if (total > length) {
+            ranges.clear();
+            return false;
+        }
+    }
+
+    // Merges the overlapping or adjacent ranges
+    qSort(ranges);
+    for (int i = 1; i < ranges.count(); ) {
+        QPair<qint64, qint64> &prev = ranges[i - 1];
+        const QPair<qint64, qint64> &cur = ranges[i];
+        if (cur.first <= prev.first + prev.second) {
+            prev.second = qMax(prev.first + prev.second, cur.first + cur.second) - prev.first;
+            ranges.removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+    return found;
+}
+
+/*!
+  Creates the parts of the \a ranges of the content of \a length bytes.
+  For multiple ranges, the parts are those of multipart/byteranges with
+  the \a boundary, each of which has the \a contentType, and the closing
+  boundary is set to \a trailer.
+ */
+QList<TPartialFile::Part> TPartialFile::createParts(const QList<QPair<qint64, qint64> > &ranges, qint64 length, const QByteArray &contentType, const QByteArray &boundary, QByteArray &trailer)
+{
+    QList<Part> parts;
+    trailer.clear();
+
+    for (QListIterator<QPair<qint64, qint64> > it(ranges); it.hasNext(); ) {
+        const QPair<qint64, qint64> &range = it.next();
+        Part part;
+        part.offset = range.first;
+        part.length = range.second;
+
+        if (ranges.count() > 1) {
+            part.header.reserve(boundary.length() + contentType.length() + 80);
+            part.header += "\r\n--";
+            part.header += boundary;
+            part.header += "\r\n";
+            if (!contentType.isEmpty()) {
+                part.header += "Content-Type: ";
+                part.header += contentType;
+                part.header += "\r\n";
+            }
+            part.header += "Content-Range: ";
+            part.header += contentRange(range.first, range.second, length);
+            part.header += "\r\n\r\n";
+        }
+        parts << part;
+    }
+
+    if (ranges.count() > 1) {
+        trailer = "\r\n--" + boundary + "--\r\n";
+    }
+    return parts;
+}
+
+/*!
+  Returns the value of a Content-Range header for the \a count bytes
+  from \a offset of the content of \a length bytes.
+ */
+QByteArray TPartialFile::contentRange(qint64 offset, qint64 count, qint64 length)
+{
+    QByteArray ret = "bytes ";
+    ret += QByteArray::number(offset);
+    ret += '-';
+    ret += QByteArray::number(offset + count - 1);
+    ret += '/';
+    ret += QByteArray::number(length);
+    return ret;
+}
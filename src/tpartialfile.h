@@ -0,0 +1,58 @@
+#ifndef TPARTIALFILE_H
+#define TPARTIALFILE_H
+
+#include <QIODevice>
+#include <QFile>
+#include <QList>
+#include <QPair>
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TPartialFile : public QIODevice
+{
+    Q_OBJECT
+public:
+    struct Part
+    {
+        QByteArray header;  // boundary and headers of multipart/byteranges
+        qint64 offset;
+        qint64 length;
+    };
+
+    TPartialFile(const QString &fileName, const QList<Part> &parts, const QByteArray &trailer, QObject *parent = 0);
+    ~TPartialFile();
+
+    QString fileName() const { return file.fileName(); }
+    const QList<Part> &parts() const { return partList; }
+    const QByteArray &trailer() const { return trailerData; }
+
+    bool open(OpenMode mode);
+    void close();
+    qint64 size() const;
+    bool seek(qint64 pos);
+
+    static bool parseRange(const QByteArray &range, qint64 length, QList<QPair<qint64, qint64> > &ranges);
+    static QList<Part> createParts(const QList<QPair<qint64, qint64> > &ranges, qint64 length, const QByteArray &contentType, const QByteArray &boundary, QByteArray &trailer);
+    static QByteArray contentRange(qint64 offset, qint64 count, qint64 length);
+
+    enum {
+        MaxRangeCount = 64,
+    };
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+    QFile file;
+    QList<Part> partList;
+    QByteArray trailerData;
+    int partIndex;     // current part, or the trailer if equal to the count
+    qint64 partPos;    // position in the header and data of the part
+
+    void locate(qint64 pos);
+
+    Q_DISABLE_COPY(TPartialFile)
+};
+
+#endif // TPARTIALFILE_H
@@ -16,26 +16,80 @@
 #include "tsystemglobal.h"
 
 
-TSendBuffer::TSendBuffer(const QByteArray &header, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger)
-    : arrayBuffer(header), bodyFile(0), fileRemove(autoRemove), accesslogger(logger), startPos(0)
+/*!
+  \class TPendingBytes
+  \brief The TPendingBytes class counts the bytes of the data waiting
+  to be sent. It is shared by the sender and the send buffers, which
+  outlive the sender if it goes away.
+*/
+
+int TPendingBytes::value()
+{
+    QMutexLocker locker(&mutex);
+    return bytes;
+}
+
+
+void TPendingBytes::add(int n)
 {
+    QMutexLocker locker(&mutex);
+    bytes += n;
+    if (n < 0) {
+        drained.wakeAll();
+    }
+}
+
+/*!
+  Waits until the bytes are less than \a limit, or for \a msecs
+  milliseconds. Returns true if they are less than the limit.
+ */
+bool TPendingBytes::waitForLessThan(int limit, int msecs)
+{
+    QMutexLocker locker(&mutex);
+    if (bytes >= limit) {
+        drained.wait(&mutex, msecs);
+    }
+    return bytes < limit;
+}
+
+
+TSendBuffer::TSendBuffer(const QByteArray &header, const QByteArray &body, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger)
+    : segments(), bodyFile(0), fileRemove(autoRemove), zeroCopy(true), fileOffset(0), fileSize(0),
+      accesslogger(logger), startPos(0), pendingCounter(), pendingBytes(0)
+{
+    // Holds the header and body separately not to concatenate them
+    if (!header.isEmpty()) {
+        segments << header;
+    }
+    if (!body.isEmpty()) {
+        segments << body;
+    }
+
     if (file.exists() && file.isFile()) {
         bodyFile = new QFile(file.absoluteFilePath());
         if (!bodyFile->open(QIODevice::ReadOnly)) {
             tSystemWarn("file open failed: %s", qPrintable(file.absoluteFilePath()));
             release();
+        } else {
+            fileSize = bodyFile->size();
         }
     }
 }
 
 
 TSendBuffer::TSendBuffer(const QByteArray &header)
-    : arrayBuffer(header), bodyFile(0), fileRemove(false), accesslogger(), startPos(0)
-{ }
+    : segments(), bodyFile(0), fileRemove(false), zeroCopy(true), fileOffset(0), fileSize(0),
+      accesslogger(), startPos(0), pendingCounter(), pendingBytes(0)
+{
+    if (!header.isEmpty()) {
+        segments << header;
+    }
+}
 
 
 TSendBuffer::TSendBuffer(int statusCode, const QHostAddress &address, const QByteArray &method)
-    : arrayBuffer(), bodyFile(0), fileRemove(false), accesslogger(), startPos(0)
+    : segments(), bodyFile(0), fileRemove(false), zeroCopy(true), fileOffset(0), fileSize(0),
+      accesslogger(), startPos(0), pendingCounter(), pendingBytes(0)
 {
     accesslogger.open();
     accesslogger.setStatusCode(statusCode);
@@ -48,13 +102,79 @@ TSendBuffer::TSendBuffer(int statusCode, const QHostAddress &address, const QByt
     header.setRawHeader("Server", "TreeFrog server");
     header.setCurrentDate();
 
-    arrayBuffer += header.toByteArray();
+    segments << header.toByteArray();
 }
 
 
 TSendBuffer::~TSendBuffer()
 {
     release();
+
+    if (pendingCounter) {
+        pendingCounter->add(-pendingBytes);
+    }
+}
+
+/*!
+  Adds the size of this data to the \a counter until this buffer is
+  deleted, that is, sent or discarded.
+ */
+void TSendBuffer::setPendingCounter(const QSharedPointer<TPendingBytes> &counter)
+{
+    if (pendingCounter) {
+        pendingCounter->add(-pendingBytes);
+    }
+
+    pendingBytes = 0;
+    for (QListIterator<QByteArray> it(segments); it.hasNext(); ) {
+        pendingBytes += it.next().length();
+    }
+
+    pendingCounter = counter;
+    if (pendingCounter) {
+        pendingCounter->add(pendingBytes);
+    }
+}
+
+
+/*!
+  Sends only the \a parts of the body file, each of which is preceded
+  by its header, and then the \a trailer. The regions of the file are
+  still sent by sendfile() in zero-copy mode.
+ */
+void TSendBuffer::setFileParts(const QList<TPartialFile::Part> &parts, const QByteArray &trailer)
+{
+    fileParts = parts;
+    partTrailer = trailer;
+    fileOffset = 0;
+    fileSize = 0;
+    nextFilePart();
+}
+
+/*!
+  Moves on to the next part of the body file if the current one has
+  been sent, appending its header to the segments.
+ */
+void TSendBuffer::nextFilePart()
+{
+    if (!bodyFile || fileOffset < fileSize) {
+        return;
+    }
+
+    if (!fileParts.isEmpty()) {
+        TPartialFile::Part part = fileParts.takeFirst();
+        if (!part.header.isEmpty()) {
+            segments << part.header;
+        }
+        fileOffset = part.offset;
+        fileSize = part.offset + part.length;
+        if (!zeroCopy) {
+            bodyFile->seek(fileOffset);
+        }
+    } else if (!partTrailer.isEmpty()) {
+        segments << partTrailer;
+        partTrailer.clear();
+    }
 }
 
 
@@ -70,35 +190,65 @@ void TSendBuffer::release()
 }
 
 
-void *TSendBuffer::getData(int &size)
+const char *TSendBuffer::getData(int &size)
 {
     if (Q_UNLIKELY(size <= 0)) {
         tSystemError("Invalid data size. [%s:%d]", __FILE__, __LINE__);
         return 0;
     }
 
-    if (startPos < arrayBuffer.length()) {
-        size = qMin(arrayBuffer.length() - startPos, size);
-        return arrayBuffer.data() + startPos;
+    if (!segments.isEmpty()) {
+        const QByteArray &first = segments.first();
+        size = qMin(first.length() - startPos, size);
+        return first.constData() + startPos;
     }
 
-    if (!bodyFile || bodyFile->atEnd()) {
+    // The file body is sent by sendfile() in zero-copy mode
+    if (!bodyFile || zeroCopy || fileOffset >= fileSize) {
         size = 0;
         return 0;
     }
 
-    arrayBuffer.reserve(size);
-    size = bodyFile->read(arrayBuffer.data(), size);
-    if (Q_UNLIKELY(size < 0)) {
-        tSystemError("file read error: %s", qPrintable(bodyFile->fileName()));
-        size = 0;
+    QByteArray chunk;
+    chunk.resize(qMin((qint64)size, fileSize - fileOffset));
+    size = bodyFile->read(chunk.data(), chunk.size());
+    if (Q_UNLIKELY(size <= 0)) {
+        if (size < 0) {
+            tSystemError("file read error: %s", qPrintable(bodyFile->fileName()));
+        } else {
+            tSystemWarn("file truncated: %s", qPrintable(bodyFile->fileName()));
+        }
         release();
+        size = 0;
         return 0;
     }
 
-    arrayBuffer.resize(size);
+    chunk.resize(size);
+    fileOffset += size;
+    segments << chunk;
     startPos = 0;
-    return arrayBuffer.data();
+    return segments.first().constData();
+}
+
+/*!
+  Sets the pointers and sizes of up to \a maxCount in-memory segments
+  not sent yet, for writev(). Returns the number of the segments.
+ */
+int TSendBuffer::getSegments(const char **data, int *sizes, int maxCount)
+{
+    if (segments.isEmpty()) {
+        nextFilePart();
+    }
+
+    int cnt = 0;
+    for (QListIterator<QByteArray> it(segments); it.hasNext() && cnt < maxCount; ) {
+        const QByteArray &seg = it.next();
+        int offset = (cnt == 0) ? startPos : 0;
+        data[cnt] = seg.constData() + offset;
+        sizes[cnt] = seg.length() - offset;
+        ++cnt;
+    }
+    return cnt;
 }
 
 
@@ -108,11 +258,17 @@ bool TSendBuffer::seekData(int pos)
         return false;
     }
 
-    if (startPos + pos >= arrayBuffer.length()) {
-        arrayBuffer.truncate(0);
+    while (pos > 0 && !segments.isEmpty()) {
+        int len = segments.first().length() - startPos;
+        if (pos < len) {
+            startPos += pos;
+            break;
+        }
+
+        // Removes the segment sent
+        segments.removeFirst();
         startPos = 0;
-    } else {
-        startPos += pos;
+        pos -= len;
     }
     return true;
 }
@@ -121,15 +277,60 @@ bool TSendBuffer::seekData(int pos)
 int TSendBuffer::prepend(const char *data, int maxSize)
 {
     if (startPos > 0) {
-        arrayBuffer.remove(0, startPos);
+        segments.first().remove(0, startPos);
     }
-    arrayBuffer.prepend(data, maxSize);
+    segments.prepend(QByteArray(data, maxSize));
     startPos = 0;
     return maxSize;
 }
 
 
+/*!
+  Returns the file descriptor of the body file to be sent by
+  sendfile(), or -1 if not in zero-copy mode.
+ */
+int TSendBuffer::fileDescriptor() const
+{
+    return (bodyFile && zeroCopy) ? bodyFile->handle() : -1;
+}
+
+
+qint64 TSendBuffer::fileBytesToSend() const
+{
+    return (bodyFile && zeroCopy) ? qMax(fileSize - fileOffset, 0LL) : 0;
+}
+
+
+bool TSendBuffer::seekFile(qint64 pos)
+{
+    if (Q_UNLIKELY(pos < 0 || !bodyFile)) {
+        return false;
+    }
+    fileOffset = qMin(fileOffset + pos, fileSize);
+    return true;
+}
+
+/*!
+  Switches to the buffered mode, which reads the rest of the body file
+  into the buffer.
+ */
+void TSendBuffer::disableZeroCopy()
+{
+    if (zeroCopy && bodyFile) {
+        bodyFile->seek(fileOffset);
+    }
+    zeroCopy = false;
+}
+
+
 bool TSendBuffer::atEnd() const
 {
-    return startPos >= arrayBuffer.length() && (!bodyFile || bodyFile->atEnd());
+    if (!segments.isEmpty()) {
+        return false;
+    }
+
+    if (!bodyFile) {
+        return true;
+    }
+    return fileOffset >= fileSize && fileParts.isEmpty() && partTrailer.isEmpty();
 }
@@ -2,8 +2,13 @@
 #define THTTPBUFFER_H
 
 #include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
 #include <TGlobal>
 #include <TAccessLog>
+#include "tpartialfile.h"
 
 class QFile;
 class QFileInfo;
@@ -11,30 +16,63 @@ class QHostAddress;
 class THttpHeader;
 
 
+class T_CORE_EXPORT TPendingBytes
+{
+public:
+    TPendingBytes() : bytes(0) { }
+    int value();
+    void add(int n);
+    bool waitForLessThan(int limit, int msecs);
+
+private:
+    QMutex mutex;
+    QWaitCondition drained;
+    int bytes;
+
+    Q_DISABLE_COPY(TPendingBytes)
+};
+
+
 class T_CORE_EXPORT TSendBuffer
 {
 public:
     ~TSendBuffer();
 
     bool atEnd() const;
-    void *getData(int &size);
+    const char *getData(int &size);
+    int getSegments(const char **data, int *sizes, int maxCount);
     bool seekData(int pos);
     int prepend(const char *data, int maxSize);
+    int fileDescriptor() const;
+    qint64 filePosition() const { return fileOffset; }
+    qint64 fileBytesToSend() const;
+    bool seekFile(qint64 pos);
+    void disableZeroCopy();
     TAccessLogger &accessLogger() { return accesslogger; }
     const TAccessLogger &accessLogger() const { return accesslogger; }
     void release();
+    void setPendingCounter(const QSharedPointer<TPendingBytes> &counter);
+    void setFileParts(const QList<TPartialFile::Part> &parts, const QByteArray &trailer);
 
 private:
-    QByteArray arrayBuffer;
+    QList<QByteArray> segments;  // header, body, ...
     QFile* bodyFile;
     bool fileRemove;
+    bool zeroCopy;
+    qint64 fileOffset;
+    qint64 fileSize;
     TAccessLogger accesslogger;
     int startPos;
+    QSharedPointer<TPendingBytes> pendingCounter;
+    int pendingBytes;
+    QList<TPartialFile::Part> fileParts;  // byte ranges not sent yet
+    QByteArray partTrailer;
 
-    TSendBuffer(const QByteArray &header, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger);
+    TSendBuffer(const QByteArray &header, const QByteArray &body, const QFileInfo &file, bool autoRemove, const TAccessLogger &logger);
     TSendBuffer(const QByteArray &header);
     TSendBuffer(int statusCode, const QHostAddress &address, const QByteArray &method);
     TSendBuffer();
+    void nextFilePart();
 
     friend class TEpollSocket;
     Q_DISABLE_COPY(TSendBuffer)
@@ -0,0 +1,202 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include "tsessioncache.h"
+
+/*!
+  \class TSessionCache
+  \brief The TSessionCache class provides an in-process LRU cache of
+  sessions in front of a session store.
+
+  The cache is split into shards, each guarded by its own mutex, so that
+  worker threads seldom contend for the same lock. An entry remembers
+  when the session was last written to the backing store; it is valid
+  for \a expirationSecs from then, which mirrors the expiration checked
+  by the store itself. needsStore() reports unchanged sessions as clean
+  until half of that period has passed, so that their timestamps in the
+  store are refreshed before they expire there.
+*/
+
+TSessionCache::TSessionCache(int capacity, int expirationSecs)
+    : maxCount(qMax(capacity, 0)),
+      maxCountPerShard((maxCount + ShardCount - 1) / ShardCount),
+      expiration(qMax(expirationSecs, 0) * Q_INT64_C(1000))
+{ }
+
+
+TSessionCache::~TSessionCache()
+{
+    clear();
+}
+
+
+int TSessionCache::count() const
+{
+    int cnt = 0;
+    for (int i = 0; i < ShardCount; ++i) {
+        QMutexLocker locker(&shards[i].mutex);
+        cnt += shards[i].entries.count();
+    }
+    return cnt;
+}
+
+/*!
+  Finds the session with the ID \a id. Returns true and sets it to
+  \a session if a valid entry is found; otherwise returns false.
+ */
+bool TSessionCache::find(const QByteArray &id, TSession &session)
+{
+    if (maxCount <= 0 || id.isEmpty())
+        return false;
+
+    Shard &sh = shard(id);
+    QMutexLocker locker(&sh.mutex);
+    Entry *entry = sh.entries.value(id);
+    if (!entry) {
+        return false;
+    }
+
+    if (expiration > 0 && currentMSecs() - entry->storedAt >= expiration) {
+        // Expired
+        sh.entries.remove(id);
+        sh.unlink(entry);
+        delete entry;
+        return false;
+    }
+
+    sh.unlink(entry);
+    sh.pushFront(entry);
+    session = TSession(id);
+    *static_cast<QVariantMap *>(&session) = entry->data;
+    return true;
+}
+
+/*!
+  Returns true if the \a session differs from the cached one or the
+  stored data needs to be refreshed; otherwise returns false.
+ */
+bool TSessionCache::needsStore(const TSession &session)
+{
+    if (maxCount <= 0)
+        return true;
+
+    Shard &sh = shard(session.id());
+    QMutexLocker locker(&sh.mutex);
+    Entry *entry = sh.entries.value(session.id());
+    if (!entry) {
+        return true;
+    }
+
+    if (expiration > 0 && currentMSecs() - entry->storedAt >= expiration / 2) {
+        return true;
+    }
+    return entry->data != *static_cast<const QVariantMap *>(&session);
+}
+
+/*!
+  Inserts the \a session which has been written to the backing store
+  just now. The least recently used session is discarded if the cache
+  is full.
+ */
+void TSessionCache::insert(const TSession &session)
+{
+    if (maxCount <= 0 || session.id().isEmpty())
+        return;
+
+    Shard &sh = shard(session.id());
+    QMutexLocker locker(&sh.mutex);
+    Entry *entry = sh.entries.value(session.id());
+    if (entry) {
+        sh.unlink(entry);
+    } else {
+        entry = new Entry;
+        entry->id = session.id();
+        sh.entries.insert(entry->id, entry);
+    }
+    entry->data = *static_cast<const QVariantMap *>(&session);
+    entry->storedAt = currentMSecs();
+    sh.pushFront(entry);
+
+    while (sh.entries.count() > maxCountPerShard && sh.tail) {
+        Entry *lru = sh.tail;
+        sh.unlink(lru);
+        sh.entries.remove(lru->id);
+        delete lru;
+    }
+}
+
+
+void TSessionCache::remove(const QByteArray &id)
+{
+    if (maxCount <= 0 || id.isEmpty())
+        return;
+
+    Shard &sh = shard(id);
+    QMutexLocker locker(&sh.mutex);
+    Entry *entry = sh.entries.take(id);
+    if (entry) {
+        sh.unlink(entry);
+        delete entry;
+    }
+}
+
+
+void TSessionCache::clear()
+{
+    for (int i = 0; i < ShardCount; ++i) {
+        QMutexLocker locker(&shards[i].mutex);
+        qDeleteAll(shards[i].entries);
+        shards[i].entries.clear();
+        shards[i].head = 0;
+        shards[i].tail = 0;
+    }
+}
+
+
+qint64 TSessionCache::currentMSecs() const
+{
+#if QT_VERSION >= 0x040700
+    return QDateTime::currentMSecsSinceEpoch();
+#else
+    QDateTime now = QDateTime::currentDateTime();
+    return (qint64)now.toTime_t() * 1000 + now.time().msec();
+#endif
+}
+
+
+void TSessionCache::Shard::unlink(Entry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        head = entry->next;
+    }
+
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        tail = entry->prev;
+    }
+    entry->prev = 0;
+    entry->next = 0;
+}
+
+
+void TSessionCache::Shard::pushFront(Entry *entry)
+{
+    entry->prev = 0;
+    entry->next = head;
+    if (head) {
+        head->prev = entry;
+    }
+    head = entry;
+    if (!tail) {
+        tail = entry;
+    }
+}
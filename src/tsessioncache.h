@@ -0,0 +1,61 @@
+#ifndef TSESSIONCACHE_H
+#define TSESSIONCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <TGlobal>
+#include <TSession>
+
+
+class T_CORE_EXPORT TSessionCache
+{
+public:
+    enum { ShardCount = 16 };
+
+    TSessionCache(int capacity, int expirationSecs);
+    ~TSessionCache();
+
+    int capacity() const { return maxCount; }
+    int count() const;
+    bool find(const QByteArray &id, TSession &session);
+    bool needsStore(const TSession &session);
+    void insert(const TSession &session);
+    void remove(const QByteArray &id);
+    void clear();
+
+protected:
+    virtual qint64 currentMSecs() const;
+
+private:
+    struct Entry
+    {
+        QByteArray id;
+        QVariantMap data;
+        qint64 storedAt;  // last written to the backing store
+        Entry *prev;
+        Entry *next;
+    };
+
+    struct Shard
+    {
+        mutable QMutex mutex;
+        QHash<QByteArray, Entry *> entries;
+        Entry *head;  // most recently used
+        Entry *tail;  // least recently used
+
+        Shard() : mutex(), entries(), head(0), tail(0) { }
+        void unlink(Entry *entry);
+        void pushFront(Entry *entry);
+    };
+
+    Shard &shard(const QByteArray &id) { return shards[qHash(id) % ShardCount]; }
+
+    int maxCount;
+    int maxCountPerShard;
+    qint64 expiration;  // msecs; 0 means never expired
+    Shard shards[ShardCount];
+
+    Q_DISABLE_COPY(TSessionCache)
+};
+
+#endif // TSESSIONCACHE_H
@@ -6,11 +6,53 @@
  */
 
 #include <QByteArray>
-#include <QDataStream>
 #include <QCryptographicHash>
 #include <TAppSettings>
 #include <TSystemGlobal>
 #include "tsessioncookiestore.h"
+#include "tsessionserializer.h"
+
+/*
+  Base64 with the URL and filename safe alphabet and without padding,
+  so that the value can be used in a cookie as it is.
+*/
+static QByteArray toBase64Url(const QByteArray &data)
+{
+    QByteArray ret = data.toBase64();
+    int len = ret.length();
+    while (len > 0 && ret[len - 1] == '=') {
+        --len;
+    }
+    ret.truncate(len);
+
+    for (char *p = ret.data(), *e = p + len; p < e; ++p) {
+        if (*p == '+') {
+            *p = '-';
+        } else if (*p == '/') {
+            *p = '_';
+        }
+    }
+    return ret;
+}
+
+
+static QByteArray fromBase64Url(const QByteArray &data)
+{
+    QByteArray ba = data;
+    for (char *p = ba.data(), *e = p + ba.length(); p < e; ++p) {
+        if (*p == '-') {
+            *p = '+';
+        } else if (*p == '_') {
+            *p = '/';
+        }
+    }
+
+    while (ba.length() % 4) {
+        ba += '=';
+    }
+    return QByteArray::fromBase64(ba);
+}
+
 
 /*!
   \class TSessionCookieStore
@@ -22,12 +64,10 @@ bool TSessionCookieStore::store(TSession &session)
     if (session.isEmpty())
         return true;
 
-    QByteArray ba;
-    QDataStream ds(&ba, QIODevice::WriteOnly);
-    ds << *static_cast<const QVariantMap *>(&session);
+    QByteArray ba = TSessionSerializer::serialize(*static_cast<const QVariantMap *>(&session));
     QByteArray digest = QCryptographicHash::hash(ba + Tf::appSettings()->value(Tf::SessionSecret).toByteArray(),
                                                  QCryptographicHash::Sha1);
-    session.sessionId = ba.toHex() + "_" + digest.toHex();
+    session.sessionId = toBase64Url(ba) + "." + toBase64Url(digest);
     return true;
 }
 
@@ -38,22 +78,31 @@ TSession TSessionCookieStore::find(const QByteArray &id, const QDateTime &)
     if (id.isEmpty())
         return session;
 
-    QList<QByteArray> balst = id.split('_');
-    if (balst.count() == 2 && !balst.value(0).isEmpty() && !balst.value(1).isEmpty()) {
-        QByteArray ba = QByteArray::fromHex(balst.value(0));
+    // "data.digest" in Base64, or "data_digest" in hex in earlier versions
+    QByteArray ba, receivedDigest;
+    int sep = id.indexOf('.');
+    if (sep > 0) {
+        ba = fromBase64Url(id.left(sep));
+        receivedDigest = fromBase64Url(id.mid(sep + 1));
+    } else {
+        QList<QByteArray> balst = id.split('_');
+        if (balst.count() == 2) {
+            ba = QByteArray::fromHex(balst.value(0));
+            receivedDigest = QByteArray::fromHex(balst.value(1));
+        }
+    }
+
+    if (!ba.isEmpty() && !receivedDigest.isEmpty()) {
         QByteArray digest = QCryptographicHash::hash(ba + Tf::appSettings()->value(Tf::SessionSecret).toByteArray(),
                                                      QCryptographicHash::Sha1);
 
-        if (digest != QByteArray::fromHex(balst.value(1))) {
+        if (digest != receivedDigest) {
             tSystemWarn("Recieved a tampered cookie or that of other web application.");
             //throw SecurityException("Tampered with cookie", __FILE__, __LINE__);
             return session;
         }
 
-        QDataStream ds(&ba, QIODevice::ReadOnly);
-        ds >> *static_cast<QVariantMap *>(&session);
-
-        if (ds.status() != QDataStream::Ok) {
+        if (!TSessionSerializer::deserialize(ba, *static_cast<QVariantMap *>(&session))) {
             tSystemError("Unable to load a session from the cookie store.");
             session.clear();
         }
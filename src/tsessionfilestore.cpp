@@ -7,9 +7,9 @@
 
 #include <QFile>
 #include <QDir>
-#include <QDataStream>
 #include <TWebApplication>
 #include "tsessionfilestore.h"
+#include "tsessionserializer.h"
 
 #define SESSION_DIR_NAME "session"
 
@@ -28,9 +28,8 @@ bool TSessionFileStore::store(TSession &session)
     bool res = false;
     QFile file(sessionDirPath() + session.id());
     if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        QDataStream ds(&file);
-        ds << *static_cast<const QVariantMap *>(&session);
-        res = (ds.status() == QDataStream::Ok);
+        QByteArray data = TSessionSerializer::serialize(*static_cast<const QVariantMap *>(&session));
+        res = (file.write(data) == data.length());
     }
     return res;
 }
@@ -44,10 +43,8 @@ TSession TSessionFileStore::find(const QByteArray &id, const QDateTime &modified
         QFile file(fi.filePath());
 
         if (file.open(QIODevice::ReadOnly)) {
-            QDataStream ds(&file);
             TSession result(id);
-            ds >> *static_cast<QVariantMap *>(&result);
-            if (ds.status() == QDataStream::Ok)
+            if (TSessionSerializer::deserialize(file.readAll(), *static_cast<QVariantMap *>(&result)))
                 return result;
         }
     }
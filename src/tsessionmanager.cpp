@@ -13,6 +13,7 @@
 #include <TSessionStore>
 #include "tsystemglobal.h"
 #include "tsessionmanager.h"
+#include "tsessioncache.h"
 #include "tsessionstorefactory.h"
 
 
@@ -40,11 +41,29 @@ static QByteArray createHash()
 
 
 TSessionManager::TSessionManager()
-{ }
+    : cache(0)
+{
+    int size = Tf::appSettings()->value(Tf::SessionCacheSize, 0).toInt();
+    if (size > 0 && storeType() != QLatin1String("cookie")) {
+        // Cached sessions are written again before the store regards them
+        // as expired or garbage
+        int expiration = sessionLifeTime();
+        if (Tf::appSettings()->value(Tf::SessionGcProbability).toInt() > 0) {
+            int gcLifetime = Tf::appSettings()->value(Tf::SessionGcMaxLifeTime).toInt();
+            if (gcLifetime > 0 && (expiration <= 0 || gcLifetime < expiration)) {
+                expiration = gcLifetime;
+            }
+        }
+        cache = new TSessionCache(size, expiration);
+        tSystemDebug("Session cache enabled  size:%d  expiration:%d", size, expiration);
+    }
+}
 
 
 TSessionManager::~TSessionManager()
-{ }
+{
+    delete cache;
+}
 
 
 TSession TSessionManager::findSession(const QByteArray &id)
@@ -56,6 +75,10 @@ TSession TSessionManager::findSession(const QByteArray &id)
 
     TSession session;
     if (!id.isEmpty()) {
+        if (cache && cache->find(id, session)) {
+            return session;
+        }
+
         TSessionStore *store = TSessionStoreFactory::create(storeType());
         if (Q_LIKELY(store)) {
             session = store->find(id, validCreated);
@@ -75,12 +98,25 @@ bool TSessionManager::store(TSession &session)
         return false;
     }
 
+    if (cache && !cache->needsStore(session)) {
+        tSystemDebug("Session not modified: %s", session.id().data());
+        return true;
+    }
+
     bool res = false;
     TSessionStore *store = TSessionStoreFactory::create(storeType());
     if (Q_LIKELY(store)) {
         res = store->store(session);
         delete store;
     }
+
+    if (cache) {
+        if (res) {
+            cache->insert(session);
+        } else {
+            cache->remove(session.id());
+        }
+    }
     return res;
 }
 
@@ -88,6 +124,10 @@ bool TSessionManager::store(TSession &session)
 bool TSessionManager::remove(const QByteArray &id)
 {
     if (!id.isEmpty()) {
+        if (cache) {
+            cache->remove(id);
+        }
+
         TSessionStore *store = TSessionStoreFactory::create(storeType());
         if (Q_LIKELY(store)) {
             bool ret = store->remove(id);
@@ -5,6 +5,8 @@
 #include <TGlobal>
 #include <TSession>
 
+class TSessionCache;
+
 
 class T_CORE_EXPORT TSessionManager
 {
@@ -22,6 +24,8 @@ public:
     static int sessionLifeTime();
 
 private:
+    TSessionCache *cache;
+
     Q_DISABLE_COPY(TSessionManager)
     TSessionManager();
 };
@@ -0,0 +1,377 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QDataStream>
+#include <QtEndian>
+#include <string.h>
+#include "tsessionserializer.h"
+
+/*!
+  \class TSessionSerializer
+  \brief The TSessionSerializer class converts session data to and from
+  a compact binary format.
+
+  The format begins with a header that indexes the keys, types and
+  lengths of the values, followed by the values themselves:
+  \code
+    "TS" version(1)
+    count(varint) indexBytes(varint)
+    { keyLength(varint) key(UTF-8) type(1) valueLength(varint) } * count
+    value * count
+  \endcode
+  Integers are stored as variable-length integers and strings as UTF-8,
+  so a typical session takes about half as many bytes as QDataStream.
+  Because of the index, value() decodes a single value without decoding
+  the others. Data written by QDataStream in earlier versions is still
+  read by deserialize().
+*/
+
+static const char MAGIC[] = { 'T', 'S' };
+static const uchar FORMAT_VERSION = 1;
+static const int HEADER_LENGTH = 3;
+
+
+static inline void writeVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.append((char)value);
+}
+
+
+static inline bool readVarint(const QByteArray &data, int &pos, int end, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7) {
+        uchar c = (uchar)data.constData()[pos++];
+        value |= (quint64)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static inline bool readLength(const QByteArray &data, int &pos, int end, int &length)
+{
+    quint64 val;
+    if (!readVarint(data, pos, end, val) || val > (quint64)data.length()) {
+        return false;
+    }
+    length = (int)val;
+    return true;
+}
+
+
+static inline quint64 zigzag(qint64 value)
+{
+    return ((quint64)value << 1) ^ (quint64)(value >> 63);
+}
+
+
+static inline qint64 unzigzag(quint64 value)
+{
+    return (qint64)(value >> 1) ^ -(qint64)(value & 1);
+}
+
+
+bool TSessionSerializer::isCompactFormat(const QByteArray &data)
+{
+    return data.length() >= HEADER_LENGTH && data[0] == MAGIC[0] && data[1] == MAGIC[1]
+        && (uchar)data[2] == FORMAT_VERSION;
+}
+
+/*!
+  Serializes the \a map into the compact binary format.
+ */
+QByteArray TSessionSerializer::serialize(const QVariantMap &map)
+{
+    QByteArray index;
+    QByteArray values;
+    index.reserve(map.count() * 16);
+    values.reserve(map.count() * 16);
+
+    for (QMapIterator<QString, QVariant> it(map); it.hasNext(); ) {
+        it.next();
+        const QVariant &var = it.value();
+        int start = values.length();
+        int type;
+
+        switch (var.type()) {
+        case QVariant::Invalid:
+            type = Null;
+            break;
+
+        case QVariant::Bool:
+            type = var.toBool() ? True : False;
+            break;
+
+        case QVariant::Int:
+            type = Int;
+            writeVarint(values, zigzag(var.toInt()));
+            break;
+
+        case QVariant::UInt:
+            type = UInt;
+            writeVarint(values, var.toUInt());
+            break;
+
+        case QVariant::LongLong:
+            type = LongLong;
+            writeVarint(values, zigzag(var.toLongLong()));
+            break;
+
+        case QVariant::ULongLong:
+            type = ULongLong;
+            writeVarint(values, var.toULongLong());
+            break;
+
+        case QVariant::Double: {
+            type = Double;
+            double d = var.toDouble();
+            quint64 bits;
+            memcpy(&bits, &d, sizeof(bits));
+            bits = qToLittleEndian(bits);
+            values.append((const char *)&bits, sizeof(bits));
+            break; }
+
+        case QVariant::String:
+            type = String;
+            values += var.toString().toUtf8();
+            break;
+
+        case QVariant::ByteArray:
+            type = ByteArray;
+            values += var.toByteArray();
+            break;
+
+        default: {
+            type = Variant;
+            QByteArray buf;
+            QDataStream ds(&buf, QIODevice::WriteOnly);
+            ds << var;
+            values += buf;
+            break; }
+        }
+
+        QByteArray key = it.key().toUtf8();
+        writeVarint(index, key.length());
+        index += key;
+        index.append((char)type);
+        writeVarint(index, values.length() - start);
+    }
+
+    QByteArray data;
+    data.reserve(HEADER_LENGTH + 10 + index.length() + values.length());
+    data.append(MAGIC, sizeof(MAGIC));
+    data.append((char)FORMAT_VERSION);
+    writeVarint(data, map.count());
+    writeVarint(data, index.length());
+    data += index;
+    data += values;
+    return data;
+}
+
+/*!
+  Deserializes the \a data into the \a map. Data serialized by
+  QDataStream is also accepted. Returns true if successful;
+  otherwise returns false.
+ */
+bool TSessionSerializer::deserialize(const QByteArray &data, QVariantMap &map)
+{
+    map.clear();
+    if (data.isEmpty()) {
+        return true;
+    }
+
+    if (!isCompactFormat(data)) {
+        // Earlier format
+        QDataStream ds(data);
+        ds >> map;
+        return (ds.status() == QDataStream::Ok);
+    }
+
+    QList<Index> index;
+    if (!readIndex(data, index)) {
+        return false;
+    }
+
+    for (QListIterator<Index> it(index); it.hasNext(); ) {
+        const Index &idx = it.next();
+        bool ok;
+        QVariant var = decodeValue(data, idx, &ok);
+        if (!ok) {
+            map.clear();
+            return false;
+        }
+        map.insert(idx.key, var);
+    }
+    return true;
+}
+
+/*!
+  Returns the value for the \a key in the serialized \a data, decoding
+  only that value. If there is no such key, returns \a defaultValue.
+ */
+QVariant TSessionSerializer::value(const QByteArray &data, const QString &key, const QVariant &defaultValue)
+{
+    if (!isCompactFormat(data)) {
+        QVariantMap map;
+        deserialize(data, map);
+        return map.value(key, defaultValue);
+    }
+
+    QList<Index> index;
+    if (readIndex(data, index, &key) && !index.isEmpty()) {
+        bool ok;
+        QVariant var = decodeValue(data, index.last(), &ok);
+        if (ok) {
+            return var;
+        }
+    }
+    return defaultValue;
+}
+
+/*!
+  Returns the keys in the serialized \a data.
+ */
+QStringList TSessionSerializer::keys(const QByteArray &data)
+{
+    QStringList ret;
+    if (!isCompactFormat(data)) {
+        QVariantMap map;
+        deserialize(data, map);
+        return map.keys();
+    }
+
+    QList<Index> index;
+    if (readIndex(data, index)) {
+        for (QListIterator<Index> it(index); it.hasNext(); ) {
+            ret << it.next().key;
+        }
+    }
+    return ret;
+}
+
+/*!
+  Reads the index of the \a data. If \a key is specified, reads until
+  the key is found and returns the index of it in the last element.
+ */
+bool TSessionSerializer::readIndex(const QByteArray &data, QList<Index> &index, const QString *key)
+{
+    const int end = data.length();
+    int pos = HEADER_LENGTH;
+    int count, indexBytes;
+
+    if (!readLength(data, pos, end, count) || !readLength(data, pos, end, indexBytes) || indexBytes > end - pos) {
+        return false;
+    }
+
+    const int indexEnd = pos + indexBytes;
+    int offset = indexEnd;
+    const QByteArray keyUtf8 = (key) ? key->toUtf8() : QByteArray();
+
+    for (int i = 0; i < count; ++i) {
+        Index idx;
+        int keyLength;
+        if (!readLength(data, pos, indexEnd, keyLength) || keyLength > indexEnd - pos - 2) {
+            return false;
+        }
+        const char *keyData = data.constData() + pos;
+        pos += keyLength;
+        idx.type = (uchar)data.constData()[pos++];
+        if (!readLength(data, pos, indexEnd, idx.length) || idx.length > end - offset) {
+            return false;
+        }
+        idx.offset = offset;
+        offset += idx.length;
+
+        if (key) {
+            if (keyLength == keyUtf8.length() && memcmp(keyData, keyUtf8.constData(), keyLength) == 0) {
+                idx.key = *key;
+                index << idx;
+                return true;
+            }
+        } else {
+            idx.key = QString::fromUtf8(keyData, keyLength);
+            index << idx;
+        }
+    }
+    return (key == 0);
+}
+
+
+QVariant TSessionSerializer::decodeValue(const QByteArray &data, const Index &idx, bool *ok)
+{
+    int pos = idx.offset;
+    const int end = idx.offset + idx.length;
+    quint64 val;
+    *ok = true;
+
+    switch (idx.type) {
+    case Null:
+        return QVariant();
+
+    case False:
+        return QVariant(false);
+
+    case True:
+        return QVariant(true);
+
+    case Int:
+        *ok = readVarint(data, pos, end, val);
+        return QVariant((int)unzigzag(val));
+
+    case UInt:
+        *ok = readVarint(data, pos, end, val);
+        return QVariant((uint)val);
+
+    case LongLong:
+        *ok = readVarint(data, pos, end, val);
+        return QVariant((qlonglong)unzigzag(val));
+
+    case ULongLong:
+        *ok = readVarint(data, pos, end, val);
+        return QVariant((qulonglong)val);
+
+    case Double: {
+        if (idx.length != (int)sizeof(quint64)) {
+            break;
+        }
+        quint64 bits;
+        memcpy(&bits, data.constData() + pos, sizeof(bits));
+        bits = qFromLittleEndian(bits);
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return QVariant(d); }
+
+    case String:
+        return QVariant(QString::fromUtf8(data.constData() + pos, idx.length));
+
+    case ByteArray:
+        return QVariant(data.mid(pos, idx.length));
+
+    case Variant: {
+        QByteArray buf = QByteArray::fromRawData(data.constData() + pos, idx.length);
+        QDataStream ds(buf);
+        QVariant var;
+        ds >> var;
+        if (ds.status() != QDataStream::Ok) {
+            break;
+        }
+        return var; }
+
+    default:
+        break;
+    }
+
+    *ok = false;
+    return QVariant();
+}
@@ -0,0 +1,46 @@
+#ifndef TSESSIONSERIALIZER_H
+#define TSESSIONSERIALIZER_H
+
+#include <QVariant>
+#include <QByteArray>
+#include <QStringList>
+#include <TGlobal>
+
+
+class T_CORE_EXPORT TSessionSerializer
+{
+public:
+    static QByteArray serialize(const QVariantMap &map);
+    static bool deserialize(const QByteArray &data, QVariantMap &map);
+    static QVariant value(const QByteArray &data, const QString &key, const QVariant &defaultValue = QVariant());
+    static QStringList keys(const QByteArray &data);
+    static bool isCompactFormat(const QByteArray &data);
+
+private:
+    enum ValueType {
+        Null = 0,
+        False,
+        True,
+        Int,
+        UInt,
+        LongLong,
+        ULongLong,
+        Double,
+        String,
+        ByteArray,
+        Variant,  // QDataStream of QVariant
+    };
+
+    struct Index
+    {
+        QString key;
+        int type;
+        int offset;
+        int length;
+    };
+
+    static bool readIndex(const QByteArray &data, QList<Index> &index, const QString *key = 0);
+    static QVariant decodeValue(const QByteArray &data, const Index &idx, bool *ok);
+};
+
+#endif // TSESSIONSERIALIZER_H
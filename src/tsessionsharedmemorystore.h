@@ -0,0 +1,17 @@
+#ifndef TSESSIONSHAREDMEMORYSTORE_H
+#define TSESSIONSHAREDMEMORYSTORE_H
+
+#include <TSessionStore>
+
+
+class T_CORE_EXPORT TSessionSharedMemoryStore : public TSessionStore
+{
+public:
+    QString key() const { return "sharedmemory"; }
+    TSession find(const QByteArray &id, const QDateTime &modified);
+    bool store(TSession &session);
+    bool remove(const QDateTime &garbageExpiration);
+    bool remove(const QByteArray &id);
+};
+
+#endif // TSESSIONSHAREDMEMORYSTORE_H
@@ -0,0 +1,722 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <TWebApplication>
+#include <TSystemGlobal>
+#include "tsessionsharedmemorystore.h"
+#include "tsessionserializer.h"
+#include "tfcore_unix.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <sched.h>
+#include <string.h>
+
+/*!
+  \class TSessionSharedMemoryStore
+  \brief The TSessionSharedMemoryStore class stores HTTP sessions into
+  a shared memory, which is shared among the application server processes.
+
+  The shared memory holds a hash table of fixed-size slabs. Each bucket
+  of the table has its own lock, so processes accessing different
+  sessions do not wait for each other. A session is serialized into a
+  chain of slabs.
+
+  A lock left by a dead process is taken over by another process, which
+  then validates the entries of the bucket, or the list of free slabs,
+  and cuts off the broken ones if any. The slabs the dead process was
+  allocating, releasing or cutting off are not reclaimed until the shared
+  memory is created again. The shared memory is unlinked and created
+  again if a dead process left it uninitialized or if it has an
+  incompatible layout. Only one process does this.
+*/
+
+namespace {
+    const quint32 MAGIC_NUMBER = 0x54465353;  // "TFSS"
+    const quint32 LAYOUT_VERSION = 1;
+    const int SLAB_SIZE = 512;
+    const int SLAB_COUNT = 128 * 1024;  // 64MB
+    const int BUCKET_COUNT = 64 * 1024;
+    const int MAX_ID_LENGTH = 255;
+    const int SPIN_COUNT = 1000;
+    const int NIL = -1;
+
+    struct Header
+    {
+        QBasicAtomicInt ready;
+        quint32 magic;
+        quint32 version;
+        qint32 bucketCount;
+        qint32 slabCount;
+        qint32 slabSize;
+        QBasicAtomicInt allocLock;
+        qint32 freeHead;    // recycled slabs
+        qint32 nextUnused;  // slabs never used
+    };
+
+    struct Bucket
+    {
+        QBasicAtomicInt lock;
+        qint32 head;
+    };
+
+    struct Slab
+    {
+        qint32 next;       // next entry in the bucket, or next free slab
+        qint32 chunk;      // continued slab of this entry
+        quint32 hash;
+        qint32 idLength;
+        qint32 dataLength;
+        qint32 reserved;
+        qint64 updatedAt;  // seconds since epoch
+        char payload[SLAB_SIZE - 32];
+    };
+
+    const int PAYLOAD_SIZE = SLAB_SIZE - 32;
+
+    struct Layout
+    {
+        Header header;
+        Bucket buckets[BUCKET_COUNT];
+        Slab slabs[SLAB_COUNT];
+    };
+
+
+    inline int atomicLoad(QBasicAtomicInt &value)
+    {
+#if QT_VERSION >= 0x050000
+        return value.loadAcquire();
+#else
+        return (int)value;
+#endif
+    }
+
+
+    inline quint32 hashId(const QByteArray &id)
+    {
+        // FNV-1a; must be the same in every process
+        quint32 h = 2166136261u;
+        for (int i = 0; i < id.length(); ++i) {
+            h ^= (uchar)id[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+
+    /*
+      Spin lock shared by the processes. The lock word holds the PID of
+      the owner process so that a lock left by a dead process is taken over.
+    */
+    class ShmLocker
+    {
+    public:
+        ShmLocker(QBasicAtomicInt &lock) : lockWord(lock), takenOver(false)
+        {
+            const int pid = (int)::getpid();
+            for (int i = 1; !lockWord.testAndSetAcquire(0, pid); ++i) {
+                if (i % SPIN_COUNT == 0) {
+                    int owner = atomicLoad(lockWord);
+                    if (owner != 0 && owner != pid && ::kill(owner, 0) < 0 && errno == ESRCH) {
+                        if (lockWord.testAndSetAcquire(owner, pid)) {
+                            tSystemWarn("Took over the session lock of dead process: %d", owner);
+                            takenOver = true;
+                            break;
+                        }
+                    }
+                    sched_yield();
+                }
+            }
+        }
+
+        ~ShmLocker() { lockWord.fetchAndStoreRelease(0); }
+
+        // True if the lock was taken over from a dead process
+        bool tookOver() const { return takenOver; }
+
+    private:
+        QBasicAtomicInt &lockWord;
+        bool takenOver;
+    };
+
+
+    class SessionTable
+    {
+    public:
+        static SessionTable *instance();
+
+        bool isValid() const { return (bool)layout; }
+        QByteArray find(const QByteArray &id, qint64 validUpdatedAt);
+        bool store(const QByteArray &id, const QByteArray &data, qint64 updatedAt);
+        bool remove(const QByteArray &id);
+        void removeOlder(qint64 expiration);
+
+    private:
+        enum AttachResult {
+            Attached,
+            Stale,
+            Failed
+        };
+
+        SessionTable() : layout(0) { }
+        bool attach();
+        AttachResult attachSegment(const QByteArray &name, struct stat *stale);
+        static bool unlinkStale(const QByteArray &name, const struct stat &stale);
+        Slab &slab(int index) { return layout->slabs[index]; }
+        Bucket &bucket(quint32 hash) { return layout->buckets[hash % BUCKET_COUNT]; }
+        int findEntry(const Bucket &bkt, quint32 hash, const QByteArray &id, int *prev);
+        int unlinkEntry(Bucket &bkt, int index, int prev);
+        int allocate(int count);
+        void release(int index);
+        bool isValidEntry(int index);
+        void repairBucket(Bucket &bkt);
+        void repairFreeList();
+
+        Layout *layout;
+    };
+
+
+    SessionTable *SessionTable::instance()
+    {
+        static QMutex mutex;
+        static SessionTable *table = 0;
+
+        QMutexLocker locker(&mutex);
+        if (!table) {
+            table = new SessionTable();
+            table->attach();
+        }
+        return table;
+    }
+
+
+    bool SessionTable::attach()
+    {
+        // Named after the application root
+        QByteArray name = "/tfsess_" + QByteArray::number(hashId(Tf::app()->webRootPath().toUtf8()), 16);
+
+        for (int i = 0; i < 10; ++i) {
+            struct stat stale;
+            AttachResult res = attachSegment(name, &stale);
+            if (res != Stale) {
+                return (res == Attached);
+            }
+
+            if (!unlinkStale(name, stale)) {
+                // Another process is recreating it
+                ::usleep(10000);
+            }
+        }
+
+        tSystemError("Could not recreate the shared memory for sessions: %s", name.data());
+        return false;
+    }
+
+    /*
+      Opens the shared memory of \a name, or creates it if not found, and
+      maps it. If the memory was left uninitialized by a dead process or
+      has an incompatible layout, returns Stale and stores its status to
+      \a stale.
+    */
+    SessionTable::AttachResult SessionTable::attachSegment(const QByteArray &name, struct stat *stale)
+    {
+        const off_t size = sizeof(Layout);
+        bool creator = true;
+
+        int fd = ::shm_open(name.data(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST) {
+            creator = false;
+            fd = ::shm_open(name.data(), O_RDWR, 0600);
+            if (fd < 0 && errno == ENOENT) {
+                // Unlinked just now; retries
+                ::memset(stale, 0, sizeof(*stale));
+                return Stale;
+            }
+        }
+
+        if (fd < 0) {
+            tSystemError("Shared memory open error: %s  [%s:%d]", strerror(errno), __FILE__, __LINE__);
+            return Failed;
+        }
+
+        if (creator) {
+            if (::ftruncate(fd, size) < 0) {
+                tSystemError("Shared memory truncate error: %s  [%s:%d]", strerror(errno), __FILE__, __LINE__);
+                tf_close(fd);
+                ::shm_unlink(name.data());
+                return Failed;
+            }
+        } else {
+            // Waits for the creator to extend it
+            for (int i = 0; i < 100 && ::fstat(fd, stale) == 0 && stale->st_size < size; ++i) {
+                ::usleep(10000);
+            }
+            if (::fstat(fd, stale) < 0) {
+                tSystemError("Shared memory stat error: %s  [%s:%d]", strerror(errno), __FILE__, __LINE__);
+                tf_close(fd);
+                return Failed;
+            }
+            if (stale->st_size != size) {
+                tSystemWarn("Invalid size of shared memory for sessions: %s", name.data());
+                tf_close(fd);
+                return Stale;
+            }
+        }
+
+        void *ptr = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        tf_close(fd);
+        if (ptr == MAP_FAILED) {
+            tSystemError("Shared memory mmap error: %s  [%s:%d]", strerror(errno), __FILE__, __LINE__);
+            return Failed;
+        }
+
+        Layout *lay = static_cast<Layout *>(ptr);
+        if (creator) {
+            // The memory is zero-filled
+            lay->header.magic = MAGIC_NUMBER;
+            lay->header.version = LAYOUT_VERSION;
+            lay->header.bucketCount = BUCKET_COUNT;
+            lay->header.slabCount = SLAB_COUNT;
+            lay->header.slabSize = SLAB_SIZE;
+            lay->header.freeHead = NIL;
+            lay->header.nextUnused = 0;
+            for (int i = 0; i < BUCKET_COUNT; ++i) {
+                lay->buckets[i].head = NIL;
+            }
+            lay->header.ready.fetchAndStoreRelease(1);
+        } else {
+            for (int i = 0; i < 100 && !atomicLoad(lay->header.ready); ++i) {
+                ::usleep(10000);
+            }
+        }
+
+        if (!atomicLoad(lay->header.ready) || lay->header.magic != MAGIC_NUMBER
+            || lay->header.version != LAYOUT_VERSION || lay->header.bucketCount != BUCKET_COUNT
+            || lay->header.slabCount != SLAB_COUNT || lay->header.slabSize != SLAB_SIZE) {
+            tSystemWarn("Incompatible shared memory for sessions: %s", name.data());
+            ::munmap(ptr, size);
+            return Stale;
+        }
+
+        layout = lay;
+        tSystemDebug("Attached shared memory for sessions: %s", name.data());
+        return Attached;
+    }
+
+    /*
+      Unlinks the shared memory of \a name if it is still the \a stale one,
+      so that it is created again. Only the process that creates the lock
+      with O_EXCL does this; returns false in the other processes.
+    */
+    bool SessionTable::unlinkStale(const QByteArray &name, const struct stat &stale)
+    {
+        QByteArray lockName = name + "_lock";
+        int lfd = ::shm_open(lockName.data(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (lfd < 0) {
+            return false;
+        }
+        tf_close(lfd);
+
+        // Another process may have recreated it already
+        int fd = ::shm_open(name.data(), O_RDWR, 0600);
+        if (fd >= 0) {
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_dev == stale.st_dev && st.st_ino == stale.st_ino) {
+                tSystemWarn("Recreates the shared memory for sessions: %s", name.data());
+                ::shm_unlink(name.data());
+            }
+            tf_close(fd);
+        }
+
+        ::shm_unlink(lockName.data());
+        return true;
+    }
+
+
+    int SessionTable::findEntry(const Bucket &bkt, quint32 hash, const QByteArray &id, int *prev)
+    {
+        int p = NIL;
+        for (int i = bkt.head; i != NIL; i = slab(i).next) {
+            const Slab &s = slab(i);
+            if (s.hash == hash && s.idLength == id.length() && memcmp(s.payload, id.constData(), id.length()) == 0) {
+                *prev = p;
+                return i;
+            }
+            p = i;
+        }
+        return NIL;
+    }
+
+
+    int SessionTable::unlinkEntry(Bucket &bkt, int index, int prev)
+    {
+        int next = slab(index).next;
+        if (prev == NIL) {
+            bkt.head = next;
+        } else {
+            slab(prev).next = next;
+        }
+        return next;
+    }
+
+
+    /*
+      Returns true if the slab \a index is the head of an entry whose chain
+      of slabs is as long as its id and data.
+    */
+    bool SessionTable::isValidEntry(int index)
+    {
+        const Slab &hs = slab(index);
+        if (hs.idLength <= 0 || hs.idLength > MAX_ID_LENGTH || hs.dataLength < 0
+            || hs.dataLength > SLAB_COUNT * PAYLOAD_SIZE) {
+            return false;
+        }
+
+        int count = qMax((hs.idLength + hs.dataLength + PAYLOAD_SIZE - 1) / PAYLOAD_SIZE, 1);
+        int i = index;
+        for (int n = 1; n < count; ++n) {
+            i = slab(i).chunk;
+            if (i < 0 || i >= SLAB_COUNT) {
+                return false;
+            }
+        }
+        return slab(i).chunk == NIL;
+    }
+
+    /*
+      Validates the entries of the bucket whose lock has been taken over,
+      cutting off the list at the first broken one. The slabs cut off are
+      not released, since they might be in the list of free slabs.
+    */
+    void SessionTable::repairBucket(Bucket &bkt)
+    {
+        int prev = NIL;
+        int steps = 0;
+        for (int i = bkt.head; i != NIL; i = slab(i).next) {
+            if (i < 0 || i >= SLAB_COUNT || ++steps > SLAB_COUNT || !isValidEntry(i)) {
+                tSystemWarn("Cut off broken session entries in shared memory");
+                if (prev == NIL) {
+                    bkt.head = NIL;
+                } else {
+                    slab(prev).next = NIL;
+                }
+                break;
+            }
+            prev = i;
+        }
+    }
+
+    /*
+      Validates the list of free slabs whose lock has been taken over,
+      in the same way as repairBucket().
+    */
+    void SessionTable::repairFreeList()
+    {
+        Header &hdr = layout->header;
+        if (hdr.nextUnused < 0 || hdr.nextUnused > SLAB_COUNT) {
+            tSystemWarn("Broken count of used slabs in shared memory: %d", hdr.nextUnused);
+            hdr.nextUnused = SLAB_COUNT;
+        }
+
+        int prev = NIL;
+        int steps = 0;
+        for (int i = hdr.freeHead; i != NIL; i = slab(i).next) {
+            if (i < 0 || i >= hdr.nextUnused || ++steps > SLAB_COUNT) {
+                tSystemWarn("Cut off broken list of free slabs in shared memory");
+                if (prev == NIL) {
+                    hdr.freeHead = NIL;
+                } else {
+                    slab(prev).next = NIL;
+                }
+                break;
+            }
+            prev = i;
+        }
+    }
+
+
+    int SessionTable::allocate(int count)
+    {
+        ShmLocker locker(layout->header.allocLock);
+        if (locker.tookOver()) {
+            repairFreeList();
+        }
+        int head = NIL;
+        int last = NIL;
+        int n = 0;
+
+        for (; n < count; ++n) {
+            int index;
+            if (layout->header.freeHead != NIL) {
+                index = layout->header.freeHead;
+                layout->header.freeHead = slab(index).next;
+            } else if (layout->header.nextUnused < SLAB_COUNT) {
+                index = layout->header.nextUnused++;
+            } else {
+                break;
+            }
+
+            slab(index).next = NIL;
+            slab(index).chunk = NIL;
+            if (last == NIL) {
+                head = index;
+            } else {
+                slab(last).chunk = index;
+            }
+            last = index;
+        }
+
+        if (n < count) {
+            // Gives them back
+            for (int i = head; i != NIL; ) {
+                int chunk = slab(i).chunk;
+                slab(i).next = layout->header.freeHead;
+                layout->header.freeHead = i;
+                i = chunk;
+            }
+            return NIL;
+        }
+        return head;
+    }
+
+
+    void SessionTable::release(int index)
+    {
+        ShmLocker locker(layout->header.allocLock);
+        if (locker.tookOver()) {
+            repairFreeList();
+        }
+        while (index != NIL) {
+            int chunk = slab(index).chunk;
+            slab(index).next = layout->header.freeHead;
+            layout->header.freeHead = index;
+            index = chunk;
+        }
+    }
+
+
+    QByteArray SessionTable::find(const QByteArray &id, qint64 validUpdatedAt)
+    {
+        QByteArray data;
+        quint32 hash = hashId(id);
+        Bucket &bkt = bucket(hash);
+        int expired = NIL;
+        {
+            ShmLocker locker(bkt.lock);
+            if (locker.tookOver()) {
+                repairBucket(bkt);
+            }
+            int prev;
+            int index = findEntry(bkt, hash, id, &prev);
+            if (index == NIL) {
+                return data;
+            }
+
+            if (slab(index).updatedAt < validUpdatedAt) {
+                unlinkEntry(bkt, index, prev);
+                expired = index;
+            } else {
+                int len = slab(index).dataLength;
+                int offset = slab(index).idLength;
+                data.resize(len);
+                char *dst = data.data();
+                for (int i = index; i != NIL && len > 0; i = slab(i).chunk) {
+                    int n = qMin(PAYLOAD_SIZE - offset, len);
+                    memcpy(dst, slab(i).payload + offset, n);
+                    dst += n;
+                    len -= n;
+                    offset = 0;
+                }
+            }
+        }
+
+        if (expired != NIL) {
+            release(expired);
+        }
+        return data;
+    }
+
+
+    bool SessionTable::store(const QByteArray &id, const QByteArray &data, qint64 updatedAt)
+    {
+        if (id.isEmpty() || id.length() > MAX_ID_LENGTH) {
+            return false;
+        }
+
+        int total = id.length() + data.length();
+        int count = qMax((total + PAYLOAD_SIZE - 1) / PAYLOAD_SIZE, 1);
+        int head = allocate(count);
+        if (head == NIL) {
+            tSystemWarn("Shared memory for sessions exhausted");
+            return false;
+        }
+
+        // Writes the new entry before publishing it
+        quint32 hash = hashId(id);
+        Slab &hs = slab(head);
+        hs.hash = hash;
+        hs.idLength = id.length();
+        hs.dataLength = data.length();
+        hs.updatedAt = updatedAt;
+
+        const char *src = id.constData();
+        int len = id.length();
+        int offset = 0;
+        int i = head;
+        for (int part = 0; part < 2; ++part) {
+            while (len > 0) {
+                int n = qMin(PAYLOAD_SIZE - offset, len);
+                memcpy(slab(i).payload + offset, src, n);
+                src += n;
+                len -= n;
+                offset += n;
+                if (offset == PAYLOAD_SIZE && slab(i).chunk != NIL) {
+                    i = slab(i).chunk;
+                    offset = 0;
+                }
+            }
+            src = data.constData();
+            len = data.length();
+        }
+
+        Bucket &bkt = bucket(hash);
+        int old = NIL;
+        {
+            ShmLocker locker(bkt.lock);
+            if (locker.tookOver()) {
+                repairBucket(bkt);
+            }
+            int prev;
+            old = findEntry(bkt, hash, id, &prev);
+            if (old != NIL) {
+                hs.next = unlinkEntry(bkt, old, prev);
+                if (prev == NIL) {
+                    bkt.head = head;
+                } else {
+                    slab(prev).next = head;
+                }
+            } else {
+                hs.next = bkt.head;
+                bkt.head = head;
+            }
+        }
+
+        if (old != NIL) {
+            release(old);
+        }
+        return true;
+    }
+
+
+    bool SessionTable::remove(const QByteArray &id)
+    {
+        quint32 hash = hashId(id);
+        Bucket &bkt = bucket(hash);
+        int index;
+        {
+            ShmLocker locker(bkt.lock);
+            if (locker.tookOver()) {
+                repairBucket(bkt);
+            }
+            int prev;
+            index = findEntry(bkt, hash, id, &prev);
+            if (index != NIL) {
+                unlinkEntry(bkt, index, prev);
+            }
+        }
+
+        if (index == NIL) {
+            return false;
+        }
+        release(index);
+        return true;
+    }
+
+
+    void SessionTable::removeOlder(qint64 expiration)
+    {
+        for (int b = 0; b < BUCKET_COUNT; ++b) {
+            Bucket &bkt = layout->buckets[b];
+            if (bkt.head == NIL) {
+                continue;
+            }
+
+            int garbage = NIL;
+            {
+                ShmLocker locker(bkt.lock);
+                if (locker.tookOver()) {
+                    repairBucket(bkt);
+                }
+                int prev = NIL;
+                for (int i = bkt.head; i != NIL; ) {
+                    if (slab(i).updatedAt < expiration) {
+                        int next = unlinkEntry(bkt, i, prev);
+                        slab(i).next = garbage;
+                        garbage = i;
+                        i = next;
+                    } else {
+                        prev = i;
+                        i = slab(i).next;
+                    }
+                }
+            }
+
+            while (garbage != NIL) {
+                int next = slab(garbage).next;
+                release(garbage);
+                garbage = next;
+            }
+        }
+    }
+}
+
+
+bool TSessionSharedMemoryStore::store(TSession &session)
+{
+    SessionTable *table = SessionTable::instance();
+    if (!table->isValid()) {
+        return false;
+    }
+
+    QByteArray data = TSessionSerializer::serialize(*static_cast<const QVariantMap *>(&session));
+    return table->store(session.id(), data, QDateTime::currentDateTime().toTime_t());
+}
+
+
+TSession TSessionSharedMemoryStore::find(const QByteArray &id, const QDateTime &modified)
+{
+    SessionTable *table = SessionTable::instance();
+    if (table->isValid() && !id.isEmpty()) {
+        QByteArray data = table->find(id, modified.toTime_t());
+        if (!data.isEmpty()) {
+            TSession result(id);
+            if (TSessionSerializer::deserialize(data, *static_cast<QVariantMap *>(&result)))
+                return result;
+        }
+    }
+    return TSession();
+}
+
+
+bool TSessionSharedMemoryStore::remove(const QDateTime &garbageExpiration)
+{
+    SessionTable *table = SessionTable::instance();
+    if (!table->isValid()) {
+        return false;
+    }
+    table->removeOlder(garbageExpiration.toTime_t());
+    return true;
+}
+
+
+bool TSessionSharedMemoryStore::remove(const QByteArray &id)
+{
+    SessionTable *table = SessionTable::instance();
+    return table->isValid() && table->remove(id);
+}
@@ -9,6 +9,7 @@
 #include <TCriteria>
 #include "tsessionsqlobjectstore.h"
 #include "tsessionobject.h"
+#include "tsessionserializer.h"
 
 /*!
   \class TSessionSqlObjectStore
@@ -25,8 +26,7 @@ bool TSessionSqlObjectStore::store(TSession &session)
     TCriteria cri(TSessionObject::Id, TSql::Equal, session.id());
     TSessionObject so = mapper.findFirst(cri);
 
-    QDataStream ds(&so.data, QIODevice::WriteOnly);
-    ds << *static_cast<const QVariantMap *>(&session);
+    so.data = TSessionSerializer::serialize(*static_cast<const QVariantMap *>(&session));
 
     if (so.isEmpty()) {
         so.id = session.id();
@@ -48,8 +48,7 @@ TSession TSessionSqlObjectStore::find(const QByteArray &id, const QDateTime &mod
         return TSession();
 
     TSession result(id);
-    QDataStream ds(&sess.data, QIODevice::ReadOnly);
-    ds >> *static_cast<QVariantMap *>(&result);
+    TSessionSerializer::deserialize(sess.data, *static_cast<QVariantMap *>(&result));
     return result;
 }
 
@@ -18,6 +18,9 @@
 #include "tsessionsqlobjectstore.h"
 #include "tsessioncookiestore.h"
 #include "tsessionfilestore.h"
+#ifdef Q_OS_UNIX
+# include "tsessionsharedmemorystore.h"
+#endif
 #include "tsystemglobal.h"
 #if QT_VERSION >= 0x050000
 # include <QJsonArray>
@@ -59,6 +62,9 @@ QStringList TSessionStoreFactory::keys()
     ret << TSessionSqlObjectStore().key().toLower()
         << TSessionCookieStore().key().toLower()
         << TSessionFileStore().key().toLower()
+#ifdef Q_OS_UNIX
+        << TSessionSharedMemoryStore().key().toLower()
+#endif
         << sessIfMap->keys();
 
     return ret;
@@ -75,6 +81,9 @@ TSessionStore *TSessionStoreFactory::create(const QString &key)
     static const QString COOKIE_KEY = TSessionCookieStore().key().toLower();
     static const QString SQLOBJECT_KEY = TSessionSqlObjectStore().key().toLower();
     static const QString FILE_KEY = TSessionFileStore().key().toLower();
+#ifdef Q_OS_UNIX
+    static const QString SHAREDMEMORY_KEY = TSessionSharedMemoryStore().key().toLower();
+#endif
 
     QMutexLocker locker(&mutex);
 
@@ -88,6 +97,10 @@ TSessionStore *TSessionStoreFactory::create(const QString &key)
         ret = new TSessionSqlObjectStore;
     } else if (k == FILE_KEY) {
         ret = new TSessionFileStore;
+#ifdef Q_OS_UNIX
+    } else if (k == SHAREDMEMORY_KEY) {
+        ret = new TSessionSharedMemoryStore;
+#endif
     } else {
         TSessionStoreInterface *ssif = sessIfMap->value(k);
         if (ssif) {
@@ -19,6 +19,7 @@ private:
         SqlObject,
         Cookie,
         File,
+        SharedMemory,
         Plugin,
     };
 
@@ -6,15 +6,24 @@
  */
 
 #include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThread>
+#include <QPointer>
+#include <QSqlQuery>
 #include <QFileInfo>
 #include <QDir>
 #include <TWebApplication>
 #include <TAppSettings>
 #include "tsqldatabasepool.h"
+#include "tsqlstatementcache.h"
 #include "tsystemglobal.h"
 
 #define CONN_NAME_FORMAT  "rdb%02d_%d"
 
+const int DefaultWaitTimeoutMsecs = 10000;
+const int DefaultIdleTimeoutSecs = 30;  // closes connections idle longer than this
+const uint HealthCheckIdleSecs = 10;    // checks connections idle longer than this
+
 static TSqlDatabasePool *databasePool = 0;
 
 
@@ -26,36 +35,72 @@ static void cleanup()
     }
 }
 
+/*!
+  \class TSqlDatabasePool
+  \brief The TSqlDatabasePool class provides a pool of SQL database
+  connections for each database ID.
+
+  When all connections are in use, database() waits for a connection to
+  be pooled again until the timeout specified by the \a PoolWaitTimeout
+  parameter in the database settings file, in milliseconds; defaults to
+  10000. A connection is preferably handed out to the thread that used
+  it last. A connection that has been idle for a while is checked before
+  it is handed out, and reopened if the server has dropped it. The
+  connections that a thread has left idle for longer than the
+  \a PoolIdleTimeout parameter, in seconds, are closed. The default is
+  30. That thread closes them when it next gets or pools a connection.
+  If the thread has exited, a timer running every 10 seconds closes
+  them instead. The lock of the pool is not held while a connection is
+  checked, opened or closed.
+*/
+
+struct TSqlDatabasePool::ConnectionSet
+{
+    struct IdleConnection
+    {
+        QString name;
+        uint lastUsed;
+        QPointer<QThread> thread;  // the thread that used it last
+    };
+
+    QStringList names;
+    QList<IdleConnection> idle;  // open connections, most recently pooled last
+    QStringList closed;
+    int inUse;
+    int waiting;
+    int waitTimeout;
+    uint idleTimeout;
+    QWaitCondition released;
+    Statistics stats;
+    Statistics logged;  // statistics when logged last
+
+    ConnectionSet() : inUse(0), waiting(0), waitTimeout(DefaultWaitTimeoutMsecs), idleTimeout(DefaultIdleTimeoutSecs), stats(), logged() { }
+};
+
 
 TSqlDatabasePool::~TSqlDatabasePool()
 {
     timer.stop();
 
     QMutexLocker locker(&mutex);
-    for (int j = 0; j < pooledConnections.count(); ++j) {
-        QMap<QString, uint> &map = pooledConnections[j];
-        QMap<QString, uint>::iterator it = map.begin();
-        while (it != map.end()) {
-            QSqlDatabase::database(it.key(), false).close();
-            it = map.erase(it);
-        }
-
-        for (int i = 0; i < maxConnects; ++i) {
-            QString name = QString::number(j) + '_' + QString::number(i);
-            if (QSqlDatabase::contains(name)) {
-                QSqlDatabase::removeDatabase(name);
-            } else {
-                break;
-            }
+    for (int j = 0; j < connectionSets.count(); ++j) {
+        ConnectionSet *set = connectionSets[j];
+        for (QStringListIterator it(set->names); it.hasNext(); ) {
+            const QString &name = it.next();
+            TSqlStatementCache::clear(name);
+            QSqlDatabase::database(name, false).close();
+            QSqlDatabase::removeDatabase(name);
         }
+        delete set;
     }
+    connectionSets.clear();
 }
 
 
 TSqlDatabasePool::TSqlDatabasePool(const QString &environment)
     : QObject(), maxConnects(0), dbEnvironment(environment)
 {
-    // Starts the timer to close extra-connection
+    // Starts the timer to log the statistics
     timer.start(10000, this);
 }
 
@@ -71,11 +116,23 @@ void TSqlDatabasePool::init()
 
     // Adds databases previously
     for (int j = 0; j < Tf::app()->sqlDatabaseSettingsCount(); ++j) {
+        ConnectionSet *set = new ConnectionSet;
+        connectionSets.append(set);
+
         QString type = driverType(dbEnvironment, j);
         if (type.isEmpty()) {
             continue;
         }
 
+        QSettings &settings = Tf::app()->sqlDatabaseSettings(j);
+        settings.beginGroup(dbEnvironment);
+        bool ok;
+        int timeout = settings.value("PoolWaitTimeout").toInt(&ok);
+        set->waitTimeout = (ok && timeout >= 0) ? timeout : DefaultWaitTimeoutMsecs;
+        timeout = settings.value("PoolIdleTimeout").toInt(&ok);
+        set->idleTimeout = (ok && timeout > 0) ? timeout : DefaultIdleTimeoutSecs;
+        settings.endGroup();
+
         for (int i = 0; i < maxConnects; ++i) {
             QSqlDatabase db = QSqlDatabase::addDatabase(type, QString().sprintf(CONN_NAME_FORMAT, j, i));
             if (!db.isValid()) {
@@ -84,10 +141,10 @@ void TSqlDatabasePool::init()
             }
 
             setDatabaseSettings(db, dbEnvironment, j);
+            set->names << db.connectionName();
+            set->closed << db.connectionName();
             tSystemDebug("Add Database successfully. name:%s", qPrintable(db.connectionName()));
         }
-
-        pooledConnections.append(QMap<QString, uint>());
     }
 }
 
@@ -95,44 +152,218 @@ void TSqlDatabasePool::init()
 QSqlDatabase TSqlDatabasePool::database(int databaseId)
 {
     T_TRACEFUNC("");
-    QMutexLocker locker(&mutex);
     QSqlDatabase db;
 
     if (Q_UNLIKELY(!Tf::app()->isSqlDatabaseAvailable())) {
         return db;
     }
 
-    if (databaseId >= 0 && databaseId < pooledConnections.count()) {
-        QMap<QString, uint> &map = pooledConnections[databaseId];
-        QMap<QString, uint>::iterator it = map.begin();
-        while (it != map.end()) {
-            db = QSqlDatabase::database(it.key(), false);
-            it = map.erase(it);
-            if (Q_LIKELY(db.isOpen())) {
-                tSystemDebug("Gets database: %s", qPrintable(db.connectionName()));
-                return db;
-            } else {
-                tSystemError("Pooled database is not open: %s  [%s:%d]", qPrintable(db.connectionName()), __FILE__, __LINE__);
+    QMutexLocker locker(&mutex);
+    if (Q_UNLIKELY(databaseId < 0 || databaseId >= connectionSets.count())) {
+        throw RuntimeException("No pooled connection", __FILE__, __LINE__);
+    }
+
+    ConnectionSet *set = connectionSets[databaseId];
+    if (Q_UNLIKELY(set->names.isEmpty())) {
+        tSystemError("No database connection configured  id:%d", databaseId);
+        throw RuntimeException("No pooled connection", __FILE__, __LINE__);
+    }
+
+    QStringList expired = takeExpiredConnections(set);
+    if (!expired.isEmpty()) {
+        locker.unlock();
+        closeConnections(set, expired);
+        locker.relock();
+    }
+
+    QString name;
+    bool check = false;
+    bool open = false;
+    QTime waitTime;
+    bool waited = false;
+
+    // Takes a connection under the lock
+    for (;;) {
+        if (!set->idle.isEmpty()) {
+            // Prefers the connection this thread used last
+            int index = set->idle.count() - 1;
+            QThread *current = QThread::currentThread();
+            for (int i = index; i >= 0; --i) {
+                if (set->idle[i].thread == current) {
+                    index = i;
+                    set->stats.affinityHits++;
+                    break;
+                }
             }
+
+            ConnectionSet::IdleConnection conn = set->idle.takeAt(index);
+            name = conn.name;
+            check = (conn.lastUsed + HealthCheckIdleSecs <= QDateTime::currentDateTime().toTime_t());
+            break;
         }
 
-        for (int i = 0; i < maxConnects; ++i) {
-            db = QSqlDatabase::database(QString().sprintf(CONN_NAME_FORMAT, databaseId, i), false);
-            if (!db.isOpen()) {
-                if (Q_UNLIKELY(!db.open())) {
-                    tError("Database open error. Invalid database settings, or maximum number of SQL connection exceeded.");
-                    tSystemError("Database open error: %s", qPrintable(db.connectionName()));
-                    return QSqlDatabase();
-                }
+        if (!set->closed.isEmpty()) {
+            name = set->closed.takeFirst();
+            open = true;
+            break;
+        }
 
-                tSystemDebug("Database opened successfully (env:%s)", qPrintable(dbEnvironment));
-                tSystemDebug("Gets database: %s", qPrintable(db.connectionName()));
-                return db;
-            }
+        // All connections are in use
+        if (!waited) {
+            waited = true;
+            waitTime.start();
+            set->waiting++;
+            set->stats.waited++;
+            set->stats.maxQueueLength = qMax(set->stats.maxQueueLength, set->waiting);
+        }
+
+        int remaining = set->waitTimeout - waitTime.elapsed();
+        if (remaining <= 0) {
+            set->waiting--;
+            set->stats.timedOut++;
+            tSystemError("Timed out waiting for a database connection  id:%d  waiting:%d", databaseId, set->waiting);
+            throw RuntimeException("No pooled connection", __FILE__, __LINE__);
+        }
+        set->released.wait(&mutex, remaining);
+    }
+
+    if (waited) {
+        int msecs = waitTime.elapsed();
+        set->waiting--;
+        set->stats.totalWaitMsecs += msecs;
+        set->stats.maxWaitMsecs = qMax(set->stats.maxWaitMsecs, msecs);
+    }
+    set->inUse++;
+    locker.unlock();
+
+    // Checks and opens the connection without the lock
+    db = QSqlDatabase::database(name, false);
+    bool reconnected = false;
+    if (check && !checkHealth(db)) {
+        tSystemWarn("Reopens the stale database connection: %s", qPrintable(name));
+        TSqlStatementCache::clear(name);
+        db.close();
+        open = true;
+        reconnected = true;
+    }
+
+    bool opened = open && openDatabase(db);
+
+    locker.relock();
+    if (open && !opened) {
+        set->closed.prepend(name);
+        set->inUse--;
+        set->released.wakeOne();
+        return QSqlDatabase();
+    }
+
+    set->stats.acquired++;
+    if (opened) {
+        set->stats.opened++;
+    }
+    if (reconnected) {
+        set->stats.reconnected++;
+    }
+    tSystemDebug("Gets database: %s", qPrintable(name));
+    return db;
+}
+
+
+TSqlDatabasePool::Statistics TSqlDatabasePool::statistics(int databaseId) const
+{
+    QMutexLocker locker(&mutex);
+    Statistics stats = Statistics();
+
+    if (databaseId >= 0 && databaseId < connectionSets.count()) {
+        const ConnectionSet *set = connectionSets[databaseId];
+        stats = set->stats;
+        stats.inUse = set->inUse;
+        stats.idle = set->idle.count();
+    }
+    return stats;
+}
+
+
+bool TSqlDatabasePool::openDatabase(QSqlDatabase &database)
+{
+    if (Q_UNLIKELY(!database.open())) {
+        tError("Database open error. Invalid database settings, or maximum number of SQL connection exceeded.");
+        tSystemError("Database open error: %s", qPrintable(database.connectionName()));
+        return false;
+    }
+
+    tSystemDebug("Database opened successfully (env:%s)", qPrintable(dbEnvironment));
+    return true;
+}
+
+/*!
+  Takes the connections of the \a set which the current thread has
+  left idle for too long. If \a orphaned is true, takes the ones whose
+  thread has exited instead. Call this with the lock held.
+ */
+QStringList TSqlDatabasePool::takeExpiredConnections(ConnectionSet *set, bool orphaned)
+{
+    QStringList names;
+    uint now = QDateTime::currentDateTime().toTime_t();
+    QThread *current = QThread::currentThread();
+
+    QMutableListIterator<ConnectionSet::IdleConnection> it(set->idle);
+    while (it.hasNext()) {
+        const ConnectionSet::IdleConnection &conn = it.next();
+        bool owned = (orphaned) ? (conn.thread.isNull() || conn.thread->isFinished()) : (conn.thread == current);
+        if (owned && conn.lastUsed + set->idleTimeout < now) {
+            names << conn.name;
+            it.remove();
         }
     }
+    return names;
+}
+
+/*!
+  Closes the connections of the \a names taken from the \a set, and
+  returns them to the set as closed ones. Call this without the lock.
+ */
+void TSqlDatabasePool::closeConnections(ConnectionSet *set, const QStringList &names)
+{
+    if (names.isEmpty()) {
+        return;
+    }
+
+    for (QStringListIterator it(names); it.hasNext(); ) {
+        const QString &name = it.next();
+        TSqlStatementCache::clear(name);
+        QSqlDatabase::database(name, false).close();
+        tSystemDebug("Closed database connection, name: %s", qPrintable(name));
+    }
+
+    QMutexLocker locker(&mutex);
+    set->closed << names;
+    set->released.wakeAll();
+}
+
+/*!
+  Returns true if the \a database still responds; otherwise returns false.
+ */
+bool TSqlDatabasePool::checkHealth(QSqlDatabase &database)
+{
+    if (!database.isOpen()) {
+        return false;
+    }
+
+    QString driver = database.driverName().toUpper();
+    QString sql;
+    if (driver.startsWith("QOCI")) {
+        sql = QLatin1String("SELECT 1 FROM DUAL");
+    } else if (driver.startsWith("QDB2")) {
+        sql = QLatin1String("VALUES 1");
+    } else if (driver.startsWith("QIBASE")) {
+        sql = QLatin1String("SELECT 1 FROM RDB$DATABASE");
+    } else {
+        sql = QLatin1String("SELECT 1");
+    }
 
-    throw RuntimeException("No pooled connection", __FILE__, __LINE__);
+    QSqlQuery query(database);
+    return query.exec(sql);
 }
 
 
@@ -197,9 +428,25 @@ void TSqlDatabasePool::pool(QSqlDatabase &database)
     if (database.isValid()) {
         int databaseId = getDatabaseId(database);
 
-        if (databaseId >= 0 && databaseId < pooledConnections.count()) {
-            pooledConnections[databaseId].insert(database.connectionName(), QDateTime::currentDateTime().toTime_t());
+        if (databaseId >= 0 && databaseId < connectionSets.count()) {
+            ConnectionSet *set = connectionSets[databaseId];
+            QStringList expired = takeExpiredConnections(set);
+            if (database.isOpen()) {
+                ConnectionSet::IdleConnection conn;
+                conn.name = database.connectionName();
+                conn.lastUsed = QDateTime::currentDateTime().toTime_t();
+                conn.thread = QThread::currentThread();
+                set->idle << conn;
+            } else {
+                TSqlStatementCache::clear(database.connectionName());
+                set->closed << database.connectionName();
+            }
+            set->inUse--;
+            set->released.wakeOne();
             tSystemDebug("Pooled database: %s", qPrintable(database.connectionName()));
+
+            locker.unlock();
+            closeConnections(set, expired);
         } else {
             tSystemError("Pooled invalid database  [%s:%d]", __FILE__, __LINE__);
         }
@@ -213,23 +460,30 @@ void TSqlDatabasePool::timerEvent(QTimerEvent *event)
     T_TRACEFUNC("");
 
     if (event->timerId() == timer.timerId()) {
-        // Closes extra-connection
         if (mutex.tryLock()) {
-            for (int i = 0; i < pooledConnections.count(); ++i) {
-                QMap<QString, uint> &map = pooledConnections[i];
-                QMap<QString, uint>::iterator it = map.begin();
-                while (it != map.end()) {
-                    uint tm = it.value();
-                    if (tm < QDateTime::currentDateTime().toTime_t() - 30) { // 30sec
-                        QSqlDatabase::database(it.key(), false).close();
-                        tSystemDebug("Closed database connection, name: %s", qPrintable(it.key()));
-                        it = map.erase(it);
-                    } else {
-                        ++it;
-                    }
+            QVector<QStringList> orphans(connectionSets.count());
+            for (int j = 0; j < connectionSets.count(); ++j) {
+                ConnectionSet *set = connectionSets[j];
+
+                // Connections left by exited threads are not closed otherwise
+                orphans[j] = takeExpiredConnections(set, true);
+
+                // Logs the statistics if connections were waited for
+                const Statistics &st = set->stats;
+                if (st.waited != set->logged.waited || st.timedOut != set->logged.timedOut) {
+                    tSystemInfo("SQL connection pool id:%d  acquired:%llu  affinity:%llu  waited:%llu  timedout:%llu  avgwait:%llums  maxwait:%dms  maxqueue:%d  opened:%llu  reconnected:%llu  inuse:%d  idle:%d",
+                                j, st.acquired, st.affinityHits, st.waited, st.timedOut,
+                                (st.waited > 0) ? st.totalWaitMsecs / st.waited : Q_UINT64_C(0),
+                                st.maxWaitMsecs, st.maxQueueLength, st.opened, st.reconnected,
+                                set->inUse, set->idle.count());
+                    set->logged = st;
                 }
             }
             mutex.unlock();
+
+            for (int j = 0; j < orphans.count(); ++j) {
+                closeConnections(connectionSets[j], orphans[j]);
+            }
         }
     } else {
         QObject::timerEvent(event);
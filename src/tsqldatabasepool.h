@@ -6,6 +6,7 @@
 #include <QVector>
 #include <QMap>
 #include <QString>
+#include <QStringList>
 #include <QMutex>
 #include <QDateTime>
 #include <QBasicTimer>
@@ -17,8 +18,24 @@ class T_CORE_EXPORT TSqlDatabasePool : public QObject
     Q_OBJECT
 public:
     ~TSqlDatabasePool();
+    struct Statistics
+    {
+        quint64 acquired;        // connections handed out
+        quint64 affinityHits;    // handed out to the thread that used it last
+        quint64 waited;          // acquisitions that had to wait
+        quint64 timedOut;        // acquisitions given up
+        quint64 totalWaitMsecs;
+        int maxWaitMsecs;
+        int maxQueueLength;      // waiting threads at the worst moment
+        quint64 opened;          // connections opened
+        quint64 reconnected;     // stale connections found by health checks
+        int inUse;
+        int idle;
+    };
+
     QSqlDatabase database(int databaseId = 0);
     void pool(QSqlDatabase &database);
+    Statistics statistics(int databaseId) const;
 
     static void instantiate();
     static TSqlDatabasePool *instance();
@@ -36,8 +53,14 @@ private:
     Q_DISABLE_COPY(TSqlDatabasePool)
     TSqlDatabasePool(const QString &environment);
 
-    QVector<QMap<QString, uint>> pooledConnections;
-    QMutex mutex;
+    struct ConnectionSet;
+    bool openDatabase(QSqlDatabase &database);
+    bool checkHealth(QSqlDatabase &database);
+    QStringList takeExpiredConnections(ConnectionSet *set, bool orphaned = false);
+    void closeConnections(ConnectionSet *set, const QStringList &names);
+
+    QVector<ConnectionSet *> connectionSets;
+    mutable QMutex mutex;
     int maxConnects;
     QString dbEnvironment;
     QBasicTimer timer;
@@ -11,6 +11,7 @@
 #include <TSqlObject>
 #include <TSqlQuery>
 #include <TSystemGlobal>
+#include "tsqlstatementcache.h"
 
 const QByteArray LockRevision("lock_revision");
 const QByteArray CreatedAt("created_at");
@@ -142,7 +143,7 @@ bool TSqlObject::create()
     }
 
     QSqlDatabase &database = Tf::currentSqlDatabase(databaseId());
-    QString ins = database.driver()->sqlStatement(QSqlDriver::InsertStatement, tableName(), record, false);
+    QString ins = database.driver()->sqlStatement(QSqlDriver::InsertStatement, tableName(), record, true);
     if (Q_UNLIKELY(ins.isEmpty())) {
         sqlError = QSqlError(QLatin1String("No fields to insert"),
                              QString(), QSqlError::StatementError);
@@ -150,20 +151,33 @@ bool TSqlObject::create()
         return false;
     }
 
-    TSqlQuery query(database);
-    bool ret = query.exec(ins);
-    sqlError = query.lastError();
+    QSharedPointer<TSqlQuery> query = TSqlStatementCache::prepare(database, ins, &sqlError);
+    if (Q_UNLIKELY(!query)) {
+        return false;
+    }
+
+    int pos = 0;
+    for (int i = 0; i < record.count(); ++i) {
+        if (record.isGenerated(i)) {
+            query->bind(pos++, record.value(i));
+        }
+    }
+
+    bool ret = query->exec();
+    sqlError = query->lastError();
+    QVariant lastid = (ret && autoValueIndex() >= 0) ? query->lastInsertId() : QVariant();
+    query->finish();
+
     if (Q_LIKELY(ret)) {
         // Gets the last inserted value of auto-value field
         if (autoValueIndex() >= 0) {
-            QVariant lastid = query.lastInsertId();
-
             if (!lastid.isValid() && database.driverName().toUpper() == QLatin1String("QPSQL")) {
                 // For PostgreSQL without OIDS
-                ret = query.exec("SELECT LASTVAL()");
-                sqlError = query.lastError();
+                TSqlQuery lastvalQuery(database);
+                ret = lastvalQuery.exec("SELECT LASTVAL()");
+                sqlError = lastvalQuery.lastError();
                 if (Q_LIKELY(ret)) {
-                    lastid = query.getNextValue();
+                    lastid = lastvalQuery.getNextValue();
                 }
             }
 
@@ -190,6 +204,7 @@ bool TSqlObject::update()
 
     QSqlDatabase &database = Tf::currentSqlDatabase(databaseId());
     QString where(" WHERE ");
+    QVariantList whereValues;
 
     // Updates the value of 'updated_at' or 'modified_at' property
     bool updflag = false;
@@ -218,8 +233,8 @@ bool TSqlObject::update()
             revIndex = i;
 
             where.append(QLatin1String(propName));
-            where.append("=").append(TSqlQuery::formatValue(oldRevision, database));
-            where.append(" AND ");
+            where.append(QLatin1String("=? AND "));
+            whereValues << oldRevision;
         } else {
             // continue
         }
@@ -240,19 +255,20 @@ bool TSqlObject::update()
 
     QVariant origpkval = value(pkName);
     where.append(QLatin1String(pkName));
-    where.append("=").append(TSqlQuery::formatValue(origpkval, database));
+    where.append(QLatin1String("=?"));
+    whereValues << origpkval;
     // Restore the value of primary key
     QObject::setProperty(pkName, origpkval);
 
+    QVariantList values;
     for (int i = metaObject()->propertyOffset(); i < metaObject()->propertyCount(); ++i) {
         const char *propName = metaObject()->property(i).name();
         QVariant newval = QObject::property(propName);
         QVariant recval = QSqlRecord::value(QLatin1String(propName));
         if (i != pkidx && recval.isValid() && recval != newval) {
             upd.append(QLatin1String(propName));
-            upd.append(QLatin1Char('='));
-            upd.append(TSqlQuery::formatValue(newval, database));
-            upd.append(QLatin1String(", "));
+            upd.append(QLatin1String("=?, "));
+            values << newval;
         }
     }
 
@@ -264,13 +280,25 @@ bool TSqlObject::update()
     upd.chop(2);
     syncToSqlRecord();
     upd.append(where);
+    values << whereValues;
+
+    QSharedPointer<TSqlQuery> query = TSqlStatementCache::prepare(database, upd, &sqlError);
+    if (Q_UNLIKELY(!query)) {
+        return false;
+    }
+
+    for (int i = 0; i < values.count(); ++i) {
+        query->bind(i, values[i]);
+    }
+
+    bool ret = query->exec();
+    sqlError = query->lastError();
+    int affected = (ret) ? query->numRowsAffected() : -1;
+    query->finish();
 
-    TSqlQuery query(database);
-    bool ret = query.exec(upd);
-    sqlError = query.lastError();
     if (ret) {
         // Optimistic lock check
-        if (revIndex >= 0 && query.numRowsAffected() != 1) {
+        if (revIndex >= 0 && affected != 1) {
             QString msg = QString("Row was updated or deleted from table ") + tableName() + QLatin1String(" by another transaction");
             sqlError = QSqlError(msg, QString(), QSqlError::UnknownError);
             throw SqlException(msg, __FILE__, __LINE__);
@@ -301,6 +329,7 @@ bool TSqlObject::remove()
 
     del.append(" WHERE ");
     int revIndex = -1;
+    QVariantList values;
 
     for (int i = metaObject()->propertyOffset(); i < metaObject()->propertyCount(); ++i) {
         const char *propName = metaObject()->property(i).name();
@@ -318,8 +347,8 @@ bool TSqlObject::remove()
             }
 
             del.append(QLatin1String(propName));
-            del.append("=").append(TSqlQuery::formatValue(revision, database));
-            del.append(" AND ");
+            del.append(QLatin1String("=? AND "));
+            values << revision;
 
             revIndex = i;
             break;
@@ -334,14 +363,26 @@ bool TSqlObject::remove()
         return false;
     }
     del.append(QLatin1String(pkName));
-    del.append("=").append(TSqlQuery::formatValue(value(pkName), database));
+    del.append(QLatin1String("=?"));
+    values << value(pkName);
+
+    QSharedPointer<TSqlQuery> query = TSqlStatementCache::prepare(database, del, &sqlError);
+    if (Q_UNLIKELY(!query)) {
+        return false;
+    }
+
+    for (int i = 0; i < values.count(); ++i) {
+        query->bind(i, values[i]);
+    }
+
+    bool ret = query->exec();
+    sqlError = query->lastError();
+    int affected = (ret) ? query->numRowsAffected() : -1;
+    query->finish();
 
-    TSqlQuery query(database);
-    bool ret = query.exec(del);
-    sqlError = query.lastError();
     if (ret) {
         // Optimistic lock check
-        if (query.numRowsAffected() != 1) {
+        if (affected != 1) {
             if (revIndex >= 0) {
                 QString msg = QString("Row was updated or deleted from table ") + tableName() + QLatin1String(" by another transaction");
                 sqlError = QSqlError(msg, QString(), QSqlError::UnknownError);
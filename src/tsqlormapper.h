@@ -4,11 +4,13 @@
 #include <QtSql>
 #include <QList>
 #include <QMap>
+#include <QSet>
 #include <TGlobal>
 #include <TSqlObject>
 #include <TCriteria>
 #include <TCriteriaConverter>
 #include <TSqlQuery>
+#include "tsqlstatementcache.h"
 #include "tsystemglobal.h"
 
 /*!
@@ -51,6 +53,9 @@ public:
     QList<T> findAllIn(int column, const QVariantList &values);
     int updateAll(const TCriteria &cri, int column, QVariant value);
     int updateAll(const TCriteria &cri, const QMap<int, QVariant> &values);
+    int updateAll(const QList<T> &objects);
+    int insertAll(const QList<T> &objects);
+    int upsertAll(const QList<T> &objects);
     int removeAll(const TCriteria &cri = TCriteria());
 
 protected:
@@ -61,7 +66,30 @@ protected:
     virtual QString selectStatement() const;
     virtual int rowCount(const QModelIndex &parent) const;
 
+    enum WriteMode {
+        Insert,
+        Upsert,
+    };
+
+    QString writeStatement(const QStringList &columns, int rows, WriteMode mode) const;
+    QString updateStatement(const QStringList &columns) const;
+    QStringList columnNames(bool withAutoValue, bool withPrimaryKey) const;
+
 private:
+    template <class S> friend class TSqlORMapperCursor;
+
+    enum {
+        MaxBindValuesPerStatement = 999,  // limit of SQLite
+        MaxRowsPerStatement = 500,
+    };
+
+    QString incrementedRevision(const QString &column) const;
+    int execute(const QString &statement, const QVariantList &values);
+    int writeAll(const QList<T> &objects, WriteMode mode);
+    int writeEach(const QList<T> &objects, WriteMode mode);
+    static bool hasDuplicateKey(const QList<T> &objects, int from, int count, const QString &pkName);
+    static QVariant columnValue(const T &object, const QString &column, const QVariant &now);
+
     Q_DISABLE_COPY(TSqlORMapper)
 
     QString queryFilter;
@@ -322,17 +350,29 @@ inline int TSqlORMapper<T>::findCount(const TCriteria &cri)
     QString query = "SELECT COUNT(1) FROM ";
     query += tableName();
 
+    QVariantList values;
     if (!cri.isEmpty()) {
         TCriteriaConverter<T> conv(cri, database());
-        query.append(QLatin1String(" WHERE ")).append(conv.toString());
+        QString where = conv.toParameterizedString(values);
+        if (!where.isEmpty()) {
+            query.append(QLatin1String(" WHERE ")).append(where);
+        }
     }
 
-    TSqlQuery q(database());
-    bool res = q.exec(query);
-    if (res) {
-        q.next();
-        cnt = q.value(0).toInt();
+    QSqlDatabase db = database();
+    QSqlError error;
+    QSharedPointer<TSqlQuery> q = TSqlStatementCache::prepare(db, query, &error);
+    if (!q) {
+        return cnt;
     }
+
+    for (int i = 0; i < values.count(); ++i) {
+        q->bind(i, values[i]);
+    }
+    if (q->exec() && q->next()) {
+        cnt = q->value(0).toInt();
+    }
+    q->finish();
     return cnt;
 }
 
@@ -348,7 +388,9 @@ inline int TSqlORMapper<T>::findCountBy(int column, QVariant value)
 
 /*!
   Returns a list of all ORM objects in the results retrieved with the
-  criteria \a cri from the table.
+  criteria \a cri from the table. To process a large number of rows,
+  use TSqlORMapperCursor, which does not buffer the results.
+  \sa TSqlORMapperCursor
 */
 template <class T>
 inline QList<T> TSqlORMapper<T>::findAll(const TCriteria &cri)
@@ -412,22 +454,23 @@ int TSqlORMapper<T>::updateAll(const TCriteria &cri, const QMap<int, QVariant> &
     upd.append(QLatin1String("UPDATE ")).append(tableName()).append(QLatin1String(" SET "));
 
     TCriteriaConverter<T> conv(cri, database());
-    QString where = conv.toString();
+    QVariantList bindValues;
+    QString where = conv.toParameterizedString(bindValues);
 
     if (values.isEmpty()) {
         tSystemError("Update Parameter Error");
         return -1;
     }
 
+    QVariantList setValues;
     T obj;
     for (int i = obj.metaObject()->propertyOffset(); i < obj.metaObject()->propertyCount(); ++i) {
         const char *propName = obj.metaObject()->property(i).name();
         QByteArray prop = QByteArray(propName).toLower();
         if (prop == UpdatedAt || prop == ModifiedAt) {
             upd += propName;
-            upd += '=';
-            upd += TSqlQuery::formatValue(QDateTime::currentDateTime(), database());
-            upd += QLatin1String(", ");
+            upd += QLatin1String("=?, ");
+            setValues << QDateTime::currentDateTime();
             break;
         }
     }
@@ -436,8 +479,8 @@ int TSqlORMapper<T>::updateAll(const TCriteria &cri, const QMap<int, QVariant> &
     for (;;) {
         it.next();
         upd += TCriteriaConverter<T>::propertyName(it.key());
-        upd += '=';
-        upd += TSqlQuery::formatValue(it.value(), database());
+        upd += QLatin1String("=?");
+        setValues << it.value();
 
         if (!it.hasNext())
             break;
@@ -448,10 +491,7 @@ int TSqlORMapper<T>::updateAll(const TCriteria &cri, const QMap<int, QVariant> &
     if (!where.isEmpty()) {
         upd.append(QLatin1String(" WHERE ")).append(where);
     }
-
-    TSqlQuery sqlQuery(database());
-    bool res = sqlQuery.exec(upd);
-    return res ? sqlQuery.numRowsAffected() : -1;
+    return execute(upd, setValues + bindValues);
 }
 
 /*!
@@ -466,6 +506,120 @@ inline int TSqlORMapper<T>::updateAll(const TCriteria &cri, int column, QVariant
     return updateAll(cri, map);
 }
 
+/*!
+  Updates the rows that have the primary keys of the \a objects with the
+  values of their properties, and returns the number of the rows
+  affected, or -1 if an error occurred. One prepared statement is
+  executed for all the objects, as a batch if the driver supports it;
+  in that case the number of the objects is returned. The created_at of
+  the rows is kept, and their lock_revision is incremented; the rows are
+  not checked by optimistic locking.
+*/
+template <class T>
+inline int TSqlORMapper<T>::updateAll(const QList<T> &objects)
+{
+    if (objects.isEmpty()) {
+        return 0;
+    }
+
+    QString pkName = TCriteriaConverter<T>::propertyName(T().primaryKeyIndex());
+    if (pkName.isEmpty()) {
+        tSystemError("Primary key not found, table name: %s", qPrintable(tableName()));
+        return -1;
+    }
+
+    QSqlDatabase db = database();
+    QStringList columns;
+    QStringList names = columnNames(true, false);
+    for (int i = 0; i < names.count(); ++i) {
+        QString col = names[i].toLower();
+        if (col != QLatin1String("created_at") && col != QLatin1String("lock_revision")) {
+            columns << names[i];
+        }
+    }
+
+    QSqlError error;
+    QSharedPointer<TSqlQuery> query = TSqlStatementCache::prepare(db, updateStatement(names), &error);
+    if (!query) {
+        return -1;
+    }
+
+    // Updating values
+    QVariant now = QDateTime::currentDateTime();
+    QList<QVariantList> values;
+    for (int i = 0; i <= columns.count(); ++i) {
+        values << QVariantList();
+    }
+
+    for (typename QList<T>::const_iterator it = objects.constBegin(); it != objects.constEnd(); ++it) {
+        for (int i = 0; i < columns.count(); ++i) {
+            QVariant val;
+            QByteArray col = columns[i].toLower().toLatin1();
+            if (col == "updated_at" || col == "modified_at") {
+                val = now;
+            } else {
+                val = it->property(columns[i].toLatin1().constData());
+            }
+            values[i] << val;
+        }
+        values[columns.count()] << it->property(pkName.toLatin1().constData());
+    }
+
+    int affected = 0;
+    bool ret = true;
+    if (db.driver()->hasFeature(QSqlDriver::BatchOperations)) {
+        for (int i = 0; i < values.count(); ++i) {
+            query->bind(i, values[i]);
+        }
+        ret = query->execBatch();
+        tWriteQueryLog(query->lastQuery(), ret, query->lastError());
+        affected = objects.count();
+    } else {
+        for (int r = 0; r < objects.count() && ret; ++r) {
+            for (int i = 0; i < values.count(); ++i) {
+                query->bind(i, values[i][r]);
+            }
+            ret = query->exec();
+            affected += query->numRowsAffected();
+        }
+    }
+    query->finish();
+    return (ret) ? affected : -1;
+}
+
+/*!
+  Inserts the rows of the \a objects into the table and returns the
+  number of the rows inserted, or -1 if an error occurred. The rows are
+  inserted in chunks by INSERT statements with multiple rows of VALUES
+  if the database supports them, or by batch execution of a prepared
+  statement otherwise. The values of auto-value fields are not set back
+  to the objects.
+*/
+template <class T>
+inline int TSqlORMapper<T>::insertAll(const QList<T> &objects)
+{
+    return writeAll(objects, Insert);
+}
+
+/*!
+  Inserts the rows of the \a objects into the table, or updates the rows
+  that have the same primary keys as them, and returns the number of the
+  objects written, or -1 if an error occurred. For MySQL, PostgreSQL
+  (9.5 or later) and SQLite (3.24 or later), they are written in chunks
+  by single statements. For other databases, and for a chunk with
+  duplicated primary keys on PostgreSQL, each object is updated as by
+  updateAll(), and inserted if no row is updated. Objects with the same
+  primary key are written in order, so the last one is kept. In either case,
+  the created_at of the existing rows is kept and their lock_revision is
+  incremented. The objects whose auto-value primary key is not set are
+  inserted as new rows.
+*/
+template <class T>
+inline int TSqlORMapper<T>::upsertAll(const QList<T> &objects)
+{
+    return writeAll(objects, Upsert);
+}
+
 /*!
   Removes all rows based on the criteria \a cri from the table and
   returns the number of the rows affected by the query executed.
@@ -476,7 +630,8 @@ inline int TSqlORMapper<T>::removeAll(const TCriteria &cri)
     QString del = database().driver()->sqlStatement(QSqlDriver::DeleteStatement,
                                                     T().tableName(), QSqlRecord(), false);
     TCriteriaConverter<T> conv(cri, database());
-    QString where = conv.toString();
+    QVariantList values;
+    QString where = conv.toParameterizedString(values);
 
     if (del.isEmpty()) {
         tSystemError("Statement Error");
@@ -485,10 +640,375 @@ inline int TSqlORMapper<T>::removeAll(const TCriteria &cri)
     if (!where.isEmpty()) {
         del.append(QLatin1String(" WHERE ")).append(where);
     }
+    return execute(del, values);
+}
 
-    TSqlQuery sqlQuery(database());
-    bool res = sqlQuery.exec(del);
-    return res ? sqlQuery.numRowsAffected() : -1;
+/*!
+  Executes the \a statement prepared with the \a values bound and returns
+  the number of the rows affected, or -1 if an error occurred. This
+  function is for internal use only.
+*/
+template <class T>
+inline int TSqlORMapper<T>::execute(const QString &statement, const QVariantList &values)
+{
+    QSqlDatabase db = database();
+    QSqlError error;
+    QSharedPointer<TSqlQuery> query = TSqlStatementCache::prepare(db, statement, &error);
+    if (!query) {
+        return -1;
+    }
+
+    for (int i = 0; i < values.count(); ++i) {
+        query->bind(i, values[i]);
+    }
+    bool res = query->exec();
+    int affected = (res) ? query->numRowsAffected() : -1;
+    query->finish();
+    return affected;
+}
+
+/*!
+  Writes the \a objects by multi-row statements. This function is for
+  internal use only.
+*/
+template <class T>
+inline int TSqlORMapper<T>::writeAll(const QList<T> &objects, WriteMode mode)
+{
+    if (objects.isEmpty()) {
+        return 0;
+    }
+
+    QSqlDatabase db = database();
+    const QString driver = db.driverName().toUpper();
+    const bool mysql = driver.startsWith(QLatin1String("QMYSQL"));
+    const bool psql = driver.startsWith(QLatin1String("QPSQL"));
+    const bool sqlite = (driver == QLatin1String("QSQLITE"));
+    const bool multiRow = (mysql || psql || sqlite || driver.startsWith(QLatin1String("QDB2")));
+
+    if (!multiRow || (mode == Upsert && !(mysql || psql || sqlite))) {
+        return writeEach(objects, mode);
+    }
+
+    const T proto;
+    QString pkName = TCriteriaConverter<T>::propertyName(proto.primaryKeyIndex());
+    if (mode == Upsert && pkName.isEmpty()) {
+        tSystemError("Primary key not found, table name: %s", qPrintable(tableName()));
+        return -1;
+    }
+
+    if (mode == Upsert && proto.autoValueIndex() >= 0 && proto.autoValueIndex() == proto.primaryKeyIndex()) {
+        // New objects are inserted without the primary key to be generated
+        QList<T> newObjects;
+        QList<T> others;
+        for (QListIterator<T> it(objects); it.hasNext(); ) {
+            const T &obj = it.next();
+            QVariant pk = obj.property(pkName.toLatin1().constData());
+            bool ok;
+            qlonglong id = pk.toLongLong(&ok);
+            if (pk.isNull() || (ok && id == 0)) {
+                newObjects << obj;
+            } else {
+                others << obj;
+            }
+        }
+
+        if (!newObjects.isEmpty()) {
+            int inserted = writeAll(newObjects, Insert);
+            if (inserted < 0) {
+                return -1;
+            }
+            int upserted = writeAll(others, Upsert);
+            return (upserted < 0) ? -1 : inserted + upserted;
+        }
+    }
+
+    QStringList columns = columnNames(mode == Upsert, true);
+    if (columns.isEmpty()) {
+        tSystemError("No fields to insert, table name: %s", qPrintable(tableName()));
+        return -1;
+    }
+
+    const int rowsPerStatement = qBound(1, (int)MaxBindValuesPerStatement / columns.count(), (int)MaxRowsPerStatement);
+    const QVariant now = QDateTime::currentDateTime();
+    int written = 0;
+
+    while (written < objects.count()) {
+        int rows = qMin(rowsPerStatement, objects.count() - written);
+        if (mode == Upsert && psql && hasDuplicateKey(objects, written, rows, pkName)) {
+            // PostgreSQL can not update a row twice in a statement
+            if (writeEach(objects.mid(written, rows), Upsert) < 0) {
+                return -1;
+            }
+            written += rows;
+            continue;
+        }
+
+        QSqlError error;
+        QSharedPointer<TSqlQuery> query = TSqlStatementCache::prepare(db, writeStatement(columns, rows, mode), &error);
+        if (!query) {
+            return -1;
+        }
+
+        int pos = 0;
+        for (int r = 0; r < rows; ++r) {
+            const T &obj = objects[written + r];
+            for (int i = 0; i < columns.count(); ++i) {
+                query->bind(pos++, columnValue(obj, columns[i], now));
+            }
+        }
+
+        bool ret = query->exec();
+        query->finish();
+        if (!ret) {
+            return -1;
+        }
+        written += rows;
+    }
+    return written;
+}
+
+/*!
+  Returns true if two or more of the \a count objects from the index
+  \a from in the \a objects have the same primary key \a pkName. This
+  function is for internal use only.
+*/
+template <class T>
+inline bool TSqlORMapper<T>::hasDuplicateKey(const QList<T> &objects, int from, int count, const QString &pkName)
+{
+    const QByteArray name = pkName.toLatin1();
+    QSet<QString> keys;
+    for (int i = from; i < from + count; ++i) {
+        QString key = objects[i].property(name.constData()).toString();
+        if (keys.contains(key)) {
+            return true;
+        }
+        keys.insert(key);
+    }
+    return false;
+}
+
+/*!
+  Returns an INSERT statement of the \a columns with \a rows rows of
+  VALUES, which updates the existing rows if \a mode is Upsert. This
+  function is for internal use only.
+*/
+template <class T>
+inline QString TSqlORMapper<T>::writeStatement(const QStringList &columns, int rows, WriteMode mode) const
+{
+    QSqlDatabase db = database();
+    const bool mysql = db.driverName().toUpper().startsWith(QLatin1String("QMYSQL"));
+
+    QString sql = QLatin1String("INSERT INTO ");
+    sql.append(tableName()).append(QLatin1String(" ("));
+    QString rowValues(QLatin1String("("));
+    for (int i = 0; i < columns.count(); ++i) {
+        sql += TSqlQuery::escapeIdentifier(columns[i], QSqlDriver::FieldName, db);
+        sql += QLatin1String(", ");
+        rowValues += QLatin1String("?, ");
+    }
+    sql.chop(2);
+    sql += QLatin1String(") VALUES ");
+    rowValues.chop(2);
+    rowValues += QLatin1Char(')');
+
+    sql.reserve(sql.length() + (rowValues.length() + 2) * rows + 256);
+    for (int r = 0; r < rows; ++r) {
+        sql += rowValues;
+        sql += QLatin1String(", ");
+    }
+    sql.chop(2);
+
+    if (mode == Upsert) {
+        QString pkName = TCriteriaConverter<T>::propertyName(T().primaryKeyIndex());
+        sql += (mysql) ? QLatin1String(" ON DUPLICATE KEY UPDATE ")
+            : QLatin1String(" ON CONFLICT (") + TSqlQuery::escapeIdentifier(pkName, QSqlDriver::FieldName, db) + QLatin1String(") DO UPDATE SET ");
+        for (int i = 0; i < columns.count(); ++i) {
+            QString col = columns[i].toLower();
+            if (col == pkName.toLower() || col == QLatin1String("created_at")) {
+                continue;
+            }
+
+            QString name = TSqlQuery::escapeIdentifier(columns[i], QSqlDriver::FieldName, db);
+            if (col == QLatin1String("lock_revision")) {
+                sql += incrementedRevision(columns[i]);
+            } else {
+                sql += name + QLatin1Char('=');
+                sql += (mysql) ? QLatin1String("VALUES(") + name + QLatin1Char(')') : QLatin1String("EXCLUDED.") + name;
+            }
+            sql += QLatin1String(", ");
+        }
+        sql.chop(2);
+    }
+    return sql;
+}
+
+/*!
+  Returns an UPDATE statement of the \a columns for a row of a primary
+  key, whose values are to be bound in that order except created_at and
+  lock_revision. This function is for internal use only.
+*/
+template <class T>
+inline QString TSqlORMapper<T>::updateStatement(const QStringList &columns) const
+{
+    QSqlDatabase db = database();
+    QString pkName = TCriteriaConverter<T>::propertyName(T().primaryKeyIndex());
+    QString upd;
+    upd.reserve(256);
+    upd.append(QLatin1String("UPDATE ")).append(tableName()).append(QLatin1String(" SET "));
+    QString revision;
+    for (int i = 0; i < columns.count(); ++i) {
+        QString col = columns[i].toLower();
+        if (col == QLatin1String("created_at")) {
+            continue;
+        } else if (col == QLatin1String("lock_revision")) {
+            revision = incrementedRevision(columns[i]);
+        } else {
+            upd += TSqlQuery::escapeIdentifier(columns[i], QSqlDriver::FieldName, db);
+            upd += QLatin1String("=?, ");
+        }
+    }
+    if (!revision.isEmpty()) {
+        upd += revision;
+    } else {
+        upd.chop(2);
+    }
+    upd.append(QLatin1String(" WHERE ")).append(TSqlQuery::escapeIdentifier(pkName, QSqlDriver::FieldName, db));
+    upd.append(QLatin1String("=?"));
+    return upd;
+}
+
+/*!
+  Returns the assignment that increments the lock revision \a column of
+  the row, the same for all the databases. This function is for internal
+  use only.
+*/
+template <class T>
+inline QString TSqlORMapper<T>::incrementedRevision(const QString &column) const
+{
+    QString name = TSqlQuery::escapeIdentifier(column, QSqlDriver::FieldName, database());
+    return name + QLatin1Char('=') + tableName() + QLatin1Char('.') + name + QLatin1String("+1");
+}
+
+/*!
+  Writes the \a objects one by one with prepared statements. This function
+  is for internal use only.
+*/
+template <class T>
+inline int TSqlORMapper<T>::writeEach(const QList<T> &objects, WriteMode mode)
+{
+    QSqlDatabase db = database();
+    QStringList columns = columnNames(mode == Upsert, true);
+    if (columns.isEmpty()) {
+        tSystemError("No fields to insert, table name: %s", qPrintable(tableName()));
+        return -1;
+    }
+
+    QString ins = QLatin1String("INSERT INTO ") + tableName() + QLatin1String(" (");
+    QString vals;
+    for (int i = 0; i < columns.count(); ++i) {
+        ins += TSqlQuery::escapeIdentifier(columns[i], QSqlDriver::FieldName, db);
+        ins += QLatin1String(", ");
+        vals += QLatin1String("?, ");
+    }
+    ins.chop(2);
+    vals.chop(2);
+    ins += QLatin1String(") VALUES (") + vals + QLatin1Char(')');
+
+    QSqlError error;
+    QSharedPointer<TSqlQuery> insQuery = TSqlStatementCache::prepare(db, ins, &error);
+    if (!insQuery) {
+        return -1;
+    }
+
+    const QVariant now = QDateTime::currentDateTime();
+    if (mode == Insert) {
+        // Batch execution by columns
+        for (int start = 0; start < objects.count(); start += MaxRowsPerStatement) {
+            int rows = qMin((int)MaxRowsPerStatement, objects.count() - start);
+            for (int i = 0; i < columns.count(); ++i) {
+                QVariantList list;
+                for (int r = 0; r < rows; ++r) {
+                    list << columnValue(objects[start + r], columns[i], now);
+                }
+                insQuery->bind(i, list);
+            }
+
+            bool ret = insQuery->execBatch();
+            tWriteQueryLog(insQuery->lastQuery(), ret, insQuery->lastError());
+            insQuery->finish();
+            if (!ret) {
+                return -1;
+            }
+        }
+        return objects.count();
+    }
+
+    // Upsert; updates it, and inserts it if not updated
+    for (typename QList<T>::const_iterator it = objects.constBegin(); it != objects.constEnd(); ++it) {
+        QList<T> one;
+        one << *it;
+        int cnt = updateAll(one);
+        if (cnt < 0) {
+            return -1;
+        }
+
+        if (cnt == 0) {
+            for (int i = 0; i < columns.count(); ++i) {
+                insQuery->bind(i, columnValue(*it, columns[i], now));
+            }
+            bool ret = insQuery->exec();
+            insQuery->finish();
+            if (!ret) {
+                return -1;
+            }
+        }
+    }
+    return objects.count();
+}
+
+/*!
+  Returns the names of the columns to write. This function is for
+  internal use only.
+*/
+template <class T>
+inline QStringList TSqlORMapper<T>::columnNames(bool withAutoValue, bool withPrimaryKey) const
+{
+    QStringList columns;
+    T obj;
+    const QMetaObject *metaObject = obj.metaObject();
+    QSqlRecord rec = database().record(obj.tableName());
+    int autoValIdx = (obj.autoValueIndex() >= 0) ? metaObject->propertyOffset() + obj.autoValueIndex() : -1;
+    int pkIdx = (obj.primaryKeyIndex() >= 0) ? metaObject->propertyOffset() + obj.primaryKeyIndex() : -1;
+
+    for (int i = metaObject->propertyOffset(); i < metaObject->propertyCount(); ++i) {
+        if ((!withAutoValue && i == autoValIdx) || (!withPrimaryKey && i == pkIdx)) {
+            continue;
+        }
+
+        QString name = QLatin1String(metaObject->property(i).name());
+        if (rec.indexOf(name) >= 0) {
+            columns << name;
+        } else {
+            tWarn("invalid name: %s", qPrintable(name));
+        }
+    }
+    return columns;
+}
+
+/*!
+  Returns the value of the \a column to insert for the \a object.
+  This function is for internal use only.
+*/
+template <class T>
+inline QVariant TSqlORMapper<T>::columnValue(const T &object, const QString &column, const QVariant &now)
+{
+    QByteArray col = column.toLower().toLatin1();
+    if (col == "created_at" || col == "updated_at" || col == "modified_at") {
+        return now;
+    } else if (col == "lock_revision") {
+        return 1;  // default value
+    }
+    return object.property(column.toLatin1().constData());
 }
 
 /*!
@@ -0,0 +1,61 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <TSqlORMapperCursor>
+
+/*!
+  \class TSqlORMapperCursor
+  \brief The TSqlORMapperCursor class provides a forward-only cursor
+         over the results retrieved by TSqlORMapper.
+
+  Unlike TSqlORMapper::find() and findAll(), the results are not
+  buffered in the model. The query is executed in forward-only mode,
+  so drivers which support it fetch rows from the server one by one,
+  and each ORM object is built from the current row with the properties
+  resolved once per query. It is suitable for processing a large number
+  of rows.
+  \code
+    TSqlORMapper<Blog> mapper;
+    mapper.setSortOrder(Blog::Id, Tf::AscendingOrder);
+    TSqlORMapperCursor<Blog> cursor(mapper, cri);
+    while (cursor.next()) {
+        Blog blog = cursor.value();
+        ...
+    }
+  \endcode
+  The limit, offset and sort order set to the mapper are applied.
+  \sa TSqlORMapper
+*/
+
+/*!
+  \fn TSqlORMapperCursor<T>::TSqlORMapperCursor(TSqlORMapper<T> &mapper, const TCriteria &cri)
+  Constructor. Executes a query of the \a mapper with the criteria
+  \a cri. The filter of the \a mapper is left unchanged.
+*/
+
+/*!
+  \fn bool TSqlORMapperCursor<T>::isActive() const
+  Returns true if the query has been executed successfully; otherwise
+  returns false.
+*/
+
+/*!
+  \fn bool TSqlORMapperCursor<T>::next()
+  Advances the cursor to the next row. Returns true if the row is
+  available; otherwise returns false. The previous row can not be
+  retrieved again.
+*/
+
+/*!
+  \fn T TSqlORMapperCursor<T>::value() const
+  Returns the ORM object of the current row.
+*/
+
+/*!
+  \fn QSqlError TSqlORMapperCursor<T>::lastError() const
+  Returns information about the last error of the query.
+*/
@@ -0,0 +1,91 @@
+#ifndef TSQLORMAPPERCURSOR_H
+#define TSQLORMAPPERCURSOR_H
+
+#include <QVector>
+#include <QMetaProperty>
+#include <TSqlORMapper>
+
+
+template <class T>
+class TSqlORMapperCursor
+{
+public:
+    TSqlORMapperCursor(TSqlORMapper<T> &mapper, const TCriteria &cri = TCriteria());
+
+    bool isActive() const { return query.isActive(); }
+    bool next();
+    T value() const;
+    QSqlError lastError() const { return query.lastError(); }
+
+private:
+    TSqlORMapperCursor(const TSqlORMapperCursor<T> &);
+    TSqlORMapperCursor<T> &operator=(const TSqlORMapperCursor<T> &);
+
+    TSqlQuery query;
+    QSqlRecord fields;
+    QVector<int> properties;  // property index for each column
+};
+
+
+template <class T>
+inline TSqlORMapperCursor<T>::TSqlORMapperCursor(TSqlORMapper<T> &mapper, const TCriteria &cri)
+    : query(mapper.database())
+{
+    // The clause with placeholders is only for this statement; the
+    // mapper's filter is restored after it is built
+    const QString filter = mapper.queryFilter;
+    QVariantList values;
+    if (!cri.isEmpty()) {
+        TCriteriaConverter<T> conv(cri, mapper.database());
+        mapper.setFilter(conv.toParameterizedString(values));
+    } else {
+        mapper.setFilter(QString());
+    }
+    const QString statement = mapper.selectStatement();
+    mapper.setFilter(filter);
+
+    query.setForwardOnly(true);
+    query.prepare(statement);
+    for (int i = 0; i < values.count(); ++i) {
+        query.bind(i, values[i]);
+    }
+    if (!query.exec()) {
+        return;
+    }
+
+    // Resolves the properties of the columns
+    const QMetaObject *metaObject = &T::staticMetaObject;
+    fields = query.record();
+    properties.resize(fields.count());
+    for (int i = 0; i < fields.count(); ++i) {
+        int index = metaObject->indexOfProperty(fields.fieldName(i).toLatin1().constData());
+        properties[i] = (index >= metaObject->propertyOffset()) ? index : -1;
+    }
+}
+
+
+template <class T>
+inline bool TSqlORMapperCursor<T>::next()
+{
+    return query.isActive() && query.next();
+}
+
+
+template <class T>
+inline T TSqlORMapperCursor<T>::value() const
+{
+    T obj;
+    QSqlRecord &rec = obj;
+    rec = fields;
+
+    for (int i = 0; i < properties.count(); ++i) {
+        QVariant val = query.value(i);
+        rec.setValue(i, val);
+        if (properties[i] >= 0) {
+            T::staticMetaObject.property(properties[i]).write(&obj, val);
+        }
+    }
+    return obj;
+}
+
+#endif // TSQLORMAPPERCURSOR_H
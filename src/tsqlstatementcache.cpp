@@ -0,0 +1,106 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <TSqlQuery>
+#include "tsqlstatementcache.h"
+#include "tsystemglobal.h"
+
+const int MaxStatementsPerConnection = 128;
+
+struct CachedStatement
+{
+    QSharedPointer<TSqlQuery> query;
+    quint64 lastUsed;
+};
+
+typedef QHash<QString, CachedStatement> StatementHash;
+static QHash<QString, StatementHash> statementCache;  // by connection name
+static quint64 useCounter = 0;
+static QMutex cacheMutex;
+
+
+/*!
+  \class TSqlStatementCache
+  \brief The TSqlStatementCache class caches prepared statements for each
+  database connection.
+
+  A pooled connection is used by one thread at a time, so a query returned
+  by prepare() can be executed without locking until the connection is
+  pooled again. When a connection has too many statements, the least
+  recently used one is removed from the cache; the query stays valid as
+  long as a caller holds it. The statements of a connection must be
+  cleared by clear() before the connection is closed.
+*/
+
+/*!
+  Returns the query prepared with the SQL \a statement on the
+  \a database. The query is prepared when it is first requested on the
+  connection, and reused after that. Returns a null pointer and sets
+  \a error if the statement can not be prepared.
+ */
+QSharedPointer<TSqlQuery> TSqlStatementCache::prepare(QSqlDatabase &database, const QString &statement, QSqlError *error)
+{
+    const QString connectionName = database.connectionName();
+    {
+        QMutexLocker locker(&cacheMutex);
+        StatementHash &hash = statementCache[connectionName];
+        StatementHash::iterator it = hash.find(statement);
+        if (it != hash.end()) {
+            it->lastUsed = ++useCounter;
+            return it->query;
+        }
+    }
+
+    QSharedPointer<TSqlQuery> query(new TSqlQuery(database));
+    if (!query->QSqlQuery::prepare(statement)) {
+        if (error) {
+            *error = query->lastError();
+        }
+        tWriteQueryLog(statement, false, query->lastError());
+        return QSharedPointer<TSqlQuery>();
+    }
+
+    QMutexLocker locker(&cacheMutex);
+    StatementHash &hash = statementCache[connectionName];
+    if (hash.count() >= MaxStatementsPerConnection && !hash.contains(statement)) {
+        // Removes the least recently used one; a query held by a caller
+        // is deleted when it is released
+        StatementHash::iterator lru = hash.begin();
+        for (StatementHash::iterator it = hash.begin(); it != hash.end(); ++it) {
+            if (it->lastUsed < lru->lastUsed) {
+                lru = it;
+            }
+        }
+        hash.erase(lru);
+    }
+
+    CachedStatement &cached = hash[statement];
+    cached.query = query;
+    cached.lastUsed = ++useCounter;
+    return query;
+}
+
+/*!
+  Clears the prepared statements of the connection \a connectionName.
+ */
+void TSqlStatementCache::clear(const QString &connectionName)
+{
+    QMutexLocker locker(&cacheMutex);
+    statementCache.remove(connectionName);
+}
+
+/*!
+  Clears the prepared statements of all connections.
+ */
+void TSqlStatementCache::clearAll()
+{
+    QMutexLocker locker(&cacheMutex);
+    statementCache.clear();
+}
@@ -0,0 +1,20 @@
+#ifndef TSQLSTATEMENTCACHE_H
+#define TSQLSTATEMENTCACHE_H
+
+#include <QString>
+#include <QSqlDatabase>
+#include <QSharedPointer>
+#include <TGlobal>
+
+class TSqlQuery;
+
+
+class T_CORE_EXPORT TSqlStatementCache
+{
+public:
+    static QSharedPointer<TSqlQuery> prepare(QSqlDatabase &database, const QString &statement, QSqlError *error);
+    static void clear(const QString &connectionName);
+    static void clearAll();
+};
+
+#endif // TSQLSTATEMENTCACHE_H
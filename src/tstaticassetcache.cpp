@@ -0,0 +1,413 @@
+/* Copyright (c) 2015, AOYAMA Kazuharu
+ * All rights reserved.
+ *
+ * This software may be used and distributed according to the terms of
+ * the New BSD License, which is incorporated herein by reference.
+ */
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <TWebApplication>
+#include <TAppSettings>
+#include <THttpRequestHeader>
+#include <THttpResponseHeader>
+#include <THttpUtility>
+#include "tstaticassetcache.h"
+#include "thttpcompressor.h"
+#include "tsystemglobal.h"
+
+/*!
+  \class TStaticAsset
+  \brief The TStaticAsset class holds a file in the public directory
+  with its response headers resolved in advance.
+*/
+
+/*!
+  \class TStaticAssetCache
+  \brief The TStaticAssetCache class caches the files in the public
+  directory, which are served when no controller handles a request.
+
+  A cached asset keeps the media type, Last-Modified date and ETag of
+  the file, and its contents if it is small enough to fit in the memory
+  budget given by StaticFileCacheSize in application.ini. Precompressed
+  siblings, \a file.br and \a file.gz, are served to clients accepting
+  those encodings. If HttpCompression.Enabled is true, a file held in
+  memory without the .gz sibling is compressed once when loaded. An
+  asset is checked against the file system at most once a second and
+  reloaded when the file has changed.
+
+  The epoll threads of the hybrid MPM serve cached assets by findCached()
+  without accessing the file system, while revalidate() checks all the
+  cached assets every second in another thread. So a file changed on
+  disk can be served as the old content for up to MaxStaleSecs (two)
+  seconds before it is reloaded by a worker.
+*/
+
+static const struct {
+    const char *encoding;
+    const char *suffix;
+} encodings[] = {
+    { "br", ".br" },
+    { "gzip", ".gz" },
+};
+
+
+static inline uint loadTime(const QAtomicInt &time)
+{
+#if QT_VERSION >= 0x050000
+    return (uint)time.loadAcquire();
+#else
+    return (uint)(int)time;
+#endif
+}
+
+
+static inline void storeTime(QAtomicInt &time, uint value)
+{
+#if QT_VERSION >= 0x050000
+    time.storeRelease((int)value);
+#else
+    time = (int)value;
+#endif
+}
+
+
+/*!
+  Returns the content to send to a client which accepts the encodings
+  \a acceptEncoding.
+*/
+const TStaticAsset::Content &TStaticAsset::content(const QByteArray &acceptEncoding) const
+{
+    if (!acceptEncoding.isEmpty()) {
+        for (QListIterator<Content> it(encoded); it.hasNext(); ) {
+            const Content &c = it.next();
+            if (THttpCompressor::acceptsEncoding(acceptEncoding, c.encoding)) {
+                return c;
+            }
+        }
+    }
+    return identity;
+}
+
+/*!
+  Returns false if the conditional headers of the request \a header
+  show that the client has the \a content already; otherwise returns
+  true.
+*/
+bool TStaticAsset::isModified(const THttpRequestHeader &header, const Content &content) const
+{
+    QByteArray ifNoneMatch = header.rawHeader("If-None-Match");
+    if (!ifNoneMatch.isEmpty()) {
+        return !(ifNoneMatch.trimmed() == "*" || ifNoneMatch.contains(content.etag));
+    }
+
+    QByteArray ifModifiedSince = header.rawHeader("If-Modified-Since");
+    if (!ifModifiedSince.isEmpty()) {
+        QDateTime dt = THttpUtility::fromHttpDateTimeString(ifModifiedSince);
+        return (!dt.isValid() || dt.toTime_t() != lastModified.toTime_t());
+    }
+    return true;
+}
+
+/*!
+  Sets the headers for the \a content to the response header \a header.
+  Content-Encoding is set only if \a withBody is true.
+*/
+void TStaticAsset::setResponseHeader(THttpResponseHeader &header, const Content &content, bool withBody) const
+{
+    header.setRawHeader("Last-Modified", lastModifiedString);
+    header.setRawHeader("ETag", content.etag);
+    if (!encoded.isEmpty()) {
+        header.setRawHeader("Vary", "Accept-Encoding");
+    }
+    if (withBody && !content.encoding.isEmpty()) {
+        header.setRawHeader("Content-Encoding", content.encoding);
+    }
+}
+
+
+TStaticAssetCache::TStaticAssetCache(const QString &rootPath, qint64 maxMemoryBytes, bool compression)
+    : root(rootPath), maxMemory(qMax(maxMemoryBytes, Q_INT64_C(0))), usedMemory(0), compression(compression)
+{
+    if (!root.isEmpty() && !root.endsWith(QLatin1Char('/'))) {
+        root += QLatin1Char('/');
+    }
+}
+
+
+TStaticAssetCache::~TStaticAssetCache()
+{ }
+
+/*!
+  Returns the asset for the \a path relative to the public directory,
+  or a null pointer if there is no such readable file.
+*/
+TStaticAssetCache::AssetPointer TStaticAssetCache::find(const QString &path)
+{
+    const QString cleanPath = normalizePath(path);
+    if (cleanPath.isEmpty()) {
+        return AssetPointer();
+    }
+
+    lock.lockForRead();
+    AssetPointer asset = assets.value(cleanPath);
+    lock.unlock();
+
+    const uint now = currentTime();
+    if (asset && loadTime(asset->checkedAt) == now) {
+        return asset;
+    }
+
+    QFileInfo fi(root + cleanPath);
+    if (asset && isUpToDate(fi, asset.data())) {
+        storeTime(asset->checkedAt, now);
+        return asset;
+    }
+
+    AssetPointer loaded;
+    if (fi.isFile() && fi.isReadable()) {
+        TStaticAsset *a = load(fi.absoluteFilePath());
+        storeTime(a->checkedAt, now);
+        loaded = AssetPointer(a);
+    }
+
+    QWriteLocker locker(&lock);
+    AssetPointer old = assets.take(cleanPath);
+    if (old) {
+        usedMemory -= memorySize(old.data());
+    }
+
+    if (loaded && assets.count() < MaxAssetCount) {
+        qint64 size = memorySize(loaded.data());
+        if (usedMemory + size > maxMemory) {
+            // Sends the files without holding them
+            TStaticAsset *a = const_cast<TStaticAsset *>(loaded.data());
+            a->identity.data = QByteArray();
+            for (QMutableListIterator<TStaticAsset::Content> it(a->encoded); it.hasNext(); ) {
+                TStaticAsset::Content &c = it.next();
+                if (c.filePath.isEmpty()) {
+                    it.remove();  // compressed in memory
+                } else {
+                    c.data = QByteArray();
+                }
+            }
+            size = 0;
+        }
+        usedMemory += size;
+        assets.insert(cleanPath, loaded);
+    }
+    return loaded;
+}
+
+/*!
+  Returns the asset for the \a path if it is in the cache and has been
+  checked against the file system within MaxStaleSecs seconds; otherwise
+  returns a null pointer. Unlike find(), this never accesses the file
+  system, so that it can be called in the epoll threads.
+*/
+TStaticAssetCache::AssetPointer TStaticAssetCache::findCached(const QString &path) const
+{
+    const QString cleanPath = normalizePath(path);
+    if (cleanPath.isEmpty()) {
+        return AssetPointer();
+    }
+
+    lock.lockForRead();
+    AssetPointer asset = assets.value(cleanPath);
+    lock.unlock();
+
+    if (asset && currentTime() - loadTime(asset->checkedAt) <= (uint)MaxStaleSecs) {
+        return asset;
+    }
+    return AssetPointer();
+}
+
+/*!
+  Checks all the cached assets against the file system. An unchanged
+  asset is marked as checked now, and a changed or removed one is
+  discarded so that it is loaded again by find(). This is called
+  periodically outside the request path to keep the assets available
+  to findCached().
+*/
+void TStaticAssetCache::revalidate()
+{
+    lock.lockForRead();
+    QHash<QString, AssetPointer> current = assets;
+    lock.unlock();
+
+    const uint now = currentTime();
+    QList<QPair<QString, AssetPointer> > changed;
+    for (QHashIterator<QString, AssetPointer> it(current); it.hasNext(); ) {
+        it.next();
+        const AssetPointer &asset = it.value();
+        if (loadTime(asset->checkedAt) == now) {
+            continue;
+        }
+
+        if (isUpToDate(QFileInfo(root + it.key()), asset.data())) {
+            storeTime(asset->checkedAt, now);
+        } else {
+            changed << qMakePair(it.key(), asset);
+        }
+    }
+
+    if (!changed.isEmpty()) {
+        QWriteLocker locker(&lock);
+        for (QListIterator<QPair<QString, AssetPointer> > it(changed); it.hasNext(); ) {
+            const QPair<QString, AssetPointer> &p = it.next();
+            if (assets.value(p.first) == p.second) {  // not reloaded meanwhile
+                assets.remove(p.first);
+                usedMemory -= memorySize(p.second.data());
+            }
+        }
+    }
+}
+
+/*!
+  Discards all the assets.
+*/
+void TStaticAssetCache::clear()
+{
+    QWriteLocker locker(&lock);
+    assets.clear();
+    usedMemory = 0;
+}
+
+/*!
+  Returns the number of bytes of the contents held in memory.
+*/
+qint64 TStaticAssetCache::memoryUsage() const
+{
+    QReadLocker locker(&lock);
+    return usedMemory;
+}
+
+/*!
+  Returns the current time in seconds since the epoch.
+*/
+uint TStaticAssetCache::currentTime() const
+{
+    return QDateTime::currentDateTime().toTime_t();
+}
+
+/*!
+  Returns the media type for the file name suffix \a suffix.
+*/
+QByteArray TStaticAssetCache::mediaType(const QString &suffix) const
+{
+    return Tf::app()->internetMediaType(suffix);
+}
+
+
+/*!
+  Returns the \a path cleaned, or an empty string if it points outside
+  the public directory.
+*/
+QString TStaticAssetCache::normalizePath(const QString &path)
+{
+    QString ret = QDir::cleanPath(path);
+    if (ret.startsWith(QLatin1String("..")) || ret.startsWith(QLatin1Char('/'))) {
+        ret.clear();
+    }
+    return ret;
+}
+
+
+/*!
+  Returns true if the file of \a fileInfo is the one the \a asset was
+  loaded from.
+*/
+bool TStaticAssetCache::isUpToDate(const QFileInfo &fileInfo, const TStaticAsset *asset)
+{
+    return fileInfo.isFile() && fileInfo.lastModified() == asset->lastModified && fileInfo.size() == asset->identity.size;
+}
+
+
+TStaticAsset *TStaticAssetCache::load(const QString &filePath) const
+{
+    QFileInfo fi(filePath);
+    TStaticAsset *asset = new TStaticAsset;
+    asset->contentType = mediaType(fi.suffix());
+    asset->lastModified = fi.lastModified();
+    asset->lastModifiedString = THttpUtility::toHttpDateTimeString(asset->lastModified);
+
+    QByteArray tag = QByteArray::number(fi.size(), 16) + '-' + QByteArray::number(asset->lastModified.toTime_t(), 16);
+    asset->identity.filePath = filePath;
+    asset->identity.size = fi.size();
+    asset->identity.etag = '"' + tag + '"';
+
+    for (int i = 0; i < (int)(sizeof(encodings) / sizeof(encodings[0])); ++i) {
+        QFileInfo efi(filePath + QLatin1String(encodings[i].suffix));
+        if (efi.isFile() && efi.isReadable() && efi.lastModified() >= fi.lastModified()) {
+            TStaticAsset::Content c;
+            c.filePath = efi.absoluteFilePath();
+            c.size = efi.size();
+            c.encoding = encodings[i].encoding;
+            c.etag = '"' + tag + '-' + c.encoding + '"';
+            asset->encoded << c;
+        }
+    }
+
+    if (maxMemory > 0) {
+        readContent(asset->identity);
+        bool hasGzip = false;
+        for (QMutableListIterator<TStaticAsset::Content> it(asset->encoded); it.hasNext(); ) {
+            TStaticAsset::Content &c = it.next();
+            readContent(c);
+            hasGzip |= (c.encoding == "gzip");
+        }
+
+        const QByteArray &data = asset->identity.data;
+        if (compression && !hasGzip && !data.isNull() && THttpCompressor::isCompressible(asset->contentType, data.length())) {
+            TStaticAsset::Content c;
+            c.data = THttpCompressor::gzip(data);
+            c.size = c.data.length();
+            c.encoding = "gzip";
+            c.etag = '"' + tag + "-gzip\"";
+            if (c.size > 0 && c.size < data.length()) {
+                asset->encoded << c;
+            }
+        }
+    }
+    return asset;
+}
+
+/*!
+  Reads the file of the \a content into memory if it is small enough.
+*/
+void TStaticAssetCache::readContent(TStaticAsset::Content &content)
+{
+    if (content.size > MaxFileSizeInMemory) {
+        return;
+    }
+
+    QFile file(content.filePath);
+    if (file.open(QIODevice::ReadOnly)) {
+        content.data = file.readAll();
+        if (content.data.length() != content.size) {
+            content.data = QByteArray();  // changed while reading
+        }
+    }
+}
+
+
+qint64 TStaticAssetCache::memorySize(const TStaticAsset *asset)
+{
+    qint64 size = asset->identity.data.length();
+    for (QListIterator<TStaticAsset::Content> it(asset->encoded); it.hasNext(); ) {
+        size += it.next().data.length();
+    }
+    return size;
+}
+
+/*!
+  Returns the cache of the public directory of the application.
+*/
+TStaticAssetCache *TStaticAssetCache::instance()
+{
+    static TStaticAssetCache *cache = new TStaticAssetCache(Tf::app()->publicPath(),
+        Tf::appSettings()->value(Tf::StaticFileCacheSize, 32 * 1024 * 1024).toLongLong(),
+        THttpCompressor::isEnabled());
+    return cache;
+}
@@ -0,0 +1,91 @@
+#ifndef TSTATICASSETCACHE_H
+#define TSTATICASSETCACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <TGlobal>
+
+class QFileInfo;
+class THttpRequestHeader;
+class THttpResponseHeader;
+
+
+class T_CORE_EXPORT TStaticAsset
+{
+public:
+    struct Content
+    {
+        QString filePath;
+        QByteArray data;      // null if not held in memory
+        qint64 size;
+        QByteArray encoding;  // "br", "gzip" or empty
+        QByteArray etag;
+    };
+
+    const Content &content(const QByteArray &acceptEncoding) const;
+    bool isModified(const THttpRequestHeader &header, const Content &content) const;
+    void setResponseHeader(THttpResponseHeader &header, const Content &content, bool withBody) const;
+
+    QByteArray contentType;
+    QDateTime lastModified;
+    QByteArray lastModifiedString;
+    Content identity;
+    QList<Content> encoded;  // precompressed variants
+
+private:
+    TStaticAsset() : checkedAt(0) { }
+    mutable QAtomicInt checkedAt;  // time_t of the last check
+
+    friend class TStaticAssetCache;
+    Q_DISABLE_COPY(TStaticAsset)
+};
+
+
+class T_CORE_EXPORT TStaticAssetCache
+{
+public:
+    typedef QSharedPointer<const TStaticAsset> AssetPointer;
+
+    ~TStaticAssetCache();
+    AssetPointer find(const QString &path);
+    AssetPointer findCached(const QString &path) const;
+    void revalidate();
+    void clear();
+    qint64 memoryUsage() const;
+
+    static TStaticAssetCache *instance();
+
+protected:
+    TStaticAssetCache(const QString &rootPath, qint64 maxMemoryBytes, bool compression = false);
+    virtual uint currentTime() const;
+    virtual QByteArray mediaType(const QString &suffix) const;
+
+private:
+    enum {
+        MaxAssetCount = 10000,
+        MaxFileSizeInMemory = 1024 * 1024,
+        MaxStaleSecs = 2,  // of an asset served by findCached()
+    };
+
+    static QString normalizePath(const QString &path);
+    static bool isUpToDate(const QFileInfo &fileInfo, const TStaticAsset *asset);
+    TStaticAsset *load(const QString &filePath) const;
+    static void readContent(TStaticAsset::Content &content);
+    static qint64 memorySize(const TStaticAsset *asset);
+
+    QString root;
+    qint64 maxMemory;
+    qint64 usedMemory;
+    bool compression;
+    mutable QReadWriteLock lock;
+    QHash<QString, AssetPointer> assets;
+
+    Q_DISABLE_COPY(TStaticAssetCache)
+};
+
+#endif // TSTATICASSETCACHE_H
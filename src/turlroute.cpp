@@ -8,6 +8,8 @@
 #include <QFile>
 #include <QTextStream>
 #include <QHash>
+#include <QVector>
+#include <QVarLengthArray>
 #include <TWebApplication>
 #include <TSystemGlobal>
 #include <THttpUtility>
@@ -33,6 +35,89 @@ public:
 Q_GLOBAL_STATIC(RouteDirectiveHash, directiveHash)
 
 
+/*!
+  The TRouteNode class is a node of the trie compiled from the routes,
+  keyed by path components. This class is for internal use only.
+*/
+class TRouteNode
+{
+public:
+    struct Child {
+        QByteArray key;
+        TRouteNode *node;
+    };
+
+    QVector<Child> children;   // literal components, sorted by key
+    TRouteNode *paramChild;    // ":param"
+    QList<int> routes;         // indexes of routes ending here
+    QList<int> tailRoutes;     // indexes of routes ending with ":params" here
+
+    TRouteNode() : children(), paramChild(0), routes(), tailRoutes() { }
+    ~TRouteNode();
+    TRouteNode *child(const char *key, int length) const;
+    TRouteNode *addChild(const QByteArray &key);
+};
+
+
+TRouteNode::~TRouteNode()
+{
+    for (int i = 0; i < children.count(); ++i) {
+        delete children[i].node;
+    }
+    delete paramChild;
+}
+
+
+static inline int compareKey(const QByteArray &key, const char *data, int length)
+{
+    int cmp = memcmp(key.constData(), data, qMin(key.length(), length));
+    return (cmp != 0) ? cmp : key.length() - length;
+}
+
+
+TRouteNode *TRouteNode::child(const char *key, int length) const
+{
+    // Binary search
+    int lo = 0;
+    int hi = children.count() - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = compareKey(children[mid].key, key, length);
+        if (cmp == 0) {
+            return children[mid].node;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return 0;
+}
+
+
+TRouteNode *TRouteNode::addChild(const QByteArray &key)
+{
+    int i = 0;
+    while (i < children.count()) {
+        int cmp = compareKey(children[i].key, key.constData(), key.length());
+        if (cmp == 0) {
+            return children[i].node;
+        }
+        if (cmp > 0) {
+            break;
+        }
+        ++i;
+    }
+
+    Child c;
+    c.key = key;
+    c.node = new TRouteNode;
+    children.insert(i, c);
+    return c.node;
+}
+
+
 static TUrlRoute *urlRoute = 0;
 
 static void cleanup()
@@ -58,6 +143,17 @@ void TUrlRoute::instantiate()
 }
 
 
+TUrlRoute::TUrlRoute()
+    : routes(), root(new TRouteNode)
+{ }
+
+
+TUrlRoute::~TUrlRoute()
+{
+    delete root;
+}
+
+
 const TUrlRoute &TUrlRoute::instance()
 {
     Q_CHECK_PTR(urlRoute);
@@ -141,6 +237,28 @@ bool TUrlRoute::addRouteFromString(const QString &line)
          return false;
      }
 
+     // Adds to the trie
+     TRouteNode *node = root;
+     for (int i = 0; i < rt.componentList.count(); ++i) {
+         const QString &c = rt.componentList[i];
+         if (c == ":params") {
+             break;
+         } else if (c == ":param") {
+             if (!node->paramChild) {
+                 node->paramChild = new TRouteNode;
+             }
+             node = node->paramChild;
+         } else {
+             node = node->addChild(c.toUtf8());
+         }
+     }
+
+     if (rt.hasVariableParams) {
+         node->tailRoutes << routes.count();
+     } else {
+         node->routes << routes.count();
+     }
+
      routes << rt;
      tSystemDebug("route: method:%d path:%s  ctrl:%s action:%s params:%d",
                   rt.method, qPrintable(QLatin1String("/") + rt.componentList.join("/")), rt.controller.data(),
@@ -149,65 +267,172 @@ bool TUrlRoute::addRouteFromString(const QString &line)
 }
 
 
+/*!
+  Returns the index of the first route matching the \a count path
+  \a segments with the \a method, or -1. \a denied is set to true if
+  the path matches a route of another method.
+*/
+int TUrlRoute::matchRoute(int method, const Segment *segments, int count, bool *denied) const
+{
+    struct Frame {
+        const TRouteNode *node;
+        int depth;
+    };
+
+    int best = -1;
+    QVarLengthArray<Frame, 32> stack;
+    Frame f = { root, 0 };
+    stack.append(f);
+
+    // Searches all the branches; routes have priority by the order
+    while (!stack.isEmpty()) {
+        Frame cur = stack.last();
+        stack.removeLast();
+
+        for (int k = 0; k < 2; ++k) {
+            const QList<int> &indexes = (k == 0) ? cur.node->tailRoutes : cur.node->routes;
+            if (k == 1 && cur.depth != count) {
+                break;
+            }
+
+            for (QListIterator<int> it(indexes); it.hasNext(); ) {
+                int idx = it.next();
+                if (best >= 0 && idx >= best) {
+                    break;  // sorted
+                }
+
+                int m = routes[idx].method;
+                if (m == TRoute::Match || m == method) {
+                    best = idx;
+                    break;
+                }
+                *denied = true;
+            }
+        }
+
+        if (cur.depth < count) {
+            const Segment &seg = segments[cur.depth];
+            const TRouteNode *next = cur.node->child(seg.data, seg.length);
+            if (next) {
+                Frame nf = { next, cur.depth + 1 };
+                stack.append(nf);
+            }
+            if (cur.node->paramChild) {
+                Frame nf = { cur.node->paramChild, cur.depth + 1 };
+                stack.append(nf);
+            }
+        }
+    }
+    return best;
+}
+
+
 TRouting TUrlRoute::findRouting(Tf::HttpMethod method, const QStringList &components) const
 {
-    if (routes.isEmpty()) {
-        TRouting();
+    QVarLengthArray<QByteArray, 16> strings;
+    QVarLengthArray<Segment, 16> segments;
+    for (int i = 0; i < components.count(); ++i) {
+        strings.append(components[i].toUtf8());
+    }
+    for (int i = 0; i < strings.count(); ++i) {
+        Segment seg = { strings[i].constData(), strings[i].length() };
+        segments.append(seg);
     }
 
     bool denied = false;
-    for (QListIterator<TRoute> i(routes); i.hasNext(); ) {
-        const TRoute &rt = i.next();
+    int index = matchRoute(method, segments.constData(), segments.count(), &denied);
+    if (index < 0) {
+        return (denied) ? TRouting("", "") : TRouting() /* Not found routing info */ ;
+    }
 
-        // Too long or short?
-        if (rt.hasVariableParams) {
-            if (components.length() < rt.componentList.length() - 1) {
-                continue;
-            }
-        } else {
-            if (components.length() != rt.componentList.length()) {
-                continue;
-            }
+    const TRoute &rt = routes[index];
+
+    // Generates parameters for action
+    QStringList params = components;
+
+    if (params.count() == 1 && params[0].isEmpty()) {  // means path="/"
+        params.clear();
+    } else {
+        // Erases non-parameters
+        QListIterator<int> it(rt.keywordIndexes);
+        it.toBack();
+        while (it.hasPrevious()) {
+            int idx = it.previous();
+            params.removeAt(idx);
         }
+    }
 
-        for (QListIterator<int> it(rt.keywordIndexes); it.hasNext(); ) {
-            int idx = it.next();
-            if (components.value(idx) != rt.componentList[idx]) {
-                goto continue_next;
-            }
+    return TRouting(rt.controller, rt.action, params);
+}
+
+/*!
+  Finds the routing of the URL-encoded \a path without the query string.
+  This splits the path in place and decodes only the parameters.
+*/
+TRouting TUrlRoute::findRouting(Tf::HttpMethod method, const QByteArray &path) const
+{
+    QByteArray decoded;
+    const char *data = path.constData();
+    int len = path.length();
+
+    if (memchr(data, '%', len) || memchr(data, '+', len)) {
+        decoded = path;
+        decoded.replace('+', ' ');
+        decoded = QByteArray::fromPercentEncoding(decoded);
+        data = decoded.constData();
+        len = decoded.length();
+    }
+
+    // Same as splitPath()
+    int s = (len > 0 && data[0] == '/') ? 1 : 0;
+    if (len > 1 && data[len - 1] == '/') {
+        --len;
+    }
+
+    QVarLengthArray<Segment, 16> segments;
+    const char *p = data + s;
+    const char *end = data + qMax(len, s);
+    for (;;) {
+        const char *slash = (const char *)memchr(p, '/', end - p);
+        const char *e = (slash) ? slash : end;
+        Segment seg = { p, (int)(e - p) };
+        segments.append(seg);
+        if (!slash) {
+            break;
         }
+        p = slash + 1;
+    }
 
-        denied = true;
-
-        if (rt.method == TRoute::Match || rt.method == method) {
-            // Generates parameters for action
-            QStringList params = components;
-
-            if (params.count() == 1 && params[0].isEmpty()) {  // means path="/"
-                params.clear();
-            } else {
-                // Erases non-parameters
-                QListIterator<int> it(rt.keywordIndexes);
-                it.toBack();
-                while (it.hasPrevious()) {
-                    int idx = it.previous();
-                    params.removeAt(idx);
-                }
-            }
+    bool denied = false;
+    int index = matchRoute(method, segments.constData(), segments.count(), &denied);
+    if (index < 0) {
+        return (denied) ? TRouting("", "") : TRouting() /* Not found routing info */ ;
+    }
+
+    const TRoute &rt = routes[index];
+    QStringList params;
 
-            return TRouting(rt.controller, rt.action, params);
+    if (segments.count() > 1 || segments[0].length > 0) {  // not path="/"
+        // Non-keyword components are parameters
+        int k = 0;
+        for (int i = 0; i < segments.count(); ++i) {
+            if (k < rt.keywordIndexes.count() && rt.keywordIndexes[k] == i) {
+                ++k;
+                continue;
+            }
+            params << QString::fromUtf8(segments[i].data, segments[i].length);
         }
-continue_next:
-        continue;
     }
 
-    return (denied) ? TRouting("", "") : TRouting() /* Not found routing info */ ;
+    return TRouting(rt.controller, rt.action, params);
 }
 
 
 void TUrlRoute::clear()
 {
     routes.clear();
+    delete root;
+    root = new TRouteNode;
 }
 
 
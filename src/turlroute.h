@@ -65,22 +65,38 @@ inline void TRouting::setRouting(const QByteArray &ctrl, const QByteArray &act,
 }
 
 
+class TRouteNode;
+
+
 class T_CORE_EXPORT TUrlRoute
 {
 public:
+    ~TUrlRoute();
+
     static void instantiate();
     static const TUrlRoute &instance();
     static QStringList splitPath(const QString &path);
     TRouting findRouting(Tf::HttpMethod method, const QStringList &components) const;
+    TRouting findRouting(Tf::HttpMethod method, const QByteArray &path) const;
 
 protected:
-    TUrlRoute() { }
+    TUrlRoute();
     bool parseConfigFile();
     bool addRouteFromString(const QString &line);
     void clear();
 
 private:
+    struct Segment {
+        const char *data;
+        int length;
+    };
+
+    int matchRoute(int method, const Segment *segments, int count, bool *denied) const;
+
     QList<TRoute> routes;
+    TRouteNode *root;  // trie of path components
+
+    Q_DISABLE_COPY(TUrlRoute)
 };
 
 #endif // TURLROUTE_H
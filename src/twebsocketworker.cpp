@@ -14,16 +14,16 @@
 #include "turlroute.h"
 
 
-TWebSocketWorker::TWebSocketWorker(const QByteArray &socket, const TSession &session, QObject *parent)
-    : QThread(parent), socketUuid(socket), sessionStore(session), requestPath(),
+TWebSocketWorker::TWebSocketWorker(quint64 socket, const TSession &session, QObject *parent)
+    : QThread(parent), socketId(socket), sessionStore(session), requestPath(),
       opcode(TWebSocketFrame::Continuation), requestData()
 {
     tSystemDebug("TWebSocketWorker::TWebSocketWorker");
 }
 
 
-TWebSocketWorker::TWebSocketWorker(const QByteArray &socket, const QByteArray &path, TWebSocketFrame::OpCode opCode, const QByteArray &data, QObject *parent)
-    : QThread(parent), socketUuid(socket), sessionStore(), requestPath(path), opcode(opCode), requestData(data)
+TWebSocketWorker::TWebSocketWorker(quint64 socket, const QByteArray &path, TWebSocketFrame::OpCode opCode, const QByteArray &data, QObject *parent)
+    : QThread(parent), socketId(socket), sessionStore(), requestPath(path), opcode(opCode), requestData(data)
 {
     tSystemDebug("TWebSocketWorker::TWebSocketWorker");
 }
@@ -86,11 +86,11 @@ void TWebSocketWorker::run()
             const QVariant &var = it.next();
             switch (var.type()) {
             case QVariant::String:
-                TEpollWebSocket::sendText(socketUuid, var.toString());
+                TEpollWebSocket::sendText(socketId, var.toString());
                 break;
 
             case QVariant::ByteArray:
-                TEpollWebSocket::sendBinary(socketUuid, var.toByteArray());
+                TEpollWebSocket::sendBinary(socketId, var.toByteArray());
                 break;
 
             case QVariant::Int: {
@@ -98,15 +98,15 @@ void TWebSocketWorker::run()
                 int opcode = var.toInt();
                 switch (opcode) {
                 case TWebSocketFrame::Close:
-                    TEpollWebSocket::disconnect(socketUuid);
+                    TEpollWebSocket::disconnect(socketId);
                     break;
 
                 case TWebSocketFrame::Ping:
-                    TEpollWebSocket::sendPing(socketUuid);
+                    TEpollWebSocket::sendPing(socketId);
                     break;
 
                 case TWebSocketFrame::Pong:
-                    TEpollWebSocket::sendPong(socketUuid);
+                    TEpollWebSocket::sendPong(socketId);
                     break;
 
                 default:
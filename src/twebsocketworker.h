@@ -13,15 +13,15 @@ class T_CORE_EXPORT TWebSocketWorker : public QThread
 {
     Q_OBJECT
 public:
-    TWebSocketWorker(const QByteArray &socket, const TSession &session, QObject *parent = 0);
-    TWebSocketWorker(const QByteArray &socket, const QByteArray &path, TWebSocketFrame::OpCode opCode, const QByteArray &data, QObject *parent = 0);
+    TWebSocketWorker(quint64 socket, const TSession &session, QObject *parent = 0);
+    TWebSocketWorker(quint64 socket, const QByteArray &path, TWebSocketFrame::OpCode opCode, const QByteArray &data, QObject *parent = 0);
     ~TWebSocketWorker();
 
 protected:
     void run();
 
 private:
-    QByteArray socketUuid;
+    quint64 socketId;
     TSession sessionStore;
     QByteArray requestPath;
     TWebSocketFrame::OpCode opcode;
@@ -38,7 +38,41 @@
     "\n"                                                        \
     "#include \"%1.moc\"\n"
 
+// Generates a view writing UTF-8 bytes, of which text is not translated
+#define UTF8_VIEW_SOURCE_TEMPLATE                               \
+    "#include <QtCore>\n"                                       \
+    "#include <TreeFrogView>\n"                                 \
+    "%4"                                                        \
+    "\n"                                                        \
+    "class T_VIEW_EXPORT %1 : public TActionView\n"             \
+    "{\n"                                                       \
+    "  Q_OBJECT\n"                                              \
+    "public:\n"                                                 \
+    "  %1() : TActionView() { setUtf8Output(true); }\n"         \
+    "  %1(const %1 &) : TActionView() { setUtf8Output(true); }\n" \
+    "  QString toString();\n"                                   \
+    "  QByteArray toUtf8();\n"                                  \
+    "};\n"                                                      \
+    "\n"                                                        \
+    "QString %1::toString()\n"                                  \
+    "{\n"                                                       \
+    "  return QString::fromUtf8(toUtf8());\n"                   \
+    "}\n"                                                       \
+    "\n"                                                        \
+    "QByteArray %1::toUtf8()\n"                                 \
+    "{\n"                                                       \
+    "  responsebytes.reserve(%3);\n"                            \
+    "%2\n"                                                      \
+    "  return responsebytes;\n"                                 \
+    "}\n"                                                       \
+    "\n"                                                        \
+    "Q_DECLARE_METATYPE(%1)\n"                                  \
+    "T_REGISTER_VIEW(%1)\n"                                     \
+    "\n"                                                        \
+    "#include \"%1.moc\"\n"
+
 int defaultTrimMode;
+bool defaultUtf8Output = false;
 
 
 ErbConverter::ErbConverter(const QDir &output, const QDir &helpers)
@@ -80,11 +114,11 @@ bool ErbConverter::convert(const QString &erbPath, int trimMode) const
         return false;
     }
 
-    ErbParser parser((ErbParser::TrimMode)trimMode);
+    ErbParser parser((ErbParser::TrimMode)trimMode, defaultUtf8Output);
     parser.parse(QTextStream(&erbFile).readAll());
     QString code = parser.sourceCode();
     QTextStream ts(&outFile);
-    ts << QString(VIEW_SOURCE_TEMPLATE).arg(className, code, QString::number(code.size()), generateIncludeCode(parser));
+    ts << sourceTemplate().arg(className, code, QString::number(code.size()), generateIncludeCode(parser));
     if (ts.status() == QTextStream::Ok) {
         printf("  created  %s\n", qPrintable(outFile.fileName()));
     }
@@ -100,11 +134,11 @@ bool ErbConverter::convert(const QString &className, const QString &erb) const
         return false;
     }
 
-    ErbParser parser((ErbParser::TrimMode)defaultTrimMode);
+    ErbParser parser((ErbParser::TrimMode)defaultTrimMode, defaultUtf8Output);
     parser.parse(erb);
     QString code = parser.sourceCode();
     QTextStream ts(&outFile);
-    ts << QString(VIEW_SOURCE_TEMPLATE).arg(className, code, QString::number(code.size()), generateIncludeCode(parser));
+    ts << sourceTemplate().arg(className, code, QString::number(code.size()), generateIncludeCode(parser));
     if (ts.status() == QTextStream::Ok) {
         printf("  created  %s\n", qPrintable(outFile.fileName()));
     }
@@ -122,6 +156,58 @@ QString ErbConverter::escapeNewline(const QString &string)
 }
 
 
+/*!
+  Escapes the \a bytes to be put in a string literal of C++.
+ */
+QString ErbConverter::escapeBytes(const QByteArray &bytes)
+{
+    QString s;
+    s.reserve(bytes.length() + bytes.length() / 4);
+
+    for (int i = 0; i < bytes.length(); ++i) {
+        uchar c = (uchar)bytes[i];
+        switch (c) {
+        case '\n':
+            s += QLatin1String("\\n");
+            break;
+        case '\r':
+            s += QLatin1String("\\r");
+            break;
+        case '\t':
+            s += QLatin1String("\\t");
+            break;
+        case '"':
+            s += QLatin1String("\\\"");
+            break;
+        case '\\':
+            s += QLatin1String("\\\\");
+            break;
+        case '?':  // not to be a trigraph
+            s += QLatin1String("\\?");
+            break;
+        default:
+            if (c >= 0x20 && c < 0x7f) {
+                s += QLatin1Char(c);
+            } else {
+                // Octal escape, which is never longer than 3 digits
+                s += QLatin1Char('\\');
+                s += QLatin1Char('0' + (c >> 6));
+                s += QLatin1Char('0' + ((c >> 3) & 7));
+                s += QLatin1Char('0' + (c & 7));
+            }
+            break;
+        }
+    }
+    return s;
+}
+
+
+QString ErbConverter::sourceTemplate()
+{
+    return QString((defaultUtf8Output) ? UTF8_VIEW_SOURCE_TEMPLATE : VIEW_SOURCE_TEMPLATE);
+}
+
+
 QString ErbConverter::generateIncludeCode(const ErbParser &parser) const
 {
     QString code = parser.includeCode();
@@ -18,9 +18,11 @@ public:
     //static QString convertToSourceCode(const QString &className, const QString &erb);
     static QString fileSuffix() { return "erb"; }
     static QString escapeNewline(const QString &string);
+    static QString escapeBytes(const QByteArray &bytes);
 
 protected:
     QString generateIncludeCode(const ErbParser &parser) const;
+    static QString sourceTemplate();
 
 private:
     QDir outputDirectory;
@@ -35,9 +35,18 @@ void ErbParser::parse(const QString &erb)
         QString text = erbData.mid(pos, i - pos);
         if (!text.isEmpty()) {
             // HTML output
-            srcCode += QLatin1String("  responsebody += tr(\"");
-            srcCode += ErbConverter::escapeNewline(text);
-            srcCode += QLatin1String("\");\n");
+            if (utf8Output) {
+                QByteArray bytes = text.toUtf8();
+                srcCode += QLatin1String("  responsebytes.append(\"");
+                srcCode += ErbConverter::escapeBytes(bytes);
+                srcCode += QLatin1String("\", ");
+                srcCode += QString::number(bytes.length());
+                srcCode += QLatin1String(");\n");
+            } else {
+                srcCode += QLatin1String("  responsebody += tr(\"");
+                srcCode += ErbConverter::escapeNewline(text);
+                srcCode += QLatin1String("\");\n");
+            }
         } 
             
         if (i >= 0) {
@@ -66,6 +75,8 @@ void ErbParser::parsePercentTag()
     startTag = "<%";
 
     srcCode += QLatin1String("  ");  // Appends indent
+    const QLatin1String outBegin = (utf8Output) ? QLatin1String("echo(") : QLatin1String("responsebody += ");
+    const QLatin1String outEnd = (utf8Output) ? QLatin1String(")") : QLatin1String("");
     QString str;
     QChar c = erbData[pos++];
     if (c == QLatin1Char('#')) {  // <%#
@@ -127,30 +138,64 @@ void ErbParser::parsePercentTag()
             // Outputs the value
             QPair<QString, QString> p = parseEndPercentTag();
             if (p.second.isEmpty()) {
-                srcCode += QLatin1String("responsebody += QVariant(");
-                srcCode += semicolonTrim(p.first);
-                srcCode += QLatin1String(").toString();\n");
+                if (utf8Output && semicolonTrim(p.first) == QLatin1String("yield()")) {
+                    // Content of the action view in UTF-8 as is
+                    srcCode += QLatin1String("echo(yieldUtf8());\n");
+                } else {
+                    srcCode += outBegin;
+                    srcCode += QLatin1String("QVariant(");
+                    srcCode += semicolonTrim(p.first);
+                    srcCode += QLatin1String(").toString()");
+                    srcCode += outEnd;
+                    srcCode += QLatin1String(";\n");
+                }
             } else {
                 srcCode += QLatin1String("{ QString ___s = QVariant(");
                 srcCode += semicolonTrim(p.first);
-                srcCode += QLatin1String(").toString(); responsebody += (___s.isEmpty()) ? QVariant(");
+                srcCode += QLatin1String(").toString(); ");
+                srcCode += outBegin;
+                srcCode += QLatin1String("(___s.isEmpty()) ? QVariant(");
                 srcCode += semicolonTrim(p.second);
-                srcCode += QLatin1String(").toString() : ___s; }\n");
+                srcCode += QLatin1String(").toString() : ___s");
+                srcCode += outEnd;
+                srcCode += QLatin1String("; }\n");
             }
 
         } else {  // <%=
             // Outputs the escaped value
             QPair<QString, QString> p = parseEndPercentTag();
-            if (p.second.isEmpty()) {
-                srcCode += QLatin1String("responsebody += THttpUtility::htmlEscape(");
+            if (utf8Output) {
+                // Escapes into the UTF-8 output directly
+                if (p.second.isEmpty()) {
+                    srcCode += QLatin1String("eh(");
+                    srcCode += semicolonTrim(p.first);
+                    srcCode += QLatin1String(");
+");
+                } else {
+                    srcCode += QLatin1String("{ QString ___s = QVariant(");
+                    srcCode += semicolonTrim(p.first);
+                    srcCode += QLatin1String(").toString(); eh((___s.isEmpty()) ? QVariant(");
+                    srcCode += semicolonTrim(p.second);
+                    srcCode += QLatin1String(").toString() : ___s); }
+");
+                }
+            } else if (p.second.isEmpty()) {
+                srcCode += outBegin;
+                srcCode += QLatin1String("THttpUtility::htmlEscape(");
                 srcCode += semicolonTrim(p.first);
-                srcCode += QLatin1String(");\n");
+                srcCode += QLatin1String(")");
+                srcCode += outEnd;
+                srcCode += QLatin1String(";\n");
             } else {
                 srcCode += QLatin1String("{ QString ___s = QVariant(");
                 srcCode += semicolonTrim(p.first);
-                srcCode += QLatin1String(").toString(); responsebody += (___s.isEmpty()) ? THttpUtility::htmlEscape(");
+                srcCode += QLatin1String(").toString(); ");
+                srcCode += outBegin;
+                srcCode += QLatin1String("(___s.isEmpty()) ? THttpUtility::htmlEscape(");
                 srcCode += semicolonTrim(p.second);
-                srcCode += QLatin1String(") : THttpUtility::htmlEscape(___s); }\n");
+                srcCode += QLatin1String(") : THttpUtility::htmlEscape(___s)");
+                srcCode += outEnd;
+                srcCode += QLatin1String("; }\n");
             }
         }
 
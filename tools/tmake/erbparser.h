@@ -14,7 +14,7 @@ public:
         StrongTrim,  // Removes whitespaces if the end is "%>"
     };
 
-    ErbParser(TrimMode mode) : trimMode(mode), pos(0) { }
+    ErbParser(TrimMode mode, bool utf8 = false) : trimMode(mode), utf8Output(utf8), pos(0) { }
     void parse(const QString &text);
     QString sourceCode() const { return srcCode; }
     QString includeCode() const { return incCode; }
@@ -27,6 +27,7 @@ private:
     QString parseQuote();
 
     TrimMode trimMode;
+    bool utf8Output;  // writes UTF-8 bytes by echo() instead of responsebody
     QString erbData;
     QString srcCode;
     QString incCode;
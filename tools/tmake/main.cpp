@@ -17,6 +17,7 @@
 
 extern QString devIni;
 extern int defaultTrimMode;
+extern bool defaultUtf8Output;
 
 
 static int usage()
@@ -81,6 +82,11 @@ int main(int argc, char *argv[])
     defaultTrimMode = devSetting.value("Erb.DefaultTrimMode", "1").toInt();
     printf("Erb.DefaultTrimMode: %d\n", defaultTrimMode);
 
+    defaultUtf8Output = devSetting.value("TemplateUtf8Output", false).toBool();
+    if (defaultUtf8Output) {
+        printf("TemplateUtf8Output: true\n");
+    }
+
     QDir viewDir(".");
     if (!args.value("-v").isEmpty()) {
         viewDir.setPath(args.value("-v"));
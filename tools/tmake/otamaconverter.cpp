@@ -26,6 +26,7 @@
 
 QString devIni;
 static QString replaceMarker;
+extern bool defaultUtf8Output;
 
 QString generateErbPhrase(const QString &str, int echoOption)
 {
@@ -39,6 +40,10 @@ QString generateErbPhrase(const QString &str, int echoOption)
     } else {
         switch (echoOption) {
         case OtmParser::NormalEcho:
+            if (defaultUtf8Output && s.trimmed() == QLatin1String("yield()")) {
+                // Content of the action view in UTF-8 as is
+                s = QLatin1String("yieldUtf8()");
+            }
             res += QLatin1String("echo(");
             break;
 
@@ -25,6 +25,8 @@ private slots:
     void otamaconvert();
     void erbparse_data();
     void erbparse();
+    void erbparseUtf8_data();
+    void erbparseUtf8();
 };
 
 
@@ -212,5 +214,44 @@ void TestTfpconverter::erbparse()
 }
 
 
+
+void TestTfpconverter::erbparseUtf8_data()
+{
+    QTest::addColumn<QString>("erb");
+    QTest::addColumn<QString>("expe");
+
+    QTest::newRow("1") << "<body>Hello ... \n</body>"
+                       << "  responsebytes.append(\"<body>Hello ... \\n</body>\", 24);\n";
+    QTest::newRow("2") << QString::fromUtf8("<p>\xe3\x81\x82 \"a\\b\"?</p>")
+                       << "  responsebytes.append(\"<p>\\343\\201\\202 \\\"a\\\\b\\\"\\?</p>\", 17);\n";
+    QTest::newRow("3") << "<body><%== vvv %></body>"
+                       << "  responsebytes.append(\"<body>\", 6);\n  echo(QVariant(vvv).toString());\n  responsebytes.append(\"</body>\", 7);\n";
+    QTest::newRow("4") << "<body><%= vvv %></body>"
+                       << "  responsebytes.append(\"<body>\", 6);\n  eh(vvv);\n  responsebytes.append(\"</body>\", 7);\n";
+    QTest::newRow("5") << "<body><%= number %|% 33 %></body>"
+                       << "  responsebytes.append(\"<body>\", 6);\n  { QString ___s = QVariant(number).toString(); eh((___s.isEmpty()) ? QVariant(33).toString() : ___s); }\n  responsebytes.append(\"</body>\", 7);\n";
+    QTest::newRow("6") << "<body><%== number %|% 33 %></body>"
+                       << "  responsebytes.append(\"<body>\", 6);\n  { QString ___s = QVariant(number).toString(); echo((___s.isEmpty()) ? QVariant(33).toString() : ___s); }\n  responsebytes.append(\"</body>\", 7);\n";
+    QTest::newRow("7") << "<body><%== yield() %></body>"
+                       << "  responsebytes.append(\"<body>\", 6);\n  echo(yieldUtf8());\n  responsebytes.append(\"</body>\", 7);\n";
+    QTest::newRow("8") << "<body><%=$ hoge -%>\n</body>"
+                       << "  responsebytes.append(\"<body>\", 6);\n  tehex(hoge);\n  responsebytes.append(\"</body>\", 7);\n";
+    QTest::newRow("9") << "<p><%= item.name(); %></p>"
+                       << "  responsebytes.append(\"<p>\", 3);\n  eh(item.name());\n  responsebytes.append(\"</p>\", 4);\n";
+}
+
+
+void TestTfpconverter::erbparseUtf8()
+{
+    QFETCH(QString, erb);
+    QFETCH(QString, expe);
+
+    ErbParser parser(ErbParser::NormalTrim, true);
+    parser.parse(erb);
+    QString result = parser.sourceCode();
+    QCOMPARE(result, expe);
+}
+
+
 QTEST_MAIN(TestTfpconverter)
 #include "tmaketest.moc"